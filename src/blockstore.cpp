@@ -0,0 +1,162 @@
+// Copyright (c) 2019 The BitcoinZero Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockstore.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "compat.h"
+#include "crypto/common.h"
+#include "main.h"
+#include "protocol.h"
+#include "serialize.h"
+#include "util.h"
+
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
+//! Mapped files kept around; blk files are at most MAX_BLOCKFILE_SIZE, so mind 32-bit address spaces
+static const size_t MAX_MAPPED_BLOCKFILES = sizeof(void*) > 4 ? 64 : 8;
+
+//! Network magic and record size written in front of every block and undo record
+static const unsigned int RECORD_HEADER_SIZE = MESSAGE_START_SIZE + sizeof(uint32_t);
+
+CBlockFileReader blockFileReader;
+
+std::shared_ptr<const CMappedBlockFile> CMappedBlockFile::Open(const boost::filesystem::path& path)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid without the descriptor, so none are held open
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    // Reads hop between records of unrelated blocks
+    posix_madvise(data, size, POSIX_MADV_RANDOM);
+
+    return std::shared_ptr<const CMappedBlockFile>(new CMappedBlockFile((const char*)data, size));
+#else
+    return NULL;
+#endif
+}
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    munmap((void*)data, size);
+#endif
+}
+
+std::shared_ptr<const CMappedBlockFile> CBlockFileReader::GetMapping(const FileKey& key, size_t nMinSize)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+
+    for (auto it = mappings.begin(); it != mappings.end(); ++it) {
+        if (it->first != key)
+            continue;
+        std::shared_ptr<const CMappedBlockFile> mapping = it->second;
+        mappings.erase(it);
+        // Files grow as blocks are appended; map them again once a record lies past the mapped part.
+        // Readers still using the old mapping keep it alive through their spans.
+        if (mapping->Size() < nMinSize)
+            mapping = CMappedBlockFile::Open(GetBlockPosFilename(CDiskBlockPos(key.first, 0), key.second.c_str()));
+        if (mapping)
+            mappings.push_front(std::make_pair(key, mapping));
+        return mapping;
+    }
+
+    std::shared_ptr<const CMappedBlockFile> mapping = CMappedBlockFile::Open(GetBlockPosFilename(CDiskBlockPos(key.first, 0), key.second.c_str()));
+    if (!mapping)
+        return NULL;
+
+    mappings.push_front(std::make_pair(key, mapping));
+    if (mappings.size() > MAX_MAPPED_BLOCKFILES)
+        mappings.pop_back();
+    return mapping;
+}
+
+static bool CheckRecordHeader(const char* pheader, const CDiskBlockPos& pos, const char* prefix, unsigned int& nSize)
+{
+    if (memcmp(pheader, Params().MessageStart(), MESSAGE_START_SIZE) != 0)
+        return error("%s: no record at %s in %s file", __func__, pos.ToString(), prefix);
+
+    nSize = ReadLE32((const unsigned char*)pheader + MESSAGE_START_SIZE);
+    if (nSize > MAX_SIZE)
+        return error("%s: oversized record at %s in %s file", __func__, pos.ToString(), prefix);
+    return true;
+}
+
+bool CBlockFileReader::ReadCopy(const CDiskBlockPos& pos, const char* prefix, unsigned int nTrailer, CBlockFileSpan& span)
+{
+    boost::filesystem::path path = GetBlockPosFilename(pos, prefix);
+    CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: unable to open %s", __func__, path.string());
+
+    char header[RECORD_HEADER_SIZE];
+    unsigned int nSize;
+    if (fseek(filein.Get(), pos.nPos - RECORD_HEADER_SIZE, SEEK_SET) != 0 ||
+            fread(header, 1, sizeof(header), filein.Get()) != sizeof(header))
+        return error("%s: unable to read %s at %s", __func__, path.string(), pos.ToString());
+    if (!CheckRecordHeader(header, pos, prefix, nSize))
+        return false;
+
+    span.buffer.resize(nSize + nTrailer);
+    if (fread(span.buffer.data(), 1, span.buffer.size(), filein.Get()) != span.buffer.size())
+        return error("%s: unable to read %s at %s", __func__, path.string(), pos.ToString());
+
+    span.mapping.reset();
+    span.pbegin = span.buffer.data();
+    span.pend = span.pbegin + span.buffer.size();
+    return true;
+}
+
+bool CBlockFileReader::Read(const CDiskBlockPos& pos, const char* prefix, unsigned int nTrailer, CBlockFileSpan& span)
+{
+    if (pos.IsNull() || pos.nPos < RECORD_HEADER_SIZE)
+        return error("%s: invalid position %s", __func__, pos.ToString());
+
+    std::shared_ptr<const CMappedBlockFile> mapping = GetMapping(FileKey(pos.nFile, prefix), pos.nPos);
+    if (!mapping)
+        return ReadCopy(pos, prefix, nTrailer, span);
+
+    unsigned int nSize;
+    if (!CheckRecordHeader(mapping->Data() + pos.nPos - RECORD_HEADER_SIZE, pos, prefix, nSize))
+        return false;
+
+    size_t nEnd = (size_t)pos.nPos + nSize + nTrailer;
+    if (mapping->Size() < nEnd) {
+        mapping = GetMapping(FileKey(pos.nFile, prefix), nEnd);
+        if (!mapping || mapping->Size() < nEnd)
+            return error("%s: record at %s runs past the end of the %s file", __func__, pos.ToString(), prefix);
+    }
+
+    span.buffer.clear();
+    span.pbegin = mapping->Data() + pos.nPos;
+    span.pend = mapping->Data() + nEnd;
+    span.mapping = mapping;
+    return true;
+}
+
+void CBlockFileReader::Forget(int nFile)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    mappings.remove_if([nFile](const std::pair<FileKey, std::shared_ptr<const CMappedBlockFile> >& entry) {
+        return entry.first.first == nFile;
+    });
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2019 The BitcoinZero Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKSTORE_H
+#define BITCOIN_BLOCKSTORE_H
+
+#include "streams.h"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread/mutex.hpp>
+
+struct CDiskBlockPos;
+
+/** Read-only memory mapping of a whole blk/rev file */
+class CMappedBlockFile
+{
+public:
+    //! Map the file as it is on disk now, NULL if it cannot be mapped
+    static std::shared_ptr<const CMappedBlockFile> Open(const boost::filesystem::path& path);
+    ~CMappedBlockFile();
+
+    const char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    CMappedBlockFile(const char* dataIn, size_t sizeIn) : data(dataIn), size(sizeIn) {}
+    CMappedBlockFile(const CMappedBlockFile&);
+    CMappedBlockFile& operator=(const CMappedBlockFile&);
+
+    const char* data;
+    size_t size;
+};
+
+/**
+ * A record of a blk/rev file: either a range of a mapping, which the span
+ * keeps alive, or a copy read into memory when the file cannot be mapped.
+ */
+class CBlockFileSpan
+{
+public:
+    CBlockFileSpan() : pbegin(NULL), pend(NULL) {}
+
+    const char* begin() const { return pbegin; }
+    const char* end() const { return pend; }
+
+    CMemoryReader GetReader(int nType, int nVersion) const { return CMemoryReader(pbegin, pend, nType, nVersion); }
+
+private:
+    friend class CBlockFileReader;
+
+    std::shared_ptr<const CMappedBlockFile> mapping;
+    std::vector<char> buffer;
+    const char* pbegin;
+    const char* pend;
+};
+
+/**
+ * Reads blocks and undo data from the blk/rev files. Recently used files stay
+ * mapped, so a read is a lookup and a deserialization straight from the page
+ * cache rather than an open, a seek, a read and a close. Records are located
+ * with the network magic and size written in front of each of them. Where
+ * mapping is unavailable the record is read into memory instead. Thread safe.
+ */
+class CBlockFileReader
+{
+public:
+    /**
+     * Get the record at pos in the blk or rev file.
+     *
+     * @param pos Position of the record, right after its magic and size
+     * @param prefix "blk" or "rev"
+     * @param nTrailer Bytes following the record that belong to it (the checksum of undo data)
+     * @param[out] span The record and its trailer
+     * @return False if the file is missing or the record is not where pos says
+     */
+    bool Read(const CDiskBlockPos& pos, const char* prefix, unsigned int nTrailer, CBlockFileSpan& span);
+
+    //! Drop the mappings of a file, before it is deleted by pruning
+    void Forget(int nFile);
+
+private:
+    typedef std::pair<int, std::string> FileKey;
+
+    std::shared_ptr<const CMappedBlockFile> GetMapping(const FileKey& key, size_t nMinSize);
+    bool ReadCopy(const CDiskBlockPos& pos, const char* prefix, unsigned int nTrailer, CBlockFileSpan& span);
+
+    boost::mutex cs;
+    //! Most recently used first
+    std::list<std::pair<FileKey, std::shared_ptr<const CMappedBlockFile> > > mappings;
+};
+
+extern CBlockFileReader blockFileReader;
+
+#endif // BITCOIN_BLOCKSTORE_H
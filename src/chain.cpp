@@ -5,6 +5,14 @@
 
 #include "chain.h"
 
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+
+#include <boost/foreach.hpp>
+
 using namespace std;
 
 /**
@@ -112,6 +120,57 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
+//! Entries are padded to whole cache lines
+static const size_t BLOCK_INDEX_SLOT_SIZE = (sizeof(CBlockIndex) + 63) & ~(size_t)63;
+//! Entries per chunk, unless more are reserved at once
+static const size_t BLOCK_INDEX_CHUNK_SLOTS = 4096;
+
+void CBlockIndexArena::AddChunk(size_t nSlots)
+{
+    Chunk chunk;
+    chunk.pbase = (char*)malloc(nSlots * BLOCK_INDEX_SLOT_SIZE + 63);
+    if (!chunk.pbase)
+        throw std::bad_alloc();
+    chunk.pbegin = (char*)(((uintptr_t)chunk.pbase + 63) & ~(uintptr_t)63);
+    chunk.nSlots = nSlots;
+    chunk.nUsed = 0;
+    vChunks.push_back(chunk);
+}
+
+void* CBlockIndexArena::AllocateSlot()
+{
+    if (vChunks.empty() || vChunks.back().nUsed == vChunks.back().nSlots)
+        AddChunk(BLOCK_INDEX_CHUNK_SLOTS);
+    Chunk& chunk = vChunks.back();
+    return chunk.pbegin + BLOCK_INDEX_SLOT_SIZE * chunk.nUsed++;
+}
+
+CBlockIndex* CBlockIndexArena::Allocate()
+{
+    return new (AllocateSlot()) CBlockIndex();
+}
+
+CBlockIndex* CBlockIndexArena::Allocate(const CBlockHeader& block)
+{
+    return new (AllocateSlot()) CBlockIndex(block);
+}
+
+void CBlockIndexArena::Reserve(size_t n)
+{
+    if (vChunks.empty() || vChunks.back().nSlots - vChunks.back().nUsed < n)
+        AddChunk(std::max(n, BLOCK_INDEX_CHUNK_SLOTS));
+}
+
+void CBlockIndexArena::Clear()
+{
+    BOOST_FOREACH(Chunk& chunk, vChunks) {
+        for (size_t i = 0; i < chunk.nUsed; i++)
+            ((CBlockIndex*)(chunk.pbegin + BLOCK_INDEX_SLOT_SIZE * i))->~CBlockIndex();
+        free(chunk.pbase);
+    }
+    vChunks.clear();
+}
+
 arith_uint256 GetBlockProof(const CBlockIndex& block)
 {
     arith_uint256 bnTarget;
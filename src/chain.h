@@ -167,8 +167,9 @@ enum BlockStatus: uint32_t {
 class CBlockIndex
 {
 public:
-    //! pointer to the hash of the block, if any. Memory is owned by this CBlockIndex
-    const uint256* phashBlock;
+    // The fields used when walking the chain (GetAncestor, difficulty
+    // retargeting, chain work comparisons) come first, so that they fill
+    // the first cache line of the entry together.
 
     //! pointer to the index of the predecessor of this block
     CBlockIndex* pprev;
@@ -179,6 +180,19 @@ public:
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight;
 
+    //! block header time and difficulty
+    unsigned int nTime;
+    unsigned int nBits;
+
+    //! Verification status of this block. See enum BlockStatus
+    unsigned int nStatus;
+
+    //! (memory only) Total amount of work (expected number of hashes) in the chain up to and including this block
+    arith_uint256 nChainWork;
+
+    //! pointer to the hash of the block, if any. Memory is owned by this CBlockIndex
+    const uint256* phashBlock;
+
     //! Which # file this block is stored in (blk?????.dat)
     int nFile;
 
@@ -188,9 +202,6 @@ public:
     //! Byte offset within rev?????.dat where this block's undo data is stored
     unsigned int nUndoPos;
 
-    //! (memory only) Total amount of work (expected number of hashes) in the chain up to and including this block
-    arith_uint256 nChainWork;
-
     //! Number of transactions in this block.
     //! Note: in a potential headers-first mode, this number cannot be relied upon
     unsigned int nTx;
@@ -200,14 +211,9 @@ public:
     //! Change to 64-bit type when necessary; won't happen before 2030
     unsigned int nChainTx;
 
-    //! Verification status of this block. See enum BlockStatus
-    unsigned int nStatus;
-
-    //! block header
+    //! rest of the block header
     int nVersion;
     uint256 hashMerkleRoot;
-    unsigned int nTime;
-    unsigned int nBits;
     unsigned int nNonce;
 
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
@@ -377,6 +383,46 @@ public:
     const CBlockIndex* GetAncestor(int height) const;
 };
 
+/**
+ * Storage of the block index entries. Entries are created in large chunks,
+ * each one starting on a cache line, in the order they are allocated: the
+ * entries loaded at startup, which are allocated by height, lie along the
+ * chain in memory instead of being scattered over the heap. Entries are never
+ * freed one by one, only all together by Clear().
+ */
+class CBlockIndexArena
+{
+public:
+    CBlockIndexArena() {}
+    ~CBlockIndexArena() { Clear(); }
+
+    CBlockIndex* Allocate();
+    CBlockIndex* Allocate(const CBlockHeader& block);
+
+    //! Make the next n entries contiguous
+    void Reserve(size_t n);
+
+    //! Destroy all entries
+    void Clear();
+
+private:
+    struct Chunk
+    {
+        char* pbase;
+        char* pbegin;
+        size_t nSlots;
+        size_t nUsed;
+    };
+
+    void* AllocateSlot();
+    void AddChunk(size_t nSlots);
+
+    std::vector<Chunk> vChunks;
+
+    CBlockIndexArena(const CBlockIndexArena&);
+    CBlockIndexArena& operator=(const CBlockIndexArena&);
+};
+
 arith_uint256 GetBlockProof(const CBlockIndex& block);
 /** Return the time it would take to redo the work difference between from and to, assuming the current hashrate corresponds to the difficulty at tip, in seconds. */
 int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& from, const CBlockIndex& tip, const Consensus::Params&);
@@ -27,6 +27,12 @@ std::size_t CPublicCoinHash::operator ()(const sigma::PublicCoin& coin) const no
 }
 
 
+std::size_t CSerialHashHash::operator ()(const uint256& hash) const noexcept {
+    std::size_t result;
+    std::memcpy(&result, hash.begin(), sizeof(std::size_t));
+    return result;
+}
+
 CMintedCoinInfo CMintedCoinInfo::make(CoinDenomination denomination,  int coinGroupId, int nHeight) {
     CMintedCoinInfo coinInfo;
     coinInfo.denomination = denomination;
@@ -18,6 +18,11 @@ struct CPublicCoinHash {
     std::size_t operator()(const sigma::PublicCoin& coin) const noexcept;
 };
 
+// Custom hash for the hash of a coin serial.
+struct CSerialHashHash {
+    std::size_t operator()(const uint256& hash) const noexcept;
+};
+
 struct CMintedCoinInfo {
     CoinDenomination denomination;
     int coinGroupId;
@@ -53,6 +58,7 @@ struct CSpendCoinInfo {
 
 using mint_info_container = std::unordered_map<sigma::PublicCoin, CMintedCoinInfo, sigma::CPublicCoinHash>;
 using spend_info_container = std::unordered_map<Scalar, CSpendCoinInfo, sigma::CScalarHash>;
+using mempool_serial_hash_container = std::unordered_map<uint256, uint256, sigma::CSerialHashHash>;
 
 } // namespace sigma
 
@@ -84,7 +84,7 @@ CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256 &txid) const
         // version as fresh.
         ret->second.flags = CCoinsCacheEntry::FRESH;
     }
-    cachedCoinsUsage += ret->second.coins.DynamicMemoryUsage();
+    cachedCoinsUsage += ret->second.DynamicMemoryUsage();
     return ret;
 }
 
@@ -111,7 +111,7 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
             ret.first->second.flags = CCoinsCacheEntry::FRESH;
         }
     } else {
-        cachedCoinUsage = ret.first->second.coins.DynamicMemoryUsage();
+        cachedCoinUsage = ret.first->second.DynamicMemoryUsage();
     }
     // Assume that whenever ModifyCoins is called, the entry will be modified.
     ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
@@ -122,15 +122,25 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256 &txid) {
 // coinbase or not.  If they are for a coinbase, it can not mark them as fresh.
 // This is to ensure that the historical duplicate coinbases before BIP30 was
 // in effect will still be properly overwritten when spent.
+// A dirty entry is not marked fresh either: it may be a transaction that was
+// disconnected in this view and still has outputs to erase in the parent.
 CCoinsModifier CCoinsViewCache::ModifyNewCoins(const uint256 &txid, bool coinbase) {
     assert(!hasModifier);
     std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry()));
-    ret.first->second.coins.Clear();
-    if (!coinbase) {
+    size_t cachedCoinUsage = ret.second ? 0 : ret.first->second.DynamicMemoryUsage();
+    if (!coinbase && !(ret.first->second.flags & CCoinsCacheEntry::DIRTY)) {
         ret.first->second.flags = CCoinsCacheEntry::FRESH;
+        ret.first->second.vChanged.clear();
+    }
+    if (!(ret.first->second.flags & CCoinsCacheEntry::FRESH)) {
+        // Whatever outputs the entry still has are replaced
+        for (unsigned int i = 0; i < ret.first->second.coins.vout.size(); i++)
+            if (ret.first->second.coins.IsAvailable(i))
+                ret.first->second.MarkChanged(i);
     }
+    ret.first->second.coins.Clear();
     ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
-    return CCoinsModifier(*this, ret.first, 0);
+    return CCoinsModifier(*this, ret.first, cachedCoinUsage);
 }
 
 const CCoins* CCoinsViewCache::AccessCoins(const uint256 &txid) const {
@@ -179,7 +189,8 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                     // and move the data up and mark it as dirty
                     CCoinsCacheEntry& entry = cacheCoins[it->first];
                     entry.coins.swap(it->second.coins);
-                    cachedCoinsUsage += entry.coins.DynamicMemoryUsage();
+                    entry.vChanged.swap(it->second.vChanged);
+                    cachedCoinsUsage += entry.DynamicMemoryUsage();
                     entry.flags = CCoinsCacheEntry::DIRTY;
                     // We can mark it FRESH in the parent if it was FRESH in the child
                     // Otherwise it might have just been flushed from the parent's cache
@@ -193,13 +204,23 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                     // The grandparent does not have an entry, and the child is
                     // modified and being pruned. This means we can just delete
                     // it from the parent.
-                    cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
+                    cachedCoinsUsage -= itUs->second.DynamicMemoryUsage();
                     cacheCoins.erase(itUs);
                 } else {
                     // A normal modification.
-                    cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
+                    cachedCoinsUsage -= itUs->second.DynamicMemoryUsage();
+                    if (!(itUs->second.flags & CCoinsCacheEntry::FRESH)) {
+                        if (it->second.flags & CCoinsCacheEntry::FRESH) {
+                            // The child replaced whatever the parent had
+                            for (unsigned int i = 0; i < std::max(itUs->second.coins.vout.size(), it->second.coins.vout.size()); i++)
+                                if (itUs->second.coins.IsAvailable(i) || it->second.coins.IsAvailable(i))
+                                    itUs->second.MarkChanged(i);
+                        }
+                        BOOST_FOREACH(uint32_t nPos, it->second.vChanged)
+                            itUs->second.MarkChanged(nPos);
+                    }
                     itUs->second.coins.swap(it->second.coins);
-                    cachedCoinsUsage += itUs->second.coins.DynamicMemoryUsage();
+                    cachedCoinsUsage += itUs->second.DynamicMemoryUsage();
                     itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                 }
             }
@@ -222,7 +243,7 @@ void CCoinsViewCache::Uncache(const uint256& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
     if (it != cacheCoins.end() && it->second.flags == 0) {
-        cachedCoinsUsage -= it->second.coins.DynamicMemoryUsage();
+        cachedCoinsUsage -= it->second.DynamicMemoryUsage();
         cacheCoins.erase(it);
     }
 }
@@ -286,19 +307,41 @@ double CCoinsViewCache::GetPriority(const CTransaction &tx, int nHeight, CAmount
 CCoinsModifier::CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage) : cache(cache_), it(it_), cachedCoinUsage(usage) {
     assert(!cache.hasModifier);
     cache.hasModifier = true;
+    const CCoins& coins = it->second.coins;
+    if (!(it->second.flags & CCoinsCacheEntry::FRESH)) {
+        vWasAvailable.resize(coins.vout.size());
+        for (unsigned int i = 0; i < coins.vout.size(); i++)
+            vWasAvailable[i] = !coins.vout[i].IsNull();
+    }
+    fCoinBaseBefore = coins.fCoinBase;
+    nHeightBefore = coins.nHeight;
+    nVersionBefore = coins.nVersion;
 }
 
 CCoinsModifier::~CCoinsModifier()
 {
     assert(cache.hasModifier);
     cache.hasModifier = false;
-    it->second.coins.Cleanup();
+    CCoinsCacheEntry& entry = it->second;
+    entry.coins.Cleanup();
+    if (!(entry.flags & CCoinsCacheEntry::FRESH)) {
+        // Outputs that appeared or went away; all outputs are rewritten when
+        // the transaction itself was replaced
+        bool fReplaced = entry.coins.fCoinBase != fCoinBaseBefore || entry.coins.nHeight != nHeightBefore ||
+                         entry.coins.nVersion != nVersionBefore;
+        for (unsigned int i = 0; i < std::max(vWasAvailable.size(), entry.coins.vout.size()); i++) {
+            bool fWas = i < vWasAvailable.size() && vWasAvailable[i];
+            bool fIs = entry.coins.IsAvailable(i);
+            if (fWas != fIs || (fReplaced && fIs))
+                entry.MarkChanged(i);
+        }
+    }
     cache.cachedCoinsUsage -= cachedCoinUsage; // Subtract the old usage
-    if ((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
+    if ((entry.flags & CCoinsCacheEntry::FRESH) && entry.coins.IsPruned()) {
         cache.cacheCoins.erase(it);
     } else {
         // If the coin still exists after the modification, add the new usage
-        cache.cachedCoinsUsage += it->second.coins.DynamicMemoryUsage();
+        cache.cachedCoinsUsage += entry.DynamicMemoryUsage();
     }
 }
 
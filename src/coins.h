@@ -13,6 +13,7 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <stdint.h>
 
@@ -22,6 +23,9 @@
 /** 
  * Pruned version of CTransaction: only retains metadata and unspent transaction outputs
  *
+ * The coin database stores each output in a record of its own (see
+ * CCoinsViewDB); this format remains for reading older databases.
+ *
  * Serialized format:
  * - VARINT(nVersion)
  * - VARINT(nCode)
@@ -288,6 +292,11 @@ struct CCoinsCacheEntry
 {
     CCoins coins; // The actual cached data.
     unsigned char flags;
+    // Sorted indexes of the outputs that were created or spent since the entry
+    // was taken from the parent view. The coin database stores every output
+    // separately and only rewrites these. Not kept for FRESH entries, all of
+    // whose outputs are new to the parent.
+    std::vector<uint32_t> vChanged;
 
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
@@ -295,6 +304,16 @@ struct CCoinsCacheEntry
     };
 
     CCoinsCacheEntry() : coins(), flags(0) {}
+
+    void MarkChanged(uint32_t nPos) {
+        std::vector<uint32_t>::iterator it = std::lower_bound(vChanged.begin(), vChanged.end(), nPos);
+        if (it == vChanged.end() || *it != nPos)
+            vChanged.insert(it, nPos);
+    }
+
+    size_t DynamicMemoryUsage() const {
+        return coins.DynamicMemoryUsage() + memusage::DynamicUsage(vChanged);
+    }
 };
 
 typedef boost::unordered_map<uint256, CCoinsCacheEntry, SaltedTxidHasher> CCoinsMap;
@@ -376,6 +395,11 @@ private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
     size_t cachedCoinUsage; // Cached memory usage of the CCoins object before modification
+    // Which outputs were available before modification, to record the changed ones in the entry
+    std::vector<bool> vWasAvailable;
+    bool fCoinBaseBefore;
+    int nHeightBefore;
+    int nVersionBefore;
     CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage);
 
 public:
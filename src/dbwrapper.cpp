@@ -7,7 +7,11 @@
 #include "util.h"
 #include "random.h"
 
+#include <list>
+
 #include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -15,14 +19,168 @@
 #include <memenv.h>
 #include <stdint.h>
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+namespace {
+
+/** LRU block cache counting its hits and misses */
+class CCountingCache : public leveldb::Cache
+{
+public:
+    CCountingCache(size_t nCapacity, CDBStats* statsIn) : cache(leveldb::NewLRUCache(nCapacity)), stats(statsIn) {}
+    ~CCountingCache() { delete cache; }
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge, void (*deleter)(const leveldb::Slice& key, void* value))
+    {
+        return cache->Insert(key, value, charge, deleter);
+    }
+
+    Handle* Lookup(const leveldb::Slice& key)
+    {
+        Handle* handle = cache->Lookup(key);
+        if (handle)
+            stats->nCacheHits++;
+        else
+            stats->nCacheMisses++;
+        return handle;
+    }
+
+    void Release(Handle* handle) { cache->Release(handle); }
+    void* Value(Handle* handle) { return cache->Value(handle); }
+    void Erase(const leveldb::Slice& key) { cache->Erase(key); }
+    uint64_t NewId() { return cache->NewId(); }
+
+private:
+    leveldb::Cache* cache;
+    CDBStats* stats;
+};
+
+//! Parse -dboption=<profile>:<setting>=<value>
+bool ParseDBOption(const std::string& strOption, std::string& strProfile, std::string& strSetting, int64_t& nValue)
+{
+    size_t nColon = strOption.find(':');
+    if (nColon == std::string::npos)
+        return false;
+    size_t nEquals = strOption.find('=', nColon);
+    if (nEquals == std::string::npos)
+        return false;
+    strProfile = strOption.substr(0, nColon);
+    strSetting = strOption.substr(nColon + 1, nEquals - nColon - 1);
+    return ParseInt64(strOption.substr(nEquals + 1), &nValue) && nValue >= 0;
+}
+
+bool ApplyDBOption(CDBProfile& profile, const std::string& strSetting, int64_t nValue)
+{
+    if (strSetting == "blockcache")
+        profile.nBlockCache = nValue << 20;
+    else if (strSetting == "writebuffer")
+        profile.nWriteBuffer = nValue << 20;
+    else if (strSetting == "bloombits")
+        profile.nBloomBits = nValue;
+    else if (strSetting == "compression")
+        profile.fCompression = nValue != 0;
+    else if (strSetting == "maxopenfiles")
+        profile.nMaxOpenFiles = nValue;
+    else
+        return false;
+    return true;
+}
+
+boost::mutex csDBStats;
+std::list<CDBStatsEntry> listDBStats;
+
+} // anon namespace
+
+CDBProfile GetDBProfile(const std::string& strName, size_t nCacheSize)
+{
+    CDBProfile profile;
+    profile.strName = strName;
+    if (strName == "exodus") {
+        // The LevelDB defaults the Exodus databases have always used
+        profile.nBlockCache = 8 << 20;
+        profile.nWriteBuffer = 4 << 20;
+        profile.nBloomBits = 0;
+    } else {
+        profile.nBlockCache = nCacheSize / 2;
+        profile.nWriteBuffer = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+        profile.nBloomBits = 10;
+    }
+    profile.fCompression = false;
+    profile.nMaxOpenFiles = 64;
+
+    std::map<std::string, std::vector<std::string> >::const_iterator it = mapMultiArgs.find("-dboption");
+    if (it != mapMultiArgs.end()) {
+        BOOST_FOREACH(const std::string& strOption, it->second) {
+            std::string strProfile, strSetting;
+            int64_t nValue;
+            if (ParseDBOption(strOption, strProfile, strSetting, nValue) && strProfile == strName)
+                ApplyDBOption(profile, strSetting, nValue);
+        }
+    }
+    return profile;
+}
+
+bool CheckDBOptions(std::string& strError)
+{
+    std::map<std::string, std::vector<std::string> >::const_iterator it = mapMultiArgs.find("-dboption");
+    if (it == mapMultiArgs.end())
+        return true;
+    BOOST_FOREACH(const std::string& strOption, it->second) {
+        std::string strProfile, strSetting;
+        int64_t nValue;
+        CDBProfile profile;
+        if (!ParseDBOption(strOption, strProfile, strSetting, nValue) || !ApplyDBOption(profile, strSetting, nValue)) {
+            strError = strprintf(_("Invalid -dboption '%s', expected <profile>:<setting>=<value>"), strOption);
+            return false;
+        }
+        if (strProfile != "chainstate" && strProfile != "blockindex" && strProfile != "addressindex" &&
+                strProfile != "spentindex" && strProfile != "timestampindex" && strProfile != "exodus") {
+            strError = strprintf(_("Unknown database profile in -dboption '%s'"), strOption);
+            return false;
+        }
+        if ((strSetting == "writebuffer" || strSetting == "maxopenfiles") && nValue == 0) {
+            strError = strprintf(_("Invalid -dboption '%s', the value has to be positive"), strOption);
+            return false;
+        }
+    }
+    return true;
+}
+
+void ApplyDBProfile(leveldb::Options& options, const CDBProfile& profile, CDBStats* stats)
+{
+    options.block_cache = new CCountingCache(profile.nBlockCache, stats);
+    options.write_buffer_size = profile.nWriteBuffer;
+    options.filter_policy = profile.nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(profile.nBloomBits) : NULL;
+    options.compression = profile.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.max_open_files = profile.nMaxOpenFiles;
+}
+
+void RegisterDBStats(const CDBStatsEntry& entry)
+{
+    boost::unique_lock<boost::mutex> lock(csDBStats);
+    listDBStats.push_back(entry);
+}
+
+void UnregisterDBStats(const leveldb::DB* pdb)
+{
+    boost::unique_lock<boost::mutex> lock(csDBStats);
+    for (std::list<CDBStatsEntry>::iterator it = listDBStats.begin(); it != listDBStats.end(); it++) {
+        if (it->pdb == pdb) {
+            listDBStats.erase(it);
+            return;
+        }
+    }
+}
+
+void ForEachDBStats(const boost::function<void (const CDBStatsEntry&)>& visitor)
+{
+    boost::unique_lock<boost::mutex> lock(csDBStats);
+    BOOST_FOREACH(const CDBStatsEntry& entry, listDBStats)
+        visitor(entry);
+}
+
+static leveldb::Options GetOptions(const CDBProfile& profile, CDBStats* stats)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    ApplyDBProfile(options, profile, stats);
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
@@ -31,14 +189,19 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate,
+                       const std::string& strProfile)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    CDBProfile profile = GetDBProfile(strProfile.empty() ? path.filename().string() : strProfile, nCacheSize);
+    options = GetOptions(profile, &stats);
+    LogPrintf("Using LevelDB profile %s: %.1fMiB block cache, %.1fMiB write buffer, %d bloom filter bits, compression %s, %d open files\n",
+              profile.strName, profile.nBlockCache * (1.0 / 1024 / 1024), profile.nWriteBuffer * (1.0 / 1024 / 1024),
+              profile.nBloomBits, profile.fCompression ? "on" : "off", profile.nMaxOpenFiles);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -74,10 +237,19 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    CDBStatsEntry entry;
+    entry.strName = profile.strName;
+    entry.profile = profile;
+    entry.pdb = pdb;
+    entry.pstats = &stats;
+    entry.fAccessCounters = true;
+    RegisterDBStats(entry);
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    UnregisterDBStats(pdb);
     delete pdb;
     pdb = NULL;
     delete options.filter_policy;
@@ -92,6 +264,8 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
     dbwrapper_private::HandleError(status);
+    stats.nBatches++;
+    stats.nBytesWritten += batch.nSize;
     return true;
 }
 
@@ -12,7 +12,11 @@
 #include "utilstrencodings.h"
 #include "version.h"
 
+#include <atomic>
+#include <string>
+
 #include <boost/filesystem/path.hpp>
+#include <boost/function.hpp>
 
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
@@ -25,6 +29,68 @@ public:
 
 class CDBWrapper;
 
+/**
+ * LevelDB tuning of a database. Every database opens with the profile of its
+ * kind (chainstate, blockindex, addressindex, spentindex, timestampindex or
+ * exodus), which -dboption=<profile>:<setting>=<value> can override.
+ */
+struct CDBProfile
+{
+    std::string strName;
+    //! Block cache, 0 for none
+    size_t nBlockCache;
+    size_t nWriteBuffer;
+    //! Bits per key of the bloom filter, 0 for none
+    int nBloomBits;
+    bool fCompression;
+    int nMaxOpenFiles;
+};
+
+/** Usage counters of a database, reported by getdbstats */
+struct CDBStats
+{
+    //! Point lookups, and those that found nothing
+    std::atomic<uint64_t> nReads;
+    std::atomic<uint64_t> nReadsNotFound;
+    std::atomic<uint64_t> nBatches;
+    std::atomic<uint64_t> nBytesWritten;
+    std::atomic<uint64_t> nIterators;
+    //! Lookups of table blocks in the block cache
+    std::atomic<uint64_t> nCacheHits;
+    std::atomic<uint64_t> nCacheMisses;
+
+    CDBStats() : nReads(0), nReadsNotFound(0), nBatches(0), nBytesWritten(0), nIterators(0), nCacheHits(0), nCacheMisses(0) {}
+};
+
+/** An open database, as listed by getdbstats */
+struct CDBStatsEntry
+{
+    std::string strName;
+    CDBProfile profile;
+    leveldb::DB* pdb;
+    const CDBStats* pstats;
+    //! Whether reads, writes and iterators are counted, or only the block cache
+    bool fAccessCounters;
+};
+
+/**
+ * Profile of a kind of database: the built-in defaults for a cache budget of
+ * nCacheSize bytes, with the -dboption overrides applied.
+ */
+CDBProfile GetDBProfile(const std::string& strName, size_t nCacheSize);
+/** Check the -dboption arguments, to refuse mistakes at startup */
+bool CheckDBOptions(std::string& strError);
+/**
+ * Set the options of a profile, with a block cache that counts hits and
+ * misses in stats. The cache and filter policy are owned by the caller.
+ */
+void ApplyDBProfile(leveldb::Options& options, const CDBProfile& profile, CDBStats* stats);
+
+void RegisterDBStats(const CDBStatsEntry& entry);
+void UnregisterDBStats(const leveldb::DB* pdb);
+/** Visit the open databases; they stay open during the visit */
+void ForEachDBStats(const boost::function<void (const CDBStatsEntry&)>& visitor);
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -49,12 +115,14 @@ class CDBBatch
 private:
     const CDBWrapper &parent;
     leveldb::WriteBatch batch;
+    //! Bytes of the keys and values queued
+    size_t nSize;
 
 public:
     /**
      * @param[in] parent    CDBWrapper that this batch is to be submitted to
      */
-    CDBBatch(const CDBWrapper &parent) : parent(parent) { };
+    CDBBatch(const CDBWrapper &parent) : parent(parent), nSize(0) { };
 
     template <typename K, typename V>
     void Write(const K& key, const V& value)
@@ -71,6 +139,7 @@ public:
         leveldb::Slice slValue(&ssValue[0], ssValue.size());
 
         batch.Put(slKey, slValue);
+        nSize += slKey.size() + slValue.size();
     }
 
     template <typename K>
@@ -82,6 +151,7 @@ public:
         leveldb::Slice slKey(&ssKey[0], ssKey.size());
 
         batch.Delete(slKey);
+        nSize += slKey.size();
     }
 };
 
@@ -173,6 +243,9 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! usage counters, mutable to count reads
+    mutable CDBStats stats;
+
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
@@ -192,8 +265,10 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] strProfile  Kind of database, see CDBProfile. Named after the directory by default.
      */
-    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false,
+               const std::string& strProfile = "");
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -206,9 +281,12 @@ public:
 
         std::string strValue;
         leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        stats.nReads++;
         if (!status.ok()) {
-            if (status.IsNotFound())
+            if (status.IsNotFound()) {
+                stats.nReadsNotFound++;
                 return false;
+            }
             LogPrintf("LevelDB read failure: %s\n", status.ToString());
             dbwrapper_private::HandleError(status);
         }
@@ -240,9 +318,12 @@ public:
 
         std::string strValue;
         leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        stats.nReads++;
         if (!status.ok()) {
-            if (status.IsNotFound())
+            if (status.IsNotFound()) {
+                stats.nReadsNotFound++;
                 return false;
+            }
             LogPrintf("LevelDB read failure: %s\n", status.ToString());
             dbwrapper_private::HandleError(status);
         }
@@ -273,6 +354,7 @@ public:
 
     CDBIterator *NewIterator()
     {
+        stats.nIterators++;
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
@@ -0,0 +1,137 @@
+/**
+ * @file addresskey.cpp
+ *
+ * Provides the fixed-size keys of addresses used by the Exodus state.
+ */
+
+#include "exodus/addresskey.h"
+
+#include "base58.h"
+#include "crypto/common.h"
+#include "pubkey.h"
+#include "script/standard.h"
+#include "sync.h"
+
+#include <boost/variant/get.hpp>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace exodus
+{
+namespace
+{
+//! Guards the intern table
+CCriticalSection cs_intern;
+//! Interned strings, by position
+std::vector<std::string> vInterned;
+//! Positions of the interned strings
+std::unordered_map<std::string, uint32_t> mapInterned;
+}
+
+bool CAddressKey::SetAddress(const std::string& address)
+{
+    CBitcoinAddress parsed(address);
+    CTxDestination dest = parsed.Get();
+    if (const CKeyID* id = boost::get<CKeyID>(&dest)) {
+        data[0] = KEY_PUBKEYHASH;
+        memcpy(data + 1, id->begin(), id->size());
+    } else if (const CScriptID* id = boost::get<CScriptID>(&dest)) {
+        data[0] = KEY_SCRIPTHASH;
+        memcpy(data + 1, id->begin(), id->size());
+    } else {
+        return false;
+    }
+
+    // the decoder skips whitespace, so such strings must keep their own key
+    if (parsed.ToString() != address) {
+        memset(data, 0, sizeof(data));
+        return false;
+    }
+
+    return true;
+}
+
+CAddressKey CAddressKey::FromString(const std::string& address)
+{
+    CAddressKey key;
+    if (address.empty() || key.SetAddress(address)) return key;
+
+    uint32_t pos;
+    {
+        LOCK(cs_intern);
+        std::unordered_map<std::string, uint32_t>::const_iterator it = mapInterned.find(address);
+        if (it != mapInterned.end()) {
+            pos = it->second;
+        } else {
+            pos = vInterned.size();
+            vInterned.push_back(address);
+            mapInterned.insert(std::make_pair(address, pos));
+        }
+    }
+    key.data[0] = KEY_INTERNED;
+    WriteLE32(key.data + 1, pos);
+    return key;
+}
+
+bool CAddressKey::TryFromString(const std::string& address, CAddressKey& key)
+{
+    key = CAddressKey();
+    if (address.empty() || key.SetAddress(address)) return true;
+
+    uint32_t pos;
+    {
+        LOCK(cs_intern);
+        std::unordered_map<std::string, uint32_t>::const_iterator it = mapInterned.find(address);
+        if (it == mapInterned.end()) return false;
+        pos = it->second;
+    }
+    key.data[0] = KEY_INTERNED;
+    WriteLE32(key.data + 1, pos);
+    return true;
+}
+
+std::string CAddressKey::ToString() const
+{
+    CTxDestination dest;
+    if (GetDestination(dest)) {
+        return CBitcoinAddress(dest).ToString();
+    }
+    if (data[0] == KEY_INTERNED) {
+        LOCK(cs_intern);
+        return vInterned[ReadLE32(data + 1)];
+    }
+    return std::string();
+}
+
+bool CAddressKey::GetDestination(CTxDestination& dest) const
+{
+    switch (data[0]) {
+        case KEY_PUBKEYHASH:
+        {
+            CKeyID id;
+            memcpy(id.begin(), data + 1, id.size());
+            dest = id;
+            return true;
+        }
+        case KEY_SCRIPTHASH:
+        {
+            CScriptID id;
+            memcpy(id.begin(), data + 1, id.size());
+            dest = id;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t CAddressKey::GetHash() const
+{
+    // the key and script hashes are uniformly distributed already
+    return static_cast<size_t>(ReadLE64(data + 1)) ^ data[0];
+}
+}
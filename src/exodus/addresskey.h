@@ -0,0 +1,74 @@
+#ifndef EXODUS_ADDRESSKEY_H
+#define EXODUS_ADDRESSKEY_H
+
+#include "script/standard.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+
+namespace exodus
+{
+/**
+ * Fixed-size key of an address in the Exodus state.
+ *
+ * Addresses are stored as a type byte followed by the 160 bit hash of the key
+ * or script, instead of their Base58 form. Strings that are not addresses of
+ * the current network are interned, and the key holds their position in the
+ * intern table, so that every string still maps to a key and back.
+ *
+ * Converting between strings and keys costs a Base58 encoding or decoding, so
+ * keys should be made once when parsing input and converted back for output only.
+ */
+class CAddressKey
+{
+public:
+    static const size_t SIZE = 21;
+
+    CAddressKey() { memset(data, 0, sizeof(data)); }
+
+    /** Returns the key of the given address, interning it if it is not a valid address. */
+    static CAddressKey FromString(const std::string& address);
+
+    /**
+     * Looks up the key of the given address without interning it.
+     *
+     * Fails for strings that are neither valid addresses nor interned already,
+     * which can not be in the Exodus state.
+     */
+    static bool TryFromString(const std::string& address, CAddressKey& key);
+
+    /** Returns the address the key was created from. */
+    std::string ToString() const;
+
+    /** Returns the destination of the key, if it is the key of a valid address. */
+    bool GetDestination(CTxDestination& dest) const;
+
+    /** Returns a hash of the key for unordered containers. */
+    size_t GetHash() const;
+
+    bool operator==(const CAddressKey& other) const { return memcmp(data, other.data, sizeof(data)) == 0; }
+    bool operator!=(const CAddressKey& other) const { return !(*this == other); }
+
+private:
+    enum KeyType {
+        KEY_EMPTY = 0,
+        KEY_PUBKEYHASH = 1,
+        KEY_SCRIPTHASH = 2,
+        KEY_INTERNED = 3
+    };
+
+    unsigned char data[SIZE];
+
+    /** Sets the key to the hash of the address, if it is a valid address, which encodes back to the same string. */
+    bool SetAddress(const std::string& address);
+};
+
+struct CAddressKeyHasher
+{
+    size_t operator()(const CAddressKey& key) const { return key.GetHash(); }
+};
+}
+
+#endif // EXODUS_ADDRESSKEY_H
@@ -60,6 +60,24 @@ std::string GenerateConsensusString(const CMPTally& tallyObj, const std::string&
             address, propertyId, balance, sellOfferReserve, acceptReserve, metaDExReserve);
 }
 
+// Checks whether a tally object holds any tokens of the property
+static bool HasBalance(const CMPTally& tallyObj, const uint32_t propertyId)
+{
+    return tallyObj.getMoney(propertyId, BALANCE) || tallyObj.getMoney(propertyId, SELLOFFER_RESERVE) ||
+            tallyObj.getMoney(propertyId, ACCEPT_RESERVE) || tallyObj.getMoney(propertyId, METADEX_RESERVE);
+}
+
+// Checks whether a tally object holds any tokens at all
+static bool HasBalance(CMPTally& tallyObj)
+{
+    tallyObj.init();
+    uint32_t propertyId = 0;
+    while (0 != (propertyId = tallyObj.next())) {
+        if (HasBalance(tallyObj, propertyId)) return true;
+    }
+    return false;
+}
+
 // Generates a consensus string for hashing based on a DEx sell offer object
 std::string GenerateConsensusString(const CMPOffer& offerObj, const std::string& address)
 {
@@ -160,13 +178,16 @@ uint256 GetConsensusHash()
     // Balances - loop through the tally map, updating the sha context with the data from each balance and tally type
     // Placeholders:  "address|propertyid|balance|selloffer_reserve|accept_reserve|metadex_reserve"
     // Sort alphabetically first
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
+    // Only addresses with balances are added, so only those need to be encoded
+    std::map<std::string, CMPTally*> tallyMapSorted;
+    for (TallyMap::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
+        if (HasBalance(uoit->second)) {
+            tallyMapSorted.insert(std::make_pair(uoit->first.ToString(), &uoit->second));
+        }
     }
-    for (std::map<string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
+    for (std::map<string, CMPTally*>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
         const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
+        CMPTally& tally = *my_it->second;
         tally.init();
         uint32_t propertyId = 0;
         while (0 != (propertyId = (tally.next()))) {
@@ -318,22 +339,17 @@ uint256 GetBalancesHash(const uint32_t hashPropertyId)
 
     LOCK(cs_tally);
 
-    std::map<std::string, CMPTally> tallyMapSorted;
-    for (std::unordered_map<string, CMPTally>::iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
-        tallyMapSorted.insert(std::make_pair(uoit->first,uoit->second));
+    std::map<std::string, const CMPTally*> tallyMapSorted;
+    for (TallyMap::const_iterator uoit = mp_tally_map.begin(); uoit != mp_tally_map.end(); ++uoit) {
+        if (HasBalance(uoit->second, hashPropertyId)) {
+            tallyMapSorted.insert(std::make_pair(uoit->first.ToString(), &uoit->second));
+        }
     }
-    for (std::map<string, CMPTally>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
+    for (std::map<string, const CMPTally*>::iterator my_it = tallyMapSorted.begin(); my_it != tallyMapSorted.end(); ++my_it) {
         const std::string& address = my_it->first;
-        CMPTally& tally = my_it->second;
-        tally.init();
-        uint32_t propertyId = 0;
-        while (0 != (propertyId = (tally.next()))) {
-            if (propertyId != hashPropertyId) continue;
-            std::string dataStr = GenerateConsensusString(tally, address, propertyId);
-            if (dataStr.empty()) continue;
-            if (exodus_debug_consensus_hash) PrintToLog("Adding data to balances hash: %s\n", dataStr);
-            SHA256_Update(&shaCtx, dataStr.c_str(), dataStr.length());
-        }
+        std::string dataStr = GenerateConsensusString(*my_it->second, address, hashPropertyId);
+        if (exodus_debug_consensus_hash) PrintToLog("Adding data to balances hash: %s\n", dataStr);
+        SHA256_Update(&shaCtx, dataStr.c_str(), dataStr.length());
     }
 
     uint256 balancesHash;
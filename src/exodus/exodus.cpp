@@ -17,6 +17,7 @@
 #include "exodus/mdex.h"
 #include "exodus/notifications.h"
 #include "exodus/pending.h"
+#include "exodus/perfstats.h"
 #include "exodus/persistence.h"
 #include "exodus/rules.h"
 #include "exodus/script.h"
@@ -250,11 +251,19 @@ CMPSPInfo *exodus::_my_sps;
 CrowdMap exodus::my_crowds;
 
 // this is the master list of all amounts for all addresses for all properties, map is unsorted
-std::unordered_map<std::string, CMPTally> exodus::mp_tally_map;
+TallyMap exodus::mp_tally_map;
 
 CMPTally* exodus::getTally(const std::string& address)
 {
-    std::unordered_map<std::string, CMPTally>::iterator it = mp_tally_map.find(address);
+    CAddressKey key;
+    if (!CAddressKey::TryFromString(address, key)) return (CMPTally *) NULL;
+
+    return getTally(key);
+}
+
+CMPTally* exodus::getTally(const CAddressKey& address)
+{
+    TallyMap::iterator it = mp_tally_map.find(address);
 
     if (it != mp_tally_map.end()) return &(it->second);
 
@@ -263,6 +272,14 @@ CMPTally* exodus::getTally(const std::string& address)
 
 // look at balance for an address
 int64_t getMPbalance(const std::string& address, uint32_t propertyId, TallyType ttype)
+{
+    CAddressKey key;
+    if (!CAddressKey::TryFromString(address, key)) return 0; // never credited, so it holds nothing
+
+    return getMPbalance(key, propertyId, ttype);
+}
+
+int64_t getMPbalance(const CAddressKey& address, uint32_t propertyId, TallyType ttype)
 {
     int64_t balance = 0;
     if (TALLY_TYPE_COUNT <= ttype) {
@@ -274,7 +291,7 @@ int64_t getMPbalance(const std::string& address, uint32_t propertyId, TallyType
     }
 
     LOCK(cs_tally);
-    const std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.find(address);
+    const TallyMap::iterator my_it = mp_tally_map.find(address);
     if (my_it != mp_tally_map.end()) {
         balance = (my_it->second).getMoney(propertyId, ttype);
     }
@@ -283,6 +300,14 @@ int64_t getMPbalance(const std::string& address, uint32_t propertyId, TallyType
 }
 
 int64_t getUserAvailableMPbalance(const std::string& address, uint32_t propertyId)
+{
+    CAddressKey key;
+    if (!CAddressKey::TryFromString(address, key)) return 0;
+
+    return getUserAvailableMPbalance(key, propertyId);
+}
+
+int64_t getUserAvailableMPbalance(const CAddressKey& address, uint32_t propertyId)
 {
     int64_t money = getMPbalance(address, propertyId, BALANCE);
     int64_t pending = getMPbalance(address, propertyId, PENDING);
@@ -437,7 +462,7 @@ int64_t exodus::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
     }
 
     if (!property.fixed || n_owners_total) {
-        for (std::unordered_map<std::string, CMPTally>::const_iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
+        for (TallyMap::const_iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
             const CMPTally& tally = it->second;
 
             totalTokens += tally.getMoney(propertyId, BALANCE);
@@ -465,13 +490,28 @@ int64_t exodus::getTotalTokens(uint32_t propertyId, int64_t* n_owners_total)
 
 // return true if everything is ok
 bool exodus::update_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype)
+{
+    // only credits and pending debits, which may go negative, add addresses to the state, any other debit
+    // of an unknown string fails like one of an empty tally
+    CAddressKey key;
+    if (0 < amount || PENDING == ttype) {
+        key = CAddressKey::FromString(who);
+    } else if (!CAddressKey::TryFromString(who, key) && 0 != amount) {
+        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: no balance to debit\n", __func__, who, propertyId, propertyId, amount, ttype);
+        return false;
+    }
+
+    return update_tally_map(key, propertyId, amount, ttype);
+}
+
+bool exodus::update_tally_map(const CAddressKey& who, uint32_t propertyId, int64_t amount, TallyType ttype)
 {
     if (0 == amount) {
-        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: amount to credit or debit is zero\n", __func__, who, propertyId, propertyId, amount, ttype);
+        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: amount to credit or debit is zero\n", __func__, who.ToString(), propertyId, propertyId, amount, ttype);
         return false;
     }
     if (ttype >= TALLY_TYPE_COUNT) {
-        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: invalid tally type\n", __func__, who, propertyId, propertyId, amount, ttype);
+        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: invalid tally type\n", __func__, who.ToString(), propertyId, propertyId, amount, ttype);
         return false;
     }
 
@@ -481,13 +521,13 @@ bool exodus::update_tally_map(const std::string& who, uint32_t propertyId, int64
 
     LOCK(cs_tally);
 
-    if (ttype == BALANCE && amount < 0) {
-        assert(!isAddressFrozen(who, propertyId)); // for safety, this should never fail if everything else is working properly.
+    if (ttype == BALANCE && amount < 0 && !setFrozenAddresses.empty()) {
+        assert(!isAddressFrozen(who.ToString(), propertyId)); // for safety, this should never fail if everything else is working properly.
     }
 
     before = getMPbalance(who, propertyId, ttype);
 
-    std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.find(who);
+    TallyMap::iterator my_it = mp_tally_map.find(who);
     if (my_it == mp_tally_map.end()) {
         // insert an empty element
         my_it = (mp_tally_map.insert(std::make_pair(who, CMPTally()))).first;
@@ -495,14 +535,18 @@ bool exodus::update_tally_map(const std::string& who, uint32_t propertyId, int64
 
     CMPTally& tally = my_it->second;
     bRet = tally.updateMoney(propertyId, amount, ttype);
+    if (bRet) {
+        WalletCacheMarkDirty(who);
+        PerfIncrement(PERF_TALLY_UPDATES);
+    }
 
     after = getMPbalance(who, propertyId, ttype);
     if (!bRet) {
         assert(before == after);
-        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: insufficient balance (=%d)\n", __func__, who, propertyId, propertyId, amount, ttype, before);
+        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d) ERROR: insufficient balance (=%d)\n", __func__, who.ToString(), propertyId, propertyId, amount, ttype, before);
     }
-    if (exodus_debug_tally && (exodus_address != who || exodus_debug_exo)) {
-        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d): before=%d, after=%d\n", __func__, who, propertyId, propertyId, amount, ttype, before, after);
+    if (exodus_debug_tally && (exodus_debug_exo || exodus_address != who.ToString())) {
+        PrintToLog("%s(%s, %u=0x%X, %+d, ttype=%d): before=%d, after=%d\n", __func__, who.ToString(), propertyId, propertyId, amount, ttype, before, after);
     }
 
     return bRet;
@@ -604,9 +648,12 @@ void CheckWalletUpdate(bool forceUpdate)
     global_balance_reserved.clear();
 
     // populate global balance totals and wallet property list - note global balances do not include additional balances from watch-only addresses
-    for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        // check if the address is a wallet address (including watched addresses)
-        std::string address = my_it->first;
+    // only wallet addresses (including watched addresses) are considered, as tracked by the wallet cache
+    std::vector<CAddressKey> walletAddresses = WalletCacheGetAddresses();
+    for (std::vector<CAddressKey>::const_iterator it = walletAddresses.begin(); it != walletAddresses.end(); ++it) {
+        const CAddressKey& address = *it;
+        TallyMap::iterator my_it = mp_tally_map.find(address);
+        if (my_it == mp_tally_map.end()) continue;
         int addressIsMine = IsMyAddress(address);
         if (!addressIsMine) continue;
         // iterate only those properties in the TokenMap for this address
@@ -735,9 +782,6 @@ CCoinsViewCache exodus::view(&viewDummy);
 //! Guards coins view cache
 CCriticalSection exodus::cs_tx_cache;
 
-static unsigned int nCacheHits = 0;
-static unsigned int nCacheMiss = 0;
-
 /**
  * Fetches transaction inputs and adds them to the coins view cache.
  *
@@ -752,7 +796,7 @@ static bool FillTxInputCache(const CTransaction& tx)
 
     if (view.GetCacheSize() > nCacheSize) {
         PrintToLog("%s(): clearing cache before insertion [size=%d, hit=%d, miss=%d]\n",
-                __func__, view.GetCacheSize(), nCacheHits, nCacheMiss);
+                __func__, view.GetCacheSize(), PerfGetCounter(PERF_INPUT_CACHE_HITS), PerfGetCounter(PERF_INPUT_CACHE_MISSES));
         view.Flush();
     }
 
@@ -762,10 +806,10 @@ static bool FillTxInputCache(const CTransaction& tx)
         CCoinsModifier coins = view.ModifyCoins(txIn.prevout.hash);
 
         if (coins->IsAvailable(nOut)) {
-            ++nCacheHits;
+            PerfIncrement(PERF_INPUT_CACHE_HITS);
             continue;
         } else {
-            ++nCacheMiss;
+            PerfIncrement(PERF_INPUT_CACHE_MISSES);
         }
 
         CTransaction txPrev;
@@ -1397,7 +1441,7 @@ int input_exodus_balances_string(const std::string& s)
     boost::split(addrData, s, boost::is_any_of("="), boost::token_compress_on);
     if (addrData.size() != 2) return -1;
 
-    std::string strAddress = addrData[0];
+    const CAddressKey address = CAddressKey::FromString(addrData[0]);
 
     // split the tuples of properties
     std::vector<std::string> vProperties;
@@ -1426,10 +1470,10 @@ int input_exodus_balances_string(const std::string& s)
         int64_t acceptReserved = boost::lexical_cast<int64_t>(curBalance[2]);
         int64_t metadexReserved = boost::lexical_cast<int64_t>(curBalance[3]);
 
-        if (balance) update_tally_map(strAddress, propertyId, balance, BALANCE);
-        if (sellReserved) update_tally_map(strAddress, propertyId, sellReserved, SELLOFFER_RESERVE);
-        if (acceptReserved) update_tally_map(strAddress, propertyId, acceptReserved, ACCEPT_RESERVE);
-        if (metadexReserved) update_tally_map(strAddress, propertyId, metadexReserved, METADEX_RESERVE);
+        if (balance) update_tally_map(address, propertyId, balance, BALANCE);
+        if (sellReserved) update_tally_map(address, propertyId, sellReserved, SELLOFFER_RESERVE);
+        if (acceptReserved) update_tally_map(address, propertyId, acceptReserved, ACCEPT_RESERVE);
+        if (metadexReserved) update_tally_map(address, propertyId, metadexReserved, METADEX_RESERVE);
     }
 
     return 0;
@@ -1610,6 +1654,7 @@ static int exodus_file_load(const string &filename, int what, bool verifyHash =
   {
     case FILETYPE_BALANCES:
       mp_tally_map.clear();
+      WalletCacheMarkAllDirty();
       inputLineFunc = input_exodus_balances_string;
       break;
 
@@ -1633,11 +1678,7 @@ static int exodus_file_load(const string &filename, int what, bool verifyHash =
       break;
 
     case FILETYPE_MDEXORDERS:
-      // FIXME
-      // memory leak ... gotta unallocate inner layers first....
-      // TODO
-      // ...
-      metadex.clear();
+      MetaDEx_CLEAR();
       inputLineFunc = input_mp_mdexorder_string;
       break;
 
@@ -1832,11 +1873,11 @@ static int load_most_relevant_state()
 
 static int write_exodus_balances(std::ofstream& file, SHA256_CTX* shaCtx)
 {
-    std::unordered_map<std::string, CMPTally>::iterator iter;
+    TallyMap::iterator iter;
     for (iter = mp_tally_map.begin(); iter != mp_tally_map.end(); ++iter) {
         bool emptyWallet = true;
 
-        std::string lineOut = (*iter).first;
+        std::string lineOut = (*iter).first.ToString();
         lineOut.append("=");
         CMPTally& curAddr = (*iter).second;
         curAddr.init();
@@ -2096,10 +2137,11 @@ void clear_all_state()
 
     // Memory based storage
     mp_tally_map.clear();
+    WalletCacheMarkAllDirty();
     my_offers.clear();
     my_accepts.clear();
     my_crowds.clear();
-    metadex.clear();
+    MetaDEx_CLEAR();
     my_pending.clear();
     ResetConsensusParams();
     ClearActivations();
@@ -2336,23 +2378,37 @@ bool exodus_handler_tx(const CTransaction& tx, int nBlock, unsigned int idx, con
     CMPTransaction mp_obj;
     mp_obj.unlockLogic();
 
+    PerfIncrement(PERF_TRANSACTIONS);
+
     bool fFoundTx = false;
-    int pop_ret = parseTransaction(false, tx, nBlock, idx, mp_obj, nBlockTime);
+    int pop_ret;
+    {
+        CPerfTimer timer(PERF_PARSE);
+        pop_ret = parseTransaction(false, tx, nBlock, idx, mp_obj, nBlockTime);
+    }
 
     if (0 == pop_ret) {
-        int interp_ret = mp_obj.interpretPacket();
+        int interp_ret;
+        {
+            CPerfTimer timer(PERF_INTERPRET);
+            interp_ret = mp_obj.interpretPacket();
+        }
         if (interp_ret) PrintToLog("!!! interpretPacket() returned %d !!!\n", interp_ret);
 
         // Only structurally valid transactions get recorded in levelDB
         // PKT_ERROR - 2 = interpret_Transaction failed, structurally invalid payload
         if (interp_ret != PKT_ERROR - 2) {
+            CPerfTimer timer(PERF_DB_WRITE);
             bool bValid = (0 <= interp_ret);
             p_txlistdb->recordTX(tx.GetHash(), bValid, nBlock, mp_obj.getType(), mp_obj.getNewAmount());
             p_ExodusTXDB->RecordTransaction(tx.GetHash(), idx, interp_ret);
+            PerfIncrement(PERF_DB_WRITES, 2);
         }
         fFoundTx |= (interp_ret == 0);
     }
 
+    if (fFoundTx) PerfIncrement(PERF_EXODUS_TRANSACTIONS);
+
     if (fFoundTx && exodus_debug_consensus_hash_every_transaction) {
         uint256 consensusHash = GetConsensusHash();
         PrintToLog("Consensus hash for transaction %s: %s\n", tx.GetHash().GetHex(), consensusHash.GetHex());
@@ -3816,6 +3872,9 @@ int exodus_handler_block_begin(int nBlockPrev, CBlockIndex const * pBlockIndex)
 {
     LOCK(cs_tally);
 
+    CPerfTimer timer(PERF_BLOCK_BEGIN);
+    PerfIncrement(PERF_BLOCKS);
+
     if (reorgRecoveryMode > 0) {
         reorgRecoveryMode = 0; // clear reorgRecovery here as this is likely re-entrant
 
@@ -3876,6 +3935,8 @@ int exodus_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
         exodus_init();
     }
 
+    CPerfTimer timer(PERF_BLOCK_END);
+
     // for every new received block must do:
     // 1) remove expired entries from the accept list (per spec accept entries are
     //    valid until their blocklimit expiration; because the customer can keep
@@ -3926,6 +3987,7 @@ int exodus_handler_block_end(int nBlockNow, CBlockIndex const * pBlockIndex,
     } else {
         // save out the state after this block
         if (writePersistence(nBlockNow)) {
+            CPerfTimer persistenceTimer(PERF_PERSISTENCE);
             exodus_save_state(pBlockIndex);
         }
     }
@@ -7,6 +7,7 @@ class CCoinsView;
 class CCoinsViewCache;
 class CTransaction;
 
+#include "exodus/addresskey.h"
 #include "exodus/log.h"
 #include "exodus/persistence.h"
 #include "exodus/tally.h"
@@ -296,7 +297,9 @@ extern std::map<uint32_t, int64_t> global_balance_reserved;
 extern std::set<uint32_t> global_wallet_property_list;
 
 int64_t getMPbalance(const std::string& address, uint32_t propertyId, TallyType ttype);
+int64_t getMPbalance(const exodus::CAddressKey& address, uint32_t propertyId, TallyType ttype);
 int64_t getUserAvailableMPbalance(const std::string& address, uint32_t propertyId);
+int64_t getUserAvailableMPbalance(const exodus::CAddressKey& address, uint32_t propertyId);
 int64_t getUserFrozenMPbalance(const std::string& address, uint32_t propertyId);
 
 bool isExodusEnabled();
@@ -322,7 +325,10 @@ int exodus_save_state( CBlockIndex const *pBlockIndex );
 
 namespace exodus
 {
-extern std::unordered_map<std::string, CMPTally> mp_tally_map;
+//! Balances of all addresses, keyed by their fixed-size form
+typedef std::unordered_map<CAddressKey, CMPTally, CAddressKeyHasher> TallyMap;
+
+extern TallyMap mp_tally_map;
 extern CMPTxList *p_txlistdb;
 extern CMPTradeList *t_tradelistdb;
 extern CMPSTOList *s_stolistdb;
@@ -348,6 +354,7 @@ bool isMainEcosystemProperty(uint32_t propertyId);
 uint32_t GetNextPropertyId(bool maineco); // maybe move into sp
 
 CMPTally* getTally(const std::string& address);
+CMPTally* getTally(const CAddressKey& address);
 
 int64_t getTotalTokens(uint32_t propertyId, int64_t* n_owners_total = NULL);
 
@@ -362,6 +369,7 @@ bool UseEncodingClassC(size_t nDataSize);
 bool getValidMPTX(const uint256 &txid, int *block = NULL, unsigned int *type = NULL, uint64_t *nAmended = NULL);
 
 bool update_tally_map(const std::string& who, uint32_t propertyId, int64_t amount, TallyType ttype);
+bool update_tally_map(const CAddressKey& who, uint32_t propertyId, int64_t amount, TallyType ttype);
 
 std::string getTokenLabel(uint32_t propertyId);
 
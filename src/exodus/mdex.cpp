@@ -4,6 +4,7 @@
 #include "exodus/fees.h"
 #include "exodus/log.h"
 #include "exodus/exodus.h"
+#include "exodus/perfstats.h"
 #include "exodus/rules.h"
 #include "exodus/sp.h"
 #include "exodus/tx.h"
@@ -25,11 +26,13 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <algorithm>
 #include <fstream>
 #include <limits>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 typedef boost::multiprecision::cpp_dec_float_100 dec_float;
 typedef boost::multiprecision::checked_int128_t int128_t;
@@ -60,6 +63,75 @@ md_Set* exodus::get_Indexes(md_PricesMap* p, rational_t price)
     return (md_Set*) NULL;
 }
 
+//! Open orders by txid, pointing into the order book
+static md_TxidIndex metadex_txids;
+//! Txids of open orders by address
+static md_AddressIndex metadex_addresses;
+
+static void IndexOrder(uint32_t property, md_PricesMap::iterator priceIt, md_Set::iterator orderIt)
+{
+    md_OrderHandle handle = {property, priceIt, orderIt};
+    metadex_txids[orderIt->getHash()] = handle;
+    metadex_addresses[orderIt->getAddr()].insert(orderIt->getHash());
+}
+
+static void UnindexOrder(const CMPMetaDEx& obj)
+{
+    metadex_txids.erase(obj.getHash());
+
+    md_AddressIndex::iterator it = metadex_addresses.find(obj.getAddr());
+    if (it != metadex_addresses.end()) {
+        it->second.erase(obj.getHash());
+        if (it->second.empty()) metadex_addresses.erase(it);
+    }
+}
+
+/**
+ * Removes an order from the order book and the indexes.
+ *
+ * The price level is dropped once it is empty, so other handles stay valid.
+ */
+static void EraseOrder(const md_OrderHandle& handle)
+{
+    UnindexOrder(*handle.orderIt);
+
+    md_Set& indexes = handle.priceIt->second;
+    indexes.erase(handle.orderIt);
+    if (indexes.empty()) metadex[handle.property].erase(handle.priceIt);
+}
+
+// sorts handles the same way the order book is traversed: by property, price, block and index
+struct OrderHandle_compare
+{
+    bool operator()(const md_OrderHandle& lhs, const md_OrderHandle& rhs) const
+    {
+        if (lhs.property != rhs.property) return lhs.property < rhs.property;
+        if (lhs.priceIt->first != rhs.priceIt->first) return lhs.priceIt->first < rhs.priceIt->first;
+        return MetaDEx_compare()(*lhs.orderIt, *rhs.orderIt);
+    }
+};
+
+/**
+ * Returns the open orders of an address, in order book order.
+ */
+static std::vector<md_OrderHandle> GetOrdersForAddress(const std::string& address)
+{
+    std::vector<md_OrderHandle> handles;
+
+    md_AddressIndex::const_iterator it = metadex_addresses.find(address);
+    if (it == metadex_addresses.end()) return handles;
+
+    handles.reserve(it->second.size());
+    for (std::set<uint256>::const_iterator txidIt = it->second.begin(); txidIt != it->second.end(); ++txidIt) {
+        md_TxidIndex::const_iterator handleIt = metadex_txids.find(*txidIt);
+        assert(handleIt != metadex_txids.end());
+        handles.push_back(handleIt->second);
+    }
+    std::sort(handles.begin(), handles.end(), OrderHandle_compare());
+
+    return handles;
+}
+
 enum MatchReturnType
 {
     NOTHING = 0,
@@ -139,6 +211,9 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
     MatchReturnType NewReturn = NOTHING;
     bool bBuyerSatisfied = false;
 
+    // the buyer's inverse price does not change while its remaining amount is filled
+    const CMPPrice buyersPrice = pnew->matchInversePrice();
+
     if (exodus_debug_metadex1) PrintToLog("%s(%s: prop=%d, desprop=%d, desprice= %s);newo: %s\n",
         __FUNCTION__, pnew->getAddr(), propertyForSale, propertyDesired, xToString(pnew->inversePrice()), pnew->ToString());
 
@@ -151,15 +226,17 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
     }
 
     // within the desired property map (given one property) iterate over the items looking at prices
-    for (md_PricesMap::iterator priceIt = ppriceMap->begin(); priceIt != ppriceMap->end(); ++priceIt) { // check all prices
-        const rational_t sellersPrice = priceIt->first;
+    md_PricesMap::iterator priceIt = ppriceMap->begin();
+    while (priceIt != ppriceMap->end()) { // check all prices
+        const CMPPrice sellersPrice(priceIt->first);
 
         if (exodus_debug_metadex2) PrintToLog("comparing prices: desprice %s needs to be GREATER THAN OR EQUAL TO %s\n",
-            xToString(pnew->inversePrice()), xToString(sellersPrice));
+            xToString(pnew->inversePrice()), xToString(priceIt->first));
 
         // Is the desired price check satisfied? The buyer's inverse price must be larger than that of the seller.
-        if (pnew->inversePrice() < sellersPrice) {
-            continue;
+        // Price levels are sorted in ascending order, so none of the remaining levels can satisfy it either.
+        if (buyersPrice < sellersPrice) {
+            break;
         }
 
         md_Set* const pofferSet = &(priceIt->second);
@@ -168,10 +245,10 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
         md_Set::iterator offerIt = pofferSet->begin();
         while (offerIt != pofferSet->end()) { // specific price, check all properties
             const CMPMetaDEx* const pold = &(*offerIt);
-            assert(pold->unitPrice() == sellersPrice);
+            assert(pold->matchUnitPrice() == sellersPrice);
 
             if (exodus_debug_metadex1) PrintToLog("Looking at existing: %s (its prop= %d, its des prop= %d) = %s\n",
-                xToString(sellersPrice), pold->getProperty(), pold->getDesProperty(), pold->ToString());
+                xToString(priceIt->first), pold->getProperty(), pold->getDesProperty(), pold->ToString());
 
             // does the desired property match?
             if (pold->getDesProperty() != propertyForSale) {
@@ -179,14 +256,14 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
                 continue;
             }
 
-            if (exodus_debug_metadex1) PrintToLog("MATCH FOUND, Trade: %s = %s\n", xToString(sellersPrice), pold->ToString());
+            if (exodus_debug_metadex1) PrintToLog("MATCH FOUND, Trade: %s = %s\n", xToString(priceIt->first), pold->ToString());
 
             // match found, execute trade now!
             const int64_t seller_amountForSale = pold->getAmountRemaining();
             const int64_t buyer_amountOffered = pnew->getAmountRemaining();
 
             if (exodus_debug_metadex1) PrintToLog("$$ trading using price: %s; seller: forsale=%d, desired=%d, remaining=%d, buyer amount offered=%d\n",
-                xToString(sellersPrice), pold->getAmountForSale(), pold->getAmountDesired(), pold->getAmountRemaining(), pnew->getAmountRemaining());
+                xToString(priceIt->first), pold->getAmountForSale(), pold->getAmountDesired(), pold->getAmountRemaining(), pnew->getAmountRemaining());
             if (exodus_debug_metadex1) PrintToLog("$$ old: %s\n", pold->ToString());
             if (exodus_debug_metadex1) PrintToLog("$$ new: %s\n", pnew->ToString());
 
@@ -198,8 +275,8 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             assert(pnew->getProperty() != pnew->getDesProperty());
             assert(pnew->getProperty() == pold->getDesProperty());
             assert(pold->getProperty() == pnew->getDesProperty());
-            assert(pold->unitPrice() <= pnew->inversePrice());
-            assert(pnew->unitPrice() <= pold->inversePrice());
+            assert(pold->matchUnitPrice() <= buyersPrice);
+            assert(pnew->matchUnitPrice() <= pold->matchInversePrice());
 
             ///////////////////////////
 
@@ -232,11 +309,11 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
 
             // If the resulting adjusted unit price is higher than Alice' price, the
             // orders shall not execute, and no representable fill is made
-            const rational_t xEffectivePrice(nWouldPay, nCouldBuy);
+            const CMPPrice xEffectivePrice(nWouldPay, nCouldBuy);
 
-            if (xEffectivePrice > pnew->inversePrice()) {
+            if (xEffectivePrice > buyersPrice) {
                 if (exodus_debug_metadex1) PrintToLog(
-                        "-- effective price is too expensive: %s\n", xToString(xEffectivePrice));
+                        "-- effective price is too expensive: %s\n", xToString(xEffectivePrice.ToRational()));
                 ++offerIt;
                 continue;
             }
@@ -252,8 +329,8 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             ///////////////////////////
 
             // postconditions
-            assert(xEffectivePrice >= pold->unitPrice());
-            assert(xEffectivePrice <= pnew->inversePrice());
+            assert(xEffectivePrice >= pold->matchUnitPrice());
+            assert(xEffectivePrice <= buyersPrice);
             assert(0 <= seller_amountLeft);
             assert(0 <= buyer_amountLeft);
             assert(seller_amountForSale == seller_amountLeft + buyer_amountGot);
@@ -289,6 +366,7 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             assert(update_tally_map(pnew->getAddr(), pnew->getDesProperty(), buyer_amountGotAfterFee, BALANCE));
 
             NewReturn = TRADED;
+            PerfIncrement(PERF_METADEX_MATCHES);
 
             CMPMetaDEx seller_replacement = *pold; // < can be moved into last if block
             seller_replacement.setAmountRemaining(seller_amountLeft, "seller_replacement");
@@ -312,15 +390,18 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             // record the trade in MPTradeList
             t_tradelistdb->recordMatchedTrade(pold->getHash(), pnew->getHash(), // < might just pass pold, pnew
                 pold->getAddr(), pnew->getAddr(), pold->getDesProperty(), pnew->getDesProperty(), seller_amountGot, buyer_amountGotAfterFee, pnew->getBlock(), tradingFee);
+            PerfIncrement(PERF_DB_WRITES);
 
             if (exodus_debug_metadex1) PrintToLog("++ erased old: %s\n", offerIt->ToString());
             // erase the old seller element
+            UnindexOrder(*offerIt);
             pofferSet->erase(offerIt++);
 
             // insert the updated one in place of the old
             if (0 < seller_replacement.getAmountRemaining()) {
-                PrintToLog("++ inserting seller_replacement: %s\n", seller_replacement.ToString());
-                pofferSet->insert(seller_replacement);
+                if (exodus_debug_metadex1) PrintToLog("++ inserting seller_replacement: %s\n", seller_replacement.ToString());
+                md_Set::iterator replacementIt = pofferSet->insert(seller_replacement).first;
+                IndexOrder(propertyDesired, priceIt, replacementIt);
             }
 
             if (bBuyerSatisfied) {
@@ -329,6 +410,13 @@ static MatchReturnType x_Trade(CMPMetaDEx* const pnew)
             }
         } // specific price, check all properties
 
+        // drop the price level, if all of its orders were filled
+        if (pofferSet->empty()) {
+            ppriceMap->erase(priceIt++);
+        } else {
+            ++priceIt;
+        }
+
         if (bBuyerSatisfied) break;
     } // check all prices
 
@@ -416,7 +504,7 @@ int64_t CMPMetaDEx::getBlockTime() const
 void CMPMetaDEx::setAmountRemaining(int64_t amount, const std::string& label)
 {
     amount_remaining = amount;
-    PrintToLog("update remaining amount still up for sale (%ld %s):%s\n", amount, label, ToString());
+    if (exodus_debug_metadex1) PrintToLog("update remaining amount still up for sale (%ld %s):%s\n", amount, label, ToString());
 }
 
 std::string CMPMetaDEx::ToString() const
@@ -456,39 +544,26 @@ bool MetaDEx_compare::operator()(const CMPMetaDEx &lhs, const CMPMetaDEx &rhs) c
 
 bool exodus::MetaDEx_INSERT(const CMPMetaDEx& objMetaDEx)
 {
-    // Create an empty price map (to use in case price map for this property does not already exist)
-    md_PricesMap temp_prices;
-    // Attempt to obtain the price map for the property
-    md_PricesMap *p_prices = get_Prices(objMetaDEx.getProperty());
-
-    // Create an empty set of metadex objects (to use in case no set currently exists at this price)
-    md_Set temp_indexes;
-    md_Set *p_indexes = NULL;
-
-    // Prepare for return code
-    std::pair <md_Set::iterator, bool> ret;
-
-    // Attempt to obtain a set of metadex objects for this price from the price map
-    if (p_prices) p_indexes = get_Indexes(p_prices, objMetaDEx.unitPrice());
-    // See if the set was populated, if not no set exists at this price level, use the empty set that we created earlier
-    if (!p_indexes) p_indexes = &temp_indexes;
+    // Obtain the price map for the property, and the set of metadex objects at this price, creating them as needed
+    md_PricesMap& prices = metadex[objMetaDEx.getProperty()];
+    md_PricesMap::iterator priceIt = prices.insert(std::make_pair(objMetaDEx.unitPrice(), md_Set())).first;
 
     // Attempt to insert the metadex object into the set
-    ret = p_indexes->insert(objMetaDEx);
+    std::pair<md_Set::iterator, bool> ret = priceIt->second.insert(objMetaDEx);
     if (false == ret.second) return false;
 
-    // If a prices map did not exist for this property, set p_prices to the temp empty price map
-    if (!p_prices) p_prices = &temp_prices;
-
-    // Update the prices map with the new set at this price
-    (*p_prices)[objMetaDEx.unitPrice()] = *p_indexes;
-
-    // Set the metadex map for the property to the updated (or new if it didn't exist) price map
-    metadex[objMetaDEx.getProperty()] = *p_prices;
+    IndexOrder(objMetaDEx.getProperty(), priceIt, ret.first);
 
     return true;
 }
 
+void exodus::MetaDEx_CLEAR()
+{
+    metadex.clear();
+    metadex_txids.clear();
+    metadex_addresses.clear();
+}
+
 // pretty much directly linked to the ADD TX21 command off the wire
 int exodus::MetaDEx_ADD(const std::string& sender_addr, uint32_t prop, int64_t amount, int block, uint32_t property_desired, int64_t amount_desired, const uint256& txid, unsigned int idx)
 {
@@ -541,37 +616,30 @@ int exodus::MetaDEx_CANCEL_AT_PRICE(const uint256& txid, unsigned int block, con
         return rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
-    for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
-        rational_t sellers_price = my_it->first;
+    // iterate over the orders of the sender, at the given price and property pair
+    const rational_t price = mdex.unitPrice();
+    std::vector<md_OrderHandle> handles = GetOrdersForAddress(sender_addr);
+    for (std::vector<md_OrderHandle>::const_iterator it = handles.begin(); it != handles.end(); ++it) {
+        if (it->property != prop || it->priceIt->first != price) continue;
 
-        if (mdex.unitPrice() != sellers_price) continue;
+        p_mdex = &(*it->orderIt);
 
-        md_Set* indexes = &(my_it->second);
+        if (exodus_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
 
-        for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
-            p_mdex = &(*iitt);
+        if (p_mdex->getDesProperty() != property_desired) continue;
 
-            if (exodus_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
+        rc = 0;
+        PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
 
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
-                ++iitt;
-                continue;
-            }
-
-            rc = 0;
-            PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
+        // move from reserve to main
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
 
-            // move from reserve to main
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
+        // record the cancellation
+        bool bValid = true;
+        p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
 
-            // record the cancellation
-            bool bValid = true;
-            p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
-
-            indexes->erase(iitt++);
-        }
+        EraseOrder(*it);
     }
 
     if (exodus_debug_metadex2) MetaDEx_debug_print();
@@ -594,33 +662,29 @@ int exodus::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block,
         return rc -1;
     }
 
-    // within the desired property map (given one property) iterate over the items
-    for (md_PricesMap::iterator my_it = prices->begin(); my_it != prices->end(); ++my_it) {
-        md_Set* indexes = &(my_it->second);
+    // iterate over the orders of the sender for the property pair
+    std::vector<md_OrderHandle> handles = GetOrdersForAddress(sender_addr);
+    for (std::vector<md_OrderHandle>::const_iterator it = handles.begin(); it != handles.end(); ++it) {
+        if (it->property != prop) continue;
 
-        for (md_Set::iterator iitt = indexes->begin(); iitt != indexes->end();) {
-            p_mdex = &(*iitt);
+        p_mdex = &(*it->orderIt);
 
-            if (exodus_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
+        if (exodus_debug_metadex3) PrintToLog("%s(): %s\n", __FUNCTION__, p_mdex->ToString());
 
-            if ((p_mdex->getDesProperty() != property_desired) || (p_mdex->getAddr() != sender_addr)) {
-                ++iitt;
-                continue;
-            }
+        if (p_mdex->getDesProperty() != property_desired) continue;
 
-            rc = 0;
-            PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
+        rc = 0;
+        PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, p_mdex->ToString());
 
-            // move from reserve to main
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
-            assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
+        // move from reserve to main
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), -p_mdex->getAmountRemaining(), METADEX_RESERVE));
+        assert(update_tally_map(p_mdex->getAddr(), p_mdex->getProperty(), p_mdex->getAmountRemaining(), BALANCE));
 
-            // record the cancellation
-            bool bValid = true;
-            p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
+        // record the cancellation
+        bool bValid = true;
+        p_txlistdb->recordMetaDExCancelTX(txid, p_mdex->getHash(), bValid, block, p_mdex->getProperty(), p_mdex->getAmountRemaining());
 
-            indexes->erase(iitt++);
-        }
+        EraseOrder(*it);
     }
 
     if (exodus_debug_metadex3) MetaDEx_debug_print();
@@ -629,7 +693,7 @@ int exodus::MetaDEx_CANCEL_ALL_FOR_PAIR(const uint256& txid, unsigned int block,
 }
 
 /**
- * Scans the orderbook and remove everything for an address.
+ * Removes everything for an address from the orderbook.
  */
 int exodus::MetaDEx_CANCEL_EVERYTHING(const uint256& txid, unsigned int block, const std::string& sender_addr, unsigned char ecosystem)
 {
@@ -641,44 +705,28 @@ int exodus::MetaDEx_CANCEL_EVERYTHING(const uint256& txid, unsigned int block, c
 
     PrintToLog("<<<<<<\n");
 
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        unsigned int prop = my_it->first;
+    std::vector<md_OrderHandle> handles = GetOrdersForAddress(sender_addr);
+    for (std::vector<md_OrderHandle>::const_iterator it = handles.begin(); it != handles.end(); ++it) {
+        uint32_t prop = it->property;
 
         // skip property, if it is not in the expected ecosystem
         if (isMainEcosystemProperty(ecosystem) && !isMainEcosystemProperty(prop)) continue;
         if (isTestEcosystemProperty(ecosystem) && !isTestEcosystemProperty(prop)) continue;
 
-        PrintToLog(" ## property: %u\n", prop);
-        md_PricesMap& prices = my_it->second;
+        const CMPMetaDEx& obj = *it->orderIt;
 
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            rational_t price = it->first;
-            md_Set& indexes = it->second;
-
-            PrintToLog("  # Price Level: %s\n", xToString(price));
-
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end();) {
-                PrintToLog("%s= %s\n", xToString(price), it->ToString());
+        rc = 0;
+        PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, obj.ToString());
 
-                if (it->getAddr() != sender_addr) {
-                    ++it;
-                    continue;
-                }
+        // move from reserve to balance
+        assert(update_tally_map(obj.getAddr(), obj.getProperty(), -obj.getAmountRemaining(), METADEX_RESERVE));
+        assert(update_tally_map(obj.getAddr(), obj.getProperty(), obj.getAmountRemaining(), BALANCE));
 
-                rc = 0;
-                PrintToLog("%s(): REMOVING %s\n", __FUNCTION__, it->ToString());
+        // record the cancellation
+        bool bValid = true;
+        p_txlistdb->recordMetaDExCancelTX(txid, obj.getHash(), bValid, block, obj.getProperty(), obj.getAmountRemaining());
 
-                // move from reserve to balance
-                assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
-                assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
-
-                // record the cancellation
-                bool bValid = true;
-                p_txlistdb->recordMetaDExCancelTX(txid, it->getHash(), bValid, block, it->getProperty(), it->getAmountRemaining());
-
-                indexes.erase(it++);
-            }
-        }
+        EraseOrder(*it);
     }
     PrintToLog(">>>>>>\n");
 
@@ -704,7 +752,10 @@ int exodus::MetaDEx_SHUTDOWN_ALLPAIR()
                     // move from reserve to balance
                     assert(update_tally_map(it->getAddr(), it->getProperty(), -it->getAmountRemaining(), METADEX_RESERVE));
                     assert(update_tally_map(it->getAddr(), it->getProperty(), it->getAmountRemaining(), BALANCE));
+                    UnindexOrder(*it);
                     indexes.erase(it++);
+                } else {
+                    ++it;
                 }
             }
         }
@@ -732,25 +783,19 @@ int exodus::MetaDEx_SHUTDOWN()
             }
         }
     }
+    metadex_txids.clear();
+    metadex_addresses.clear();
     return rc;
 }
 
-// searches the metadex maps to see if a trade is still open
-// allows search to be optimized if propertyIdForSale is specified
+// looks up the txid index to see if a trade is still open
+// optionally also checks that propertyIdForSale matches
 bool exodus::MetaDEx_isOpen(const uint256& txid, uint32_t propertyIdForSale)
 {
-    for (md_PropertiesMap::iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
-        if (propertyIdForSale != 0 && propertyIdForSale != my_it->first) continue;
-        md_PricesMap & prices = my_it->second;
-        for (md_PricesMap::iterator it = prices.begin(); it != prices.end(); ++it) {
-            md_Set & indexes = (it->second);
-            for (md_Set::iterator it = indexes.begin(); it != indexes.end(); ++it) {
-                CMPMetaDEx obj = *it;
-                if( obj.getHash().GetHex() == txid.GetHex() ) return true;
-            }
-        }
-    }
-    return false;
+    md_TxidIndex::const_iterator it = metadex_txids.find(txid);
+    if (it == metadex_txids.end()) return false;
+
+    return (propertyIdForSale == 0 || propertyIdForSale == it->second.property);
 }
 
 /**
@@ -837,14 +882,8 @@ void exodus::MetaDEx_debug_print(bool bShowPriceLevel, bool bDisplay)
  */
 const CMPMetaDEx* exodus::MetaDEx_RetrieveTrade(const uint256& txid)
 {
-    for (md_PropertiesMap::iterator propIter = metadex.begin(); propIter != metadex.end(); ++propIter) {
-        md_PricesMap & prices = propIter->second;
-        for (md_PricesMap::iterator pricesIter = prices.begin(); pricesIter != prices.end(); ++pricesIter) {
-            md_Set & indexes = pricesIter->second;
-            for (md_Set::iterator tradesIter = indexes.begin(); tradesIter != indexes.end(); ++tradesIter) {
-                if (txid == (*tradesIter).getHash()) return &(*tradesIter);
-            }
-        }
-    }
-    return (CMPMetaDEx*) NULL;
+    md_TxidIndex::const_iterator it = metadex_txids.find(txid);
+    if (it == metadex_txids.end()) return (CMPMetaDEx*) NULL;
+
+    return &(*it->second.orderIt);
 }
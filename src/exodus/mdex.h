@@ -18,6 +18,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
 
 typedef boost::rational<boost::multiprecision::checked_int128_t> rational_t;
 
@@ -32,6 +33,48 @@ typedef boost::rational<boost::multiprecision::checked_int128_t> rational_t;
 /** Converts price to string. */
 std::string xToString(const rational_t& value);
 
+/** A price as an unnormalized fraction of two 64 bit amounts.
+ *
+ * Used by the matching engine: prices are compared by cross-multiplication in
+ * 128 bit, so no GCD normalization or allocation is needed. The denominator
+ * must be positive.
+ */
+class CMPPrice
+{
+private:
+    int64_t numerator;
+    int64_t denominator;
+
+    boost::multiprecision::int128_t crossLeft(const CMPPrice& other) const
+    {
+        return boost::multiprecision::int128_t(numerator) * other.denominator;
+    }
+
+    boost::multiprecision::int128_t crossRight(const CMPPrice& other) const
+    {
+        return boost::multiprecision::int128_t(other.numerator) * denominator;
+    }
+
+public:
+    CMPPrice(int64_t num, int64_t denom) : numerator(num), denominator(denom) {}
+
+    /** Converts a normalized price of 64 bit amounts, such as an order book price level. */
+    explicit CMPPrice(const rational_t& value)
+      : numerator(value.numerator().convert_to<int64_t>()), denominator(value.denominator().convert_to<int64_t>()) {}
+
+    int64_t getNumerator() const { return numerator; }
+    int64_t getDenominator() const { return denominator; }
+
+    rational_t ToRational() const { return rational_t(numerator, denominator); }
+
+    bool operator==(const CMPPrice& other) const { return crossLeft(other) == crossRight(other); }
+    bool operator!=(const CMPPrice& other) const { return crossLeft(other) != crossRight(other); }
+    bool operator<(const CMPPrice& other) const { return crossLeft(other) < crossRight(other); }
+    bool operator<=(const CMPPrice& other) const { return crossLeft(other) <= crossRight(other); }
+    bool operator>(const CMPPrice& other) const { return crossLeft(other) > crossRight(other); }
+    bool operator>=(const CMPPrice& other) const { return crossLeft(other) >= crossRight(other); }
+};
+
 /** A trade on the distributed exchange.
  */
 class CMPMetaDEx
@@ -94,6 +137,10 @@ public:
     rational_t unitPrice() const;
     rational_t inversePrice() const;
 
+    /** Unnormalized unit and inverse prices used by the matching engine; the respective denominator must be positive. */
+    CMPPrice matchUnitPrice() const { return CMPPrice(amount_desired, amount_forsale); }
+    CMPPrice matchInversePrice() const { return CMPPrice(amount_forsale, amount_desired); }
+
     /** Used for display of unit prices to 8 decimal places at UI layer. */
     std::string displayUnitPrice() const;
     /** Used for display of unit prices with 50 decimal places at RPC layer. */
@@ -120,6 +167,24 @@ typedef std::map<uint32_t, md_PricesMap> md_PropertiesMap;
 //! Global map for price and order data
 extern md_PropertiesMap metadex;
 
+//! Location of an open order within the global order book
+struct md_OrderHandle
+{
+    uint32_t property;
+    md_PricesMap::iterator priceIt;
+    md_Set::iterator orderIt;
+};
+
+struct MetaDEx_txid_hasher
+{
+    size_t operator()(const uint256& txid) const { return txid.GetCheapHash(); }
+};
+
+//! Index of open orders by txid, kept in sync with the order book
+typedef std::unordered_map<uint256, md_OrderHandle, MetaDEx_txid_hasher> md_TxidIndex;
+//! Index of the txids of open orders by address, kept in sync with the order book
+typedef std::unordered_map<std::string, std::set<uint256> > md_AddressIndex;
+
 // TODO: explore a property-pair, instead of a single property as map's key........
 md_PricesMap* get_Prices(uint32_t prop);
 md_Set* get_Indexes(md_PricesMap* p, rational_t price);
@@ -132,6 +197,7 @@ int MetaDEx_CANCEL_EVERYTHING(const uint256& txid, uint32_t block, const std::st
 int MetaDEx_SHUTDOWN();
 int MetaDEx_SHUTDOWN_ALLPAIR();
 bool MetaDEx_INSERT(const CMPMetaDEx& objMetaDEx);
+void MetaDEx_CLEAR();
 void MetaDEx_debug_print(bool bShowPriceLevel = false, bool bDisplay = false);
 bool MetaDEx_isOpen(const uint256& txid, uint32_t propertyIdForSale = 0);
 int MetaDEx_getStatus(const uint256& txid, uint32_t propertyIdForSale, int64_t amountForSale, int64_t totalSold = -1);
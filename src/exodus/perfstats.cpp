@@ -0,0 +1,109 @@
+/**
+ * @file perfstats.cpp
+ *
+ * Provides timers and counters for the Exodus block processing, which are
+ * exposed via the exodus_getperfstats RPC.
+ */
+
+#include "exodus/perfstats.h"
+
+#include "utiltime.h"
+
+#include <univalue.h>
+
+#include <stdint.h>
+
+#include <atomic>
+
+namespace exodus
+{
+//! Accumulated time per phase in microseconds
+static std::atomic<int64_t> perfPhaseTime[PERF_PHASE_COUNT];
+//! Number of measurements per phase
+static std::atomic<uint64_t> perfPhaseCount[PERF_PHASE_COUNT];
+//! Counted events
+static std::atomic<uint64_t> perfCounters[PERF_COUNTER_COUNT];
+
+static const char* GetPhaseName(PerfPhase phase)
+{
+    switch (phase) {
+        case PERF_BLOCK_BEGIN: return "blockbegin";
+        case PERF_PARSE: return "parse";
+        case PERF_INTERPRET: return "interpret";
+        case PERF_DB_WRITE: return "dbwrite";
+        case PERF_BLOCK_END: return "blockend";
+        case PERF_PERSISTENCE: return "persistence";
+        default: return "unknown";
+    }
+}
+
+static const char* GetCounterName(PerfCounter counter)
+{
+    switch (counter) {
+        case PERF_BLOCKS: return "blocks";
+        case PERF_TRANSACTIONS: return "transactions";
+        case PERF_EXODUS_TRANSACTIONS: return "exodustransactions";
+        case PERF_INPUT_CACHE_HITS: return "inputcachehits";
+        case PERF_INPUT_CACHE_MISSES: return "inputcachemisses";
+        case PERF_TALLY_UPDATES: return "tallyupdates";
+        case PERF_METADEX_MATCHES: return "metadexmatches";
+        case PERF_STO_RECEIVERS: return "storeceivers";
+        case PERF_DB_WRITES: return "dbwrites";
+        default: return "unknown";
+    }
+}
+
+void PerfAddTime(PerfPhase phase, int64_t nMicros)
+{
+    perfPhaseTime[phase] += nMicros;
+    ++perfPhaseCount[phase];
+}
+
+void PerfIncrement(PerfCounter counter, uint64_t nCount)
+{
+    perfCounters[counter] += nCount;
+}
+
+uint64_t PerfGetCounter(PerfCounter counter)
+{
+    return perfCounters[counter];
+}
+
+//! Reads a value, swapping in zero when resetting so that concurrent additions are not lost
+template <typename T>
+static T ReadValue(std::atomic<T>& value, bool fReset)
+{
+    return fReset ? value.exchange(0) : value.load();
+}
+
+UniValue PerfStatsToJSON(bool fReset)
+{
+    UniValue phases(UniValue::VOBJ);
+    for (int i = 0; i < PERF_PHASE_COUNT; ++i) {
+        UniValue phase(UniValue::VOBJ);
+        phase.push_back(Pair("count", ReadValue(perfPhaseCount[i], fReset)));
+        phase.push_back(Pair("totalmicros", ReadValue(perfPhaseTime[i], fReset)));
+        phases.push_back(Pair(GetPhaseName(static_cast<PerfPhase>(i)), phase));
+    }
+
+    UniValue counters(UniValue::VOBJ);
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        counters.push_back(Pair(GetCounterName(static_cast<PerfCounter>(i)), ReadValue(perfCounters[i], fReset)));
+    }
+
+    UniValue response(UniValue::VOBJ);
+    response.push_back(Pair("phases", phases));
+    response.push_back(Pair("counters", counters));
+
+    return response;
+}
+
+CPerfTimer::CPerfTimer(PerfPhase phaseIn) : phase(phaseIn), nStart(GetTimeMicros())
+{
+}
+
+CPerfTimer::~CPerfTimer()
+{
+    PerfAddTime(phase, GetTimeMicros() - nStart);
+}
+} // namespace exodus
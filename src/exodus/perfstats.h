@@ -0,0 +1,61 @@
+#ifndef EXODUS_PERFSTATS_H
+#define EXODUS_PERFSTATS_H
+
+#include <stdint.h>
+
+class UniValue;
+
+namespace exodus
+{
+//! Phases of the block processing, whose time is measured
+enum PerfPhase {
+    PERF_BLOCK_BEGIN = 0,
+    PERF_PARSE,
+    PERF_INTERPRET,
+    PERF_DB_WRITE,
+    PERF_BLOCK_END,
+    PERF_PERSISTENCE,
+    PERF_PHASE_COUNT
+};
+
+//! Events counted during the block processing
+enum PerfCounter {
+    PERF_BLOCKS = 0,
+    PERF_TRANSACTIONS,
+    PERF_EXODUS_TRANSACTIONS,
+    PERF_INPUT_CACHE_HITS,
+    PERF_INPUT_CACHE_MISSES,
+    PERF_TALLY_UPDATES,
+    PERF_METADEX_MATCHES,
+    PERF_STO_RECEIVERS,
+    PERF_DB_WRITES,
+    PERF_COUNTER_COUNT
+};
+
+/** Adds the elapsed time in microseconds to a phase. */
+void PerfAddTime(PerfPhase phase, int64_t nMicros);
+
+/** Increments a counter. */
+void PerfIncrement(PerfCounter counter, uint64_t nCount = 1);
+
+/** Returns the current value of a counter. */
+uint64_t PerfGetCounter(PerfCounter counter);
+
+/** Returns the timers and counters as JSON object, optionally resetting each value as it is read. */
+UniValue PerfStatsToJSON(bool fReset = false);
+
+/** Measures the time until it goes out of scope and adds it to a phase.
+ */
+class CPerfTimer
+{
+private:
+    PerfPhase phase;
+    int64_t nStart;
+
+public:
+    explicit CPerfTimer(PerfPhase phaseIn);
+    ~CPerfTimer();
+};
+}
+
+#endif // EXODUS_PERFSTATS_H
@@ -4,7 +4,9 @@
 
 #include "util.h"
 
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/write_batch.h"
 
 #include <boost/filesystem/path.hpp>
@@ -23,7 +25,19 @@ leveldb::Status CDBBase::Open(const boost::filesystem::path& path, bool fWipe)
     TryCreateDirectory(path);
     if (exodus_debug_persistence) PrintToLog("Opening LevelDB in %s\n", path.string());
 
-    return leveldb::DB::Open(options, path.string(), &pdb);
+    CDBProfile profile = GetDBProfile("exodus", 0);
+    ApplyDBProfile(options, profile, &stats);
+    leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
+    if (status.ok()) {
+        CDBStatsEntry entry;
+        entry.strName = "exodus/" + path.filename().string();
+        entry.profile = profile;
+        entry.pdb = pdb;
+        entry.pstats = &stats;
+        entry.fAccessCounters = false;
+        RegisterDBStats(entry);
+    }
+    return status;
 }
 
 /**
@@ -59,9 +73,14 @@ void CDBBase::Clear()
 void CDBBase::Close()
 {
     if (pdb) {
+        UnregisterDBStats(pdb);
         delete pdb;
         pdb = NULL;
     }
+    delete options.filter_policy;
+    options.filter_policy = NULL;
+    delete options.block_cache;
+    options.block_cache = NULL;
 }
 
 
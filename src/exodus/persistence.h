@@ -1,6 +1,8 @@
 #ifndef EXODUS_PERSISTENCE_H
 #define EXODUS_PERSISTENCE_H
 
+#include "dbwrapper.h"
+
 #include "leveldb/db.h"
 
 #include <boost/filesystem/path.hpp>
@@ -38,6 +40,9 @@ protected:
     //! Number of entries written
     unsigned int nWritten;
 
+    //! Block cache counters, for getdbstats
+    CDBStats stats;
+
     CDBBase() : pdb(NULL), nRead(0), nWritten(0)
     {
         options.paranoid_checks = true;
@@ -17,6 +17,7 @@
 #include "exodus/mdex.h"
 #include "exodus/notifications.h"
 #include "exodus/exodus.h"
+#include "exodus/perfstats.h"
 #include "exodus/rpcrequirements.h"
 #include "exodus/rpctx.h"
 #include "exodus/rpctxobject.h"
@@ -610,8 +611,8 @@ UniValue exodusrpc(const UniValue& params, bool fHelp)
             LOCK(cs_tally);
             int64_t total = 0;
             // display all balances
-            for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-                PrintToLog("%34s => ", my_it->first);
+            for (TallyMap::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+                PrintToLog("%34s => ", my_it->first.ToString());
                 total += (my_it->second).print(extra2, bDivisible);
             }
             PrintToLog("total for property %d  = %X is %s\n", extra2, extra2, FormatDivisibleMP(total));
@@ -637,8 +638,8 @@ UniValue exodusrpc(const UniValue& params, bool fHelp)
             LOCK(cs_tally);
             uint32_t id = 0;
             // for each address display all currencies it holds
-            for (std::unordered_map<std::string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-                PrintToLog("%34s => ", my_it->first);
+            for (TallyMap::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+                PrintToLog("%34s => ", my_it->first.ToString());
                 (my_it->second).print(extra2);
                 (my_it->second).init();
                 while (0 != (id = (my_it->second).next())) {
@@ -807,20 +808,16 @@ UniValue exodus_getallbalancesforid(const UniValue& params, bool fHelp)
 
     LOCK(cs_tally);
 
-    for (std::unordered_map<std::string, CMPTally>::iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-        uint32_t id = 0;
-        bool includeAddress = false;
-        std::string address = it->first;
-        (it->second).init();
-        while (0 != (id = (it->second).next())) {
-            if (id == propertyId) {
-                includeAddress = true;
-                break;
-            }
-        }
-        if (!includeAddress) {
-            continue; // ignore this address, has never transacted in this propertyId
+    for (TallyMap::iterator it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
+        const CAddressKey& key = it->first;
+        int64_t nReserved = 0;
+        nReserved += getMPbalance(key, propertyId, ACCEPT_RESERVE);
+        nReserved += getMPbalance(key, propertyId, METADEX_RESERVE);
+        nReserved += getMPbalance(key, propertyId, SELLOFFER_RESERVE);
+        if (getUserAvailableMPbalance(key, propertyId) == 0 && nReserved == 0) {
+            continue; // ignore this address, has no balance in this propertyId
         }
+        std::string address = key.ToString();
         UniValue balanceObj(UniValue::VOBJ);
         balanceObj.push_back(Pair("address", address));
         bool nonEmptyBalance = BalanceToJSON(address, propertyId, balanceObj, isDivisible);
@@ -1343,13 +1340,13 @@ UniValue exodus_getorderbook(const UniValue& params, bool fHelp)
     std::vector<CMPMetaDEx> vecMetaDexObjects;
     {
         LOCK(cs_tally);
-        for (md_PropertiesMap::const_iterator my_it = metadex.begin(); my_it != metadex.end(); ++my_it) {
+        md_PropertiesMap::const_iterator my_it = metadex.find(propertyIdForSale);
+        if (my_it != metadex.end()) {
             const md_PricesMap& prices = my_it->second;
             for (md_PricesMap::const_iterator it = prices.begin(); it != prices.end(); ++it) {
                 const md_Set& indexes = it->second;
                 for (md_Set::const_iterator it = indexes.begin(); it != indexes.end(); ++it) {
                     const CMPMetaDEx& obj = *it;
-                    if (obj.getProperty() != propertyIdForSale) continue;
                     if (!filterDesired || obj.getDesProperty() == propertyIdDesired) vecMetaDexObjects.push_back(obj);
                 }
             }
@@ -2208,6 +2205,39 @@ UniValue exodus_getbalanceshash(const UniValue& params, bool fHelp)
     return response;
 }
 
+UniValue exodus_getperfstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "exodus_getperfstats ( reset )\n"
+            "\nReturns timers and counters of the Exodus block processing since startup or the last reset.\n"
+            "\nArguments:\n"
+            "1. reset                       (boolean, optional) reset all timers and counters after returning them (default: false)\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"phases\" : {                (object) time spent per processing phase\n"
+            "    \"name\" : {\n"
+            "      \"count\" : n,            (number) the number of measurements\n"
+            "      \"totalmicros\" : n       (number) the accumulated time in microseconds\n"
+            "    },\n"
+            "    ...\n"
+            "  },\n"
+            "  \"counters\" : {              (object) counted events, such as input cache hits or tally updates\n"
+            "    \"name\" : n,\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+
+            "\nExamples:\n"
+            + HelpExampleCli("exodus_getperfstats", "")
+            + HelpExampleRpc("exodus_getperfstats", "")
+        );
+
+    bool fReset = (params.size() > 0) ? params[0].get_bool() : false;
+
+    return PerfStatsToJSON(fReset);
+}
+
 static const CRPCCommand commands[] =
 { //  category                             name                            actor (function)               okSafeMode
   //  ------------------------------------ ------------------------------- ------------------------------ ----------
@@ -2239,6 +2269,7 @@ static const CRPCCommand commands[] =
     { "exodus (data retrieval)", "exodus_getfeedistribution",        &exodus_getfeedistribution,         false },
     { "exodus (data retrieval)", "exodus_getfeedistributions",       &exodus_getfeedistributions,        false },
     { "exodus (data retrieval)", "exodus_getbalanceshash",           &exodus_getbalanceshash,            false },
+    { "exodus (data retrieval)", "exodus_getperfstats",              &exodus_getperfstats,               false },
 #ifdef ENABLE_WALLET
     { "exodus (data retrieval)", "exodus_listtransactions",          &exodus_listtransactions,           false },
     { "exodus (data retrieval)", "exodus_getfeeshare",               &exodus_getfeeshare,                false },
@@ -10,10 +10,12 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <algorithm>
 #include <map>
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace exodus
 {
@@ -36,14 +38,16 @@ OwnerAddrType STO_GetReceivers(const std::string& sender, uint32_t property, int
 {
     int64_t totalTokens = 0;
     int64_t senderTokens = 0;
-    OwnerAddrType ownerAddrSet;
+    std::vector<std::pair<int64_t, CAddressKey> > owners;
 
     {
         LOCK(cs_tally);
-        std::unordered_map<std::string, CMPTally>::iterator it;
+        // Only look up the sender, so that placeholders like "FEEDISTRIBUTION" are not interned
+        CAddressKey senderKey;
+        const bool senderKnown = CAddressKey::TryFromString(sender, senderKey);
+        TallyMap::iterator it;
 
         for (it = mp_tally_map.begin(); it != mp_tally_map.end(); ++it) {
-            const std::string& address = it->first;
             const CMPTally& tally = it->second;
 
             int64_t tokens = 0;
@@ -53,7 +57,7 @@ OwnerAddrType STO_GetReceivers(const std::string& sender, uint32_t property, int
             tokens += tally.getMoney(property, METADEX_RESERVE);
 
             // Do not include the sender
-            if (address == sender) {
+            if (senderKnown && it->first == senderKey) {
                 senderTokens = tokens;
                 continue;
             }
@@ -62,44 +66,62 @@ OwnerAddrType STO_GetReceivers(const std::string& sender, uint32_t property, int
 
             // Only holders with balance are relevant
             if (0 < tokens) {
-                ownerAddrSet.insert(std::make_pair(tokens, address));
+                owners.push_back(std::make_pair(tokens, it->first));
             }
         }
     }
 
+    // Holders with more tokens receive first
+    std::sort(owners.begin(), owners.end(),
+        [](const std::pair<int64_t, CAddressKey>& a, const std::pair<int64_t, CAddressKey>& b) { return a.first > b.first; });
+
     // Split up what was taken and distribute between all holders
     int64_t sent_so_far = 0;
     OwnerAddrType receiversSet;
+    bool allocated = false;
+
+    std::vector<std::pair<int64_t, CAddressKey> >::const_iterator next = owners.begin();
+    while (!allocated && next != owners.end()) {
+        // Holders with equal amounts receive in the order of their addresses, so they are
+        // only encoded, once the distribution reaches them
+        const int64_t tokens = next->first;
+        std::vector<std::string> addresses;
+        for (; next != owners.end() && next->first == tokens; ++next) {
+            addresses.push_back(next->second.ToString());
+        }
+        std::sort(addresses.begin(), addresses.end());
 
-    for (OwnerAddrType::reverse_iterator it = ownerAddrSet.rbegin(); it != ownerAddrSet.rend(); ++it) {
-        const std::string& address = it->second;
+        for (std::vector<std::string>::const_iterator it = addresses.begin(); it != addresses.end(); ++it) {
+            const std::string& address = *it;
 
-        arith_uint256 owns = ConvertTo256(it->first);
-        arith_uint256 temp = owns * ConvertTo256(amount);
-        arith_uint256 piece = DivideAndRoundUp(temp, ConvertTo256(totalTokens));
+            arith_uint256 owns = ConvertTo256(tokens);
+            arith_uint256 temp = owns * ConvertTo256(amount);
+            arith_uint256 piece = DivideAndRoundUp(temp, ConvertTo256(totalTokens));
 
-        int64_t will_really_receive = 0;
-        int64_t should_receive = ConvertTo64(piece);
+            int64_t will_really_receive = 0;
+            int64_t should_receive = ConvertTo64(piece);
 
-        // Ensure that no more than available is distributed
-        if ((amount - sent_so_far) < should_receive) {
-            will_really_receive = amount - sent_so_far;
-        } else {
-            will_really_receive = should_receive;
-        }
+            // Ensure that no more than available is distributed
+            if ((amount - sent_so_far) < should_receive) {
+                will_really_receive = amount - sent_so_far;
+            } else {
+                will_really_receive = should_receive;
+            }
 
-        sent_so_far += will_really_receive;
+            sent_so_far += will_really_receive;
 
-        if (exodus_debug_sto) {
-            PrintToLog("%14d = %s, temp= %38s, should_get= %19d, will_really_get= %14d, sent_so_far= %14d\n",
-                it->first, address, temp.ToString(), should_receive, will_really_receive, sent_so_far);
-        }
+            if (exodus_debug_sto) {
+                PrintToLog("%14d = %s, temp= %38s, should_get= %19d, will_really_get= %14d, sent_so_far= %14d\n",
+                    tokens, address, temp.ToString(), should_receive, will_really_receive, sent_so_far);
+            }
 
-        // Stop, once the whole amount is allocated
-        if (will_really_receive > 0) {
-            receiversSet.insert(std::make_pair(will_really_receive, address));
-        } else {
-            break;
+            // Stop, once the whole amount is allocated
+            if (will_really_receive > 0) {
+                receiversSet.insert(std::make_pair(will_really_receive, address));
+            } else {
+                allocated = true;
+                break;
+            }
         }
     }
 
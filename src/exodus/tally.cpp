@@ -4,14 +4,74 @@
 #include "exodus/exodus.h"
 
 #include <stdint.h>
-#include <map>
+#include <string.h>
 
 /**
  * Creates an empty tally.
  */
-CMPTally::CMPTally()
+CMPTally::CMPTally() : my_pos(0)
 {
-    my_it = mp_token.begin();
+}
+
+/**
+ * Returns the position of the first balance record with an identifier not less than the given one.
+ *
+ * @param propertyId  The identifier of the token
+ * @return The position of the record, or the number of records, if there is none
+ */
+CMPTally::TokenMap::size_type CMPTally::lowerBound(uint32_t propertyId) const
+{
+    TokenMap::size_type first = 0;
+    TokenMap::size_type count = mp_token.size();
+
+    while (count > 0) {
+        TokenMap::size_type step = count / 2;
+        if (mp_token[first + step].propertyId < propertyId) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+/**
+ * Returns the balance record of the token, or NULL if there is none.
+ *
+ * @param propertyId  The identifier of the token
+ * @return The balance record
+ */
+const CMPTally::BalanceRecord* CMPTally::findRecord(uint32_t propertyId) const
+{
+    TokenMap::size_type pos = lowerBound(propertyId);
+
+    if (pos < mp_token.size() && mp_token[pos].propertyId == propertyId) {
+        return &mp_token[pos];
+    }
+
+    return NULL;
+}
+
+/**
+ * Returns the balance record of the token, inserting an empty one if there is none.
+ *
+ * @param propertyId  The identifier of the token
+ * @return The balance record
+ */
+CMPTally::BalanceRecord& CMPTally::getRecord(uint32_t propertyId)
+{
+    TokenMap::size_type pos = lowerBound(propertyId);
+
+    if (pos == mp_token.size() || mp_token[pos].propertyId != propertyId) {
+        BalanceRecord record;
+        memset(&record, 0, sizeof(record));
+        record.propertyId = propertyId;
+        mp_token.insert(mp_token.begin() + pos, record);
+    }
+
+    return mp_token[pos];
 }
 
 /**
@@ -22,9 +82,9 @@ CMPTally::CMPTally()
 uint32_t CMPTally::init()
 {
     uint32_t propertyId = 0;
-    my_it = mp_token.begin();
-    if (my_it != mp_token.end()) {
-        propertyId = my_it->first;
+    my_pos = 0;
+    if (my_pos < mp_token.size()) {
+        propertyId = mp_token[my_pos].propertyId;
     }
     return propertyId;
 }
@@ -37,9 +97,9 @@ uint32_t CMPTally::init()
 uint32_t CMPTally::next()
 {
     uint32_t ret = 0;
-    if (my_it != mp_token.end()) {
-        ret = my_it->first;
-        ++my_it;
+    if (my_pos < mp_token.size()) {
+        ret = mp_token[my_pos].propertyId;
+        ++my_pos;
     }
     return ret;
 }
@@ -73,7 +133,8 @@ bool CMPTally::updateMoney(uint32_t propertyId, int64_t amount, TallyType ttype)
         return false;
     }
     bool fUpdated = false;
-    int64_t now64 = mp_token[propertyId].balance[ttype];
+    BalanceRecord& record = getRecord(propertyId);
+    int64_t now64 = record.balance[ttype];
 
     if (isOverflow(now64, amount)) {
         PrintToLog("%s(): ERROR: arithmetic overflow [%d + %d]\n", __func__, now64, amount);
@@ -86,7 +147,7 @@ bool CMPTally::updateMoney(uint32_t propertyId, int64_t amount, TallyType ttype)
     } else {
 
         now64 += amount;
-        mp_token[propertyId].balance[ttype] = now64;
+        record.balance[ttype] = now64;
 
         fUpdated = true;
     }
@@ -107,11 +168,10 @@ int64_t CMPTally::getMoney(uint32_t propertyId, TallyType ttype) const
         return 0;
     }
     int64_t money = 0;
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    const BalanceRecord* record = findRecord(propertyId);
 
-    if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
-        money = record.balance[ttype];
+    if (record) {
+        money = record->balance[ttype];
     }
 
     return money;
@@ -128,14 +188,13 @@ int64_t CMPTally::getMoney(uint32_t propertyId, TallyType ttype) const
  */
 int64_t CMPTally::getMoneyAvailable(uint32_t propertyId) const
 {
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    const BalanceRecord* record = findRecord(propertyId);
 
-    if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
-        if (record.balance[PENDING] < 0) {
-            return record.balance[BALANCE] + record.balance[PENDING];
+    if (record) {
+        if (record->balance[PENDING] < 0) {
+            return record->balance[BALANCE] + record->balance[PENDING];
         } else {
-            return record.balance[BALANCE];
+            return record->balance[BALANCE];
         }
     }
 
@@ -154,13 +213,12 @@ int64_t CMPTally::getMoneyAvailable(uint32_t propertyId) const
 int64_t CMPTally::getMoneyReserved(uint32_t propertyId) const
 {
     int64_t money = 0;
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    const BalanceRecord* record = findRecord(propertyId);
 
-    if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
-        money += record.balance[SELLOFFER_RESERVE];
-        money += record.balance[ACCEPT_RESERVE];
-        money += record.balance[METADEX_RESERVE];
+    if (record) {
+        money += record->balance[SELLOFFER_RESERVE];
+        money += record->balance[ACCEPT_RESERVE];
+        money += record->balance[METADEX_RESERVE];
     }
 
     return money;
@@ -177,28 +235,21 @@ bool CMPTally::operator==(const CMPTally& rhs) const
     if (mp_token.size() != rhs.mp_token.size()) {
         return false;
     }
-    TokenMap::const_iterator pc1 = mp_token.begin();
-    TokenMap::const_iterator pc2 = rhs.mp_token.begin();
+    for (TokenMap::size_type i = 0; i < mp_token.size(); ++i) {
+        const BalanceRecord& record1 = mp_token[i];
+        const BalanceRecord& record2 = rhs.mp_token[i];
 
-    for (unsigned int i = 0; i < mp_token.size(); ++i) {
-        if (pc1->first != pc2->first) {
+        if (record1.propertyId != record2.propertyId) {
             return false;
         }
-        const BalanceRecord& record1 = pc1->second;
-        const BalanceRecord& record2 = pc2->second;
 
         for (int ttype = 0; ttype < TALLY_TYPE_COUNT; ++ttype) {
             if (record1.balance[ttype] != record2.balance[ttype]) {
                 return false;
             }
         }
-        ++pc1;
-        ++pc2;
     }
 
-    assert(pc1 == mp_token.end());
-    assert(pc2 == rhs.mp_token.end());
-
     return true;
 }
 
@@ -228,15 +279,14 @@ int64_t CMPTally::print(uint32_t propertyId, bool bDivisible) const
     int64_t pending = 0;
     int64_t metadex_reserve = 0;
 
-    TokenMap::const_iterator it = mp_token.find(propertyId);
+    const BalanceRecord* record = findRecord(propertyId);
 
-    if (it != mp_token.end()) {
-        const BalanceRecord& record = it->second;
-        balance = record.balance[BALANCE];
-        selloffer_reserve = record.balance[SELLOFFER_RESERVE];
-        accept_reserve = record.balance[ACCEPT_RESERVE];
-        pending = record.balance[PENDING];
-        metadex_reserve = record.balance[METADEX_RESERVE];
+    if (record) {
+        balance = record->balance[BALANCE];
+        selloffer_reserve = record->balance[SELLOFFER_RESERVE];
+        accept_reserve = record->balance[ACCEPT_RESERVE];
+        pending = record->balance[PENDING];
+        metadex_reserve = record->balance[METADEX_RESERVE];
     }
 
     if (bDivisible) {
@@ -1,8 +1,9 @@
 #ifndef EXODUS_TALLY_H
 #define EXODUS_TALLY_H
 
+#include "prevector.h"
+
 #include <stdint.h>
-#include <map>
 
 //! Balance record types
 enum TallyType {
@@ -20,15 +21,25 @@ class CMPTally
 {
 private:
     typedef struct {
+        uint32_t propertyId;
         int64_t balance[TALLY_TYPE_COUNT];
     } BalanceRecord;
 
-    //! Map of balance records
-    typedef std::map<uint32_t, BalanceRecord> TokenMap;
+    //! Flat list of balance records, sorted by property identifier; most entities hold a single token
+    typedef prevector<1, BalanceRecord> TokenMap;
     //! Balance records for different tokens
     TokenMap mp_token;
-    //! Internal iterator pointing to a balance record
-    TokenMap::iterator my_it;
+    //! Internal position of the next balance record
+    TokenMap::size_type my_pos;
+
+    /** Returns the position of the first balance record with an identifier not less than the given one. */
+    TokenMap::size_type lowerBound(uint32_t propertyId) const;
+
+    /** Returns the balance record of the token, or NULL if there is none. */
+    const BalanceRecord* findRecord(uint32_t propertyId) const;
+
+    /** Returns the balance record of the token, inserting an empty one if there is none. */
+    BalanceRecord& getRecord(uint32_t propertyId);
 
 public:
     /** Creates an empty tally. */
@@ -10,6 +10,7 @@
 #include "exodus/mdex.h"
 #include "exodus/notifications.h"
 #include "exodus/exodus.h"
+#include "exodus/perfstats.h"
 #include "exodus/rules.h"
 #include "exodus/sp.h"
 #include "exodus/sto.h"
@@ -1112,7 +1113,10 @@ int CMPTransaction::logicMath_SendToOwners()
         return (PKT_ERROR_STO -26);
     }
 
+    PerfIncrement(PERF_STO_RECEIVERS, numberOfReceivers);
+
     // split up what was taken and distribute between all holders
+    const CAddressKey senderKey = CAddressKey::FromString(sender);
     int64_t sent_so_far = 0;
     for (OwnerAddrType::reverse_iterator it = receiversSet.rbegin(); it != receiversSet.rend(); ++it) {
         const std::string& address = it->second;
@@ -1121,11 +1125,12 @@ int CMPTransaction::logicMath_SendToOwners()
         sent_so_far += will_really_receive;
 
         // real execution of the loop
-        assert(update_tally_map(sender, property, -will_really_receive, BALANCE));
+        assert(update_tally_map(senderKey, property, -will_really_receive, BALANCE));
         assert(update_tally_map(address, property, will_really_receive, BALANCE));
 
         // add to stodb
         s_stolistdb->recordSTOReceive(address, txid, block, property, will_really_receive);
+        PerfIncrement(PERF_DB_WRITES);
 
         if (sent_so_far != (int64_t)nValue) {
             PrintToLog("sent_so_far= %14d, nValue= %14d, n_owners= %d\n", sent_so_far, nValue, numberOfReceivers);
@@ -1163,7 +1168,10 @@ int CMPTransaction::logicMath_SendAll()
         receiver = sender;
     }
 
-    CMPTally* ptally = getTally(sender);
+    const CAddressKey senderKey = CAddressKey::FromString(sender);
+    const CAddressKey receiverKey = CAddressKey::FromString(receiver);
+
+    CMPTally* ptally = getTally(senderKey);
     if (ptally == NULL) {
         PrintToLog("%s(): rejected: sender %s has no tokens to send\n", __func__, sender);
         return (PKT_ERROR_SEND_ALL -54);
@@ -1190,8 +1198,8 @@ int CMPTransaction::logicMath_SendAll()
         int64_t moneyAvailable = ptally->getMoney(propertyId, BALANCE);
         if (moneyAvailable > 0) {
             ++numberOfPropertiesSent;
-            assert(update_tally_map(sender, propertyId, -moneyAvailable, BALANCE));
-            assert(update_tally_map(receiver, propertyId, moneyAvailable, BALANCE));
+            assert(update_tally_map(senderKey, propertyId, -moneyAvailable, BALANCE));
+            assert(update_tally_map(receiverKey, propertyId, moneyAvailable, BALANCE));
             p_txlistdb->recordSendAllSubRecord(txid, numberOfPropertiesSent, propertyId, moneyAvailable);
         }
     }
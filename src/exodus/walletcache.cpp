@@ -21,10 +21,11 @@
 
 #include <stdint.h>
 #include <algorithm>
+#include <atomic>
 #include <list>
-#include <map>
-#include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -34,7 +35,7 @@ namespace exodus
 std::vector<uint256> walletTXIDCache;
 
 //! Map of wallet balances
-static std::map<std::string, CMPTally> walletBalancesCache;
+static std::unordered_map<CAddressKey, CMPTally, CAddressKeyHasher> walletBalancesCache;
 
 /**
  * Adds a txid to the wallet txid cache, performing duplicate detection.
@@ -76,64 +77,166 @@ void WalletTXIDCacheInit()
 #endif
 }
 
+//! Addresses with tally changes since the last cache update, guarded by cs_tally
+static std::unordered_set<CAddressKey, CAddressKeyHasher> walletCacheDirtyAddresses;
+
+//! Whether all addresses must be compared on the next update, e.g. after the state was reloaded
+static std::atomic<bool> fWalletCacheFullUpdate(true);
+
+#ifdef ENABLE_WALLET
+//! Whether the wallet notifications are connected
+static bool fWalletCacheNotifications = false;
+
+static void NotifyAddressBookChanged(CWallet* wallet, const CTxDestination& address, const std::string& label, bool isMine, const std::string& purpose, ChangeType status)
+{
+    WalletCacheMarkAllDirty();
+}
+
+static void NotifyWatchonlyChanged(bool fHaveWatchOnly)
+{
+    WalletCacheMarkAllDirty();
+}
+#endif
+
+/**
+ * Marks an address, whose tally changed, to be checked on the next cache update.
+ */
+void WalletCacheMarkDirty(const CAddressKey& address)
+{
+    AssertLockHeld(cs_tally);
+    walletCacheDirtyAddresses.insert(address);
+}
+
+/**
+ * Forces a comparison of all addresses on the next cache update.
+ *
+ * Used when the tally map is reloaded, or when addresses are added to the wallet.
+ */
+void WalletCacheMarkAllDirty()
+{
+    fWalletCacheFullUpdate = true;
+}
+
+/**
+ * Returns the wallet addresses, which hold tokens as of the last cache update.
+ */
+std::vector<CAddressKey> WalletCacheGetAddresses()
+{
+    AssertLockHeld(cs_tally);
+
+    std::vector<CAddressKey> addresses;
+    addresses.reserve(walletBalancesCache.size());
+    for (std::unordered_map<CAddressKey, CMPTally, CAddressKeyHasher>::const_iterator it = walletBalancesCache.begin(); it != walletBalancesCache.end(); ++it) {
+        addresses.push_back(it->first);
+    }
+    return addresses;
+}
+
+/**
+ * Compares the tally of a wallet address with the cached one and updates the cache.
+ *
+ * @param address  The wallet address
+ * @param tally    The current tally of the address, or NULL if it has none
+ * @return True, if the balances of the address changed
+ */
+static bool UpdateCachedTally(const CAddressKey& address, const CMPTally* tally)
+{
+    std::unordered_map<CAddressKey, CMPTally, CAddressKeyHasher>::iterator search_it = walletBalancesCache.find(address);
+
+    if (search_it == walletBalancesCache.end()) {
+        if (!tally) return false;
+        // cache miss, new address
+        walletBalancesCache.insert(std::make_pair(address, *tally));
+        if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s not in cache\n", address.ToString());
+        return true;
+    }
+
+    if (!tally) {
+        // the address no longer holds any tokens
+        walletBalancesCache.erase(search_it);
+        if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s no longer has a tally\n", address.ToString());
+        return true;
+    }
+
+    if (search_it->second != *tally) {
+        // cache miss, balance
+        search_it->second = *tally;
+        if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s balances differ\n", address.ToString());
+        return true;
+    }
+
+    return false;
+}
+
 /**
  * Updates the cache with the latest state, returning true if changes were made to wallet addresses (including watch only).
  *
- * Also prepares a list of addresses that were changed (for future usage).
+ * Only addresses whose tally changed since the last update are checked, unless a full update was requested.
  */
 int WalletCacheUpdate()
 {
     if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: Update requested\n");
     int numChanges = 0;
-    std::set<std::string> changedAddresses;
 
     LOCK(cs_tally);
 
-    for (std::unordered_map<string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        const std::string& address = my_it->first;
+#ifdef ENABLE_WALLET
+    // addresses added to the wallet may already hold tokens, so they require a full update
+    if (pwalletMain && !fWalletCacheNotifications) {
+        pwalletMain->NotifyAddressBookChanged.connect(&NotifyAddressBookChanged);
+        pwalletMain->NotifyWatchonlyChanged.connect(&NotifyWatchonlyChanged);
+        fWalletCacheNotifications = true;
+    }
+#endif
+
+    if (fWalletCacheFullUpdate.exchange(false)) {
+        if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: Comparing all addresses\n");
 
-        // determine if this address is in the wallet
-        int addressIsMine = IsMyAddress(address);
-        if (!addressIsMine) {
-            if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: Ignoring non-wallet address %s\n", address);
-            continue; // ignore this address, not in wallet
+        walletCacheDirtyAddresses.clear();
+
+        // addresses that are no longer in the tally map
+        std::unordered_map<CAddressKey, CMPTally, CAddressKeyHasher>::iterator cache_it = walletBalancesCache.begin();
+        while (cache_it != walletBalancesCache.end()) {
+            const CAddressKey address = (cache_it++)->first;
+            if (mp_tally_map.find(address) == mp_tally_map.end() && UpdateCachedTally(address, NULL)) {
+                ++numChanges;
+            }
         }
 
-        // obtain & init the tally
-        CMPTally& tally = my_it->second;
-        tally.init();
-
-        // check cache for miss on address
-        std::map<std::string, CMPTally>::iterator search_it = walletBalancesCache.find(address);
-        if (search_it == walletBalancesCache.end()) { // cache miss, new address
-            ++numChanges;
-            changedAddresses.insert(address);
-            walletBalancesCache.insert(std::make_pair(address,tally));
-            if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s not in cache\n", address);
-            continue;
+        for (TallyMap::const_iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+            const CAddressKey& address = my_it->first;
+
+            // determine if this address is in the wallet
+            if (!IsMyAddress(address)) {
+                continue; // ignore this address, not in wallet
+            }
+
+            if (UpdateCachedTally(address, &my_it->second)) {
+                ++numChanges;
+            }
         }
+    } else {
+        for (std::unordered_set<CAddressKey, CAddressKeyHasher>::const_iterator it = walletCacheDirtyAddresses.begin(); it != walletCacheDirtyAddresses.end(); ++it) {
+            const CAddressKey& address = *it;
+
+            // determine if this address is in the wallet
+            if (!IsMyAddress(address)) {
+                if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: Ignoring non-wallet address %s\n", address.ToString());
+                continue; // ignore this address, not in wallet
+            }
 
-        // check cache for miss on balance - TODO TRY AND OPTIMIZE THIS
-        CMPTally &cacheTally = search_it->second;
-        uint32_t propertyId;
-        while (0 != (propertyId = (tally.next()))) {
-            if (tally.getMoney(propertyId, BALANCE) != cacheTally.getMoney(propertyId, BALANCE) ||
-                    tally.getMoney(propertyId, PENDING) != cacheTally.getMoney(propertyId, PENDING) ||
-                    tally.getMoney(propertyId, SELLOFFER_RESERVE) != cacheTally.getMoney(propertyId, SELLOFFER_RESERVE) ||
-                    tally.getMoney(propertyId, ACCEPT_RESERVE) != cacheTally.getMoney(propertyId, ACCEPT_RESERVE) ||
-                    tally.getMoney(propertyId, METADEX_RESERVE) != cacheTally.getMoney(propertyId, METADEX_RESERVE)) { // cache miss, balance
+            TallyMap::const_iterator my_it = mp_tally_map.find(address);
+            const CMPTally* tally = (my_it != mp_tally_map.end()) ? &my_it->second : NULL;
+
+            if (UpdateCachedTally(address, tally)) {
                 ++numChanges;
-                changedAddresses.insert(address);
-                walletBalancesCache.erase(search_it);
-                walletBalancesCache.insert(std::make_pair(address,tally));
-                if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: *CACHE MISS* - %s balance for property %d differs\n", address, propertyId);
-                break;
             }
         }
+        walletCacheDirtyAddresses.clear();
     }
+
     if (exodus_debug_walletcache) PrintToLog("WALLETCACHE: Update finished - there were %d changes\n", numChanges);
     return numChanges;
 }
 
-
 } // namespace exodus
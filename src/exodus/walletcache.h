@@ -3,6 +3,8 @@
 
 class uint256;
 
+#include "exodus/addresskey.h"
+
 #include <vector>
 
 namespace exodus
@@ -16,8 +18,17 @@ void WalletTXIDCacheAdd(const uint256& hash);
 /** Performs initial population of the wallet txid cache */
 void WalletTXIDCacheInit();
 
+/** Marks an address, whose tally changed, to be checked on the next cache update */
+void WalletCacheMarkDirty(const CAddressKey& address);
+
+/** Forces a comparison of all addresses on the next cache update */
+void WalletCacheMarkAllDirty();
+
 /** Updates the cache and returns whether any wallet addresses were changed */
 int WalletCacheUpdate();
+
+/** Returns the wallet addresses, which hold tokens as of the last cache update */
+std::vector<CAddressKey> WalletCacheGetAddresses();
 }
 
 #endif // EXODUS_WALLETCACHE_H
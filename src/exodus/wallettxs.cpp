@@ -161,6 +161,22 @@ int IsMyAddress(const std::string& address)
     return 0;
 }
 
+/**
+ * IsMine wrapper for keys of the Exodus state, which avoids the Base58 decoding.
+ */
+int IsMyAddress(const CAddressKey& address)
+{
+#ifdef ENABLE_WALLET
+    CTxDestination dest;
+    if (pwalletMain && address.GetDestination(dest)) {
+        isminetype isMine = IsMine(*pwalletMain, dest);
+
+        return static_cast<int>(isMine);
+    }
+#endif
+    return 0;
+}
+
 /**
  * Estimate the minimum fee considering user set parameters and the required fee.
  *
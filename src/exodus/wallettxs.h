@@ -4,6 +4,8 @@
 class CCoinControl;
 class CPubKey;
 
+#include "exodus/addresskey.h"
+
 #include "script/standard.h"
 
 #include <stdint.h>
@@ -25,6 +27,7 @@ std::string GetAddressLabel(const std::string& address);
 
 /** IsMine wrapper to determine whether the address is in the wallet. */
 int IsMyAddress(const std::string& address);
+int IsMyAddress(const CAddressKey& address);
 
 /** Selects spendable outputs to create a transaction. */
 int64_t SelectCoins(const std::string& fromAddress, CCoinControl& coinControl, int64_t additional = 0);
@@ -16,6 +16,8 @@
 #include "sigma.h"
 #include "txmempool.h"
 
+#include <boost/bind.hpp>
+
 using namespace std;
 using namespace sigma;
 
@@ -24,11 +26,18 @@ CHDMintTracker::CHDMintTracker(std::string strWalletFile)
     this->strWalletFile = strWalletFile;
     mapSerialHashes.clear();
     mapPendingSpends.clear();
+    mapMempoolSpends.clear();
     fInitialized = false;
+    fBalanceCached = false;
+    fStatusSynced = false;
+    mempool.NotifyEntryRemoved.connect(boost::bind(&CHDMintTracker::RemoveMempoolSpend, this, _1));
+    stempool.NotifyEntryRemoved.connect(boost::bind(&CHDMintTracker::RemoveMempoolSpend, this, _1));
 }
 
 CHDMintTracker::~CHDMintTracker()
 {
+    mempool.NotifyEntryRemoved.disconnect(boost::bind(&CHDMintTracker::RemoveMempoolSpend, this, _1));
+    stempool.NotifyEntryRemoved.disconnect(boost::bind(&CHDMintTracker::RemoveMempoolSpend, this, _1));
     mapSerialHashes.clear();
     mapPendingSpends.clear();
 }
@@ -46,8 +55,10 @@ bool CHDMintTracker::Archive(CMintMeta& meta)
 {
     uint256 hashPubcoin = meta.GetPubCoinValueHash();
 
-    if (HasSerialHash(meta.hashSerial))
+    if (HasSerialHash(meta.hashSerial)) {
         mapSerialHashes.at(meta.hashSerial).isArchived = true;
+        fBalanceCached = false;
+    }
 
    CWalletDB walletdb(strWalletFile);
     CHDMint dMint;
@@ -117,35 +128,36 @@ std::vector<uint256> CHDMintTracker::GetSerialHashes()
 
 CAmount CHDMintTracker::GetBalance(bool fConfirmedOnly, bool fUnconfirmedOnly) const
 {
-    CAmount nTotal = 0;
-    //! zerocoin specific fields
-
-    std::map<sigma::CoinDenomination, unsigned int> myZerocoinSupply;
-    std::vector<sigma::CoinDenomination> denominations;
-    GetAllDenoms(denominations);
-    BOOST_FOREACH(sigma::CoinDenomination denomination, denominations){
-        myZerocoinSupply.insert(make_pair(denomination, 0));
-    }
-
-    {
-        //LOCK(cs_pivtracker);
-        // Get Unused coins
+    // Both totals are computed in one pass and reused until a mint is
+    // added, updated or archived, or a block changes which mints are confirmed.
+    int nHeight = chainActive.Height();
+    if (!fBalanceCached || nBalanceCachedHeight != nHeight) {
+        CAmount nConfirmed = 0;
+        CAmount nUnconfirmed = 0;
         for (auto& it : mapSerialHashes) {
-            CMintMeta meta = it.second;
+            const CMintMeta& meta = it.second;
             if (meta.isUsed || meta.isArchived)
                 continue;
-            bool fConfirmed = ((meta.nHeight < chainActive.Height() - ZC_MINT_CONFIRMATIONS) && !(meta.nHeight == 0));
-            if (fConfirmedOnly && !fConfirmed)
-                continue;
-            if (fUnconfirmedOnly && fConfirmed)
-                continue;
             int64_t nValue;
             sigma::DenominationToInteger(meta.denom, nValue);
-            nTotal += nValue;
-            myZerocoinSupply.at(meta.denom)++;
+            bool fConfirmed = ((meta.nHeight < nHeight - ZC_MINT_CONFIRMATIONS) && !(meta.nHeight == 0));
+            if (fConfirmed)
+                nConfirmed += nValue;
+            else
+                nUnconfirmed += nValue;
         }
+        nBalanceConfirmedCached = nConfirmed;
+        nBalanceUnconfirmedCached = nUnconfirmed;
+        nBalanceCachedHeight = nHeight;
+        fBalanceCached = true;
     }
 
+    CAmount nTotal = 0;
+    if (!fUnconfirmedOnly)
+        nTotal += nBalanceConfirmedCached;
+    if (!fConfirmedOnly)
+        nTotal += nBalanceUnconfirmedCached;
+
     if (nTotal < 0 ) nTotal = 0; // Sanity never hurts
 
     return nTotal;
@@ -259,6 +271,7 @@ bool CHDMintTracker::UpdateState(const CMintMeta& meta)
     }
 
     mapSerialHashes[meta.hashSerial] = meta;
+    fBalanceCached = false;
 
     return true;
 }
@@ -277,6 +290,7 @@ void CHDMintTracker::Add(const CHDMint& dMint, bool isNew, bool isArchived)
     meta.isDeterministic = true;
     meta.isSeedCorrect = true;
     mapSerialHashes[meta.hashSerial] = meta;
+    fBalanceCached = false;
 
     pwalletMain->NotifyZerocoinChanged(
         pwalletMain,
@@ -302,6 +316,7 @@ void CHDMintTracker::Add(const CSigmaEntry& zerocoin, bool isNew, bool isArchive
     meta.isDeterministic = false;
     meta.isSeedCorrect = true;
     mapSerialHashes[meta.hashSerial] = meta;
+    fBalanceCached = false;
 
     if (isNew)
         CWalletDB(strWalletFile).WriteZerocoinEntry(zerocoin);
@@ -343,43 +358,68 @@ void CHDMintTracker::RemovePending(const uint256& txid)
         mapPendingSpends.erase(hashSerial);
 }
 
-bool CHDMintTracker::IsMempoolSpendOurs(const std::set<uint256>& setMempool, const uint256& hashSerial){
-    // get transaction back from mempool
-    // if spend, get hash of serial
-    // if matches mint.hashSerial, mark pending spend.
-    for(auto& mempoolTxid : setMempool){
-        auto it = mempool.mapTx.find(mempoolTxid);
-        if (it == mempool.mapTx.end()){
-            it = stempool.mapTx.find(mempoolTxid);
-            if (it == stempool.mapTx.end())
-                continue;
-        }
+bool CHDMintTracker::IsMempoolSpendOurs(const uint256& hashSerial){
+    // Serials of mempool and stempool spends are recorded as the transactions
+    // are accepted, so there is no need to walk and re-parse the mempool here.
+    uint256 txid;
+    auto it = mapMempoolSpends.find(hashSerial);
+    if (it != mapMempoolSpends.end())
+        txid = it->second;
+    else
+        txid = sigma::CSigmaState::GetState()->GetMempoolSpendTxHash(hashSerial);
+
+    if (txid.IsNull())
+        return false;
+    if (IsInMempool(txid))
+        return true;
 
-        const CTransaction &tx = it->GetTx();
-        for (const CTxIn& txin : tx.vin) {
-            if (txin.IsSigmaSpend()) {
-                std::unique_ptr<sigma::CoinSpend> spend;
-                uint32_t pubcoinId;
-                try {
-                    std::tie(spend, pubcoinId) = sigma::ParseSigmaSpend(txin);
-                } catch (CBadTxIn &) {
-                    return false;
-                } catch (std::ios_base::failure &) {
-                    return false;
-                }
+    // the spend was evicted or replaced
+    if (it != mapMempoolSpends.end())
+        mapMempoolSpends.erase(it);
+    return false;
+}
 
-                uint256 mempoolHashSerial = primitives::GetSerialHash(spend->getCoinSerialNumber());
-                if(mempoolHashSerial==hashSerial){
-                    return true;
-                }
-            }
-        }
+/**
+ * Forgets the wallet serials spent by a transaction leaving the mempool or
+ * stempool, so that spends which were evicted or replaced are not kept.
+ */
+void CHDMintTracker::RemoveMempoolSpend(const CTransaction& tx)
+{
+    if (!tx.IsSigmaSpend())
+        return;
+
+    const uint256 txid = tx.GetHash();
+    auto it = mapMempoolSpends.begin();
+    while (it != mapMempoolSpends.end()) {
+        if (it->second == txid)
+            it = mapMempoolSpends.erase(it);
+        else
+            ++it;
     }
+}
 
-    return false;
+bool CHDMintTracker::IsInMempool(const uint256& txid){
+    return mempool.exists(txid) || stempool.exists(txid);
+}
+
+/**
+ * Whether the block and mempool notifications are enough to keep this mint's
+ * status current, so that listing does not need to look it up again.
+ */
+bool CHDMintTracker::IsStatusSettled(const CMintMeta& mint)
+{
+    if (mint.nHeight <= 0 || mint.nId <= 0 || mint.txid.IsNull())
+        return false;
+
+    // A spend that is only pending might still drop out of the mempool
+    if (mint.isUsed && (mapPendingSpends.count(mint.hashSerial) || mapMempoolSpends.count(mint.hashSerial) ||
+            !sigma::CSigmaState::GetState()->GetMempoolSpendTxHash(mint.hashSerial).IsNull()))
+        return false;
+
+    return true;
 }
 
-bool CHDMintTracker::UpdateMetaStatus(const std::set<uint256>& setMempool, CMintMeta& mint, bool fSpend)
+bool CHDMintTracker::UpdateMetaStatus(CMintMeta& mint, bool fSpend)
 {
     uint256 hashPubcoin = mint.GetPubCoinValueHash();
     //! Check whether this mint has been spent and is considered 'pending' or 'confirmed'
@@ -395,7 +435,7 @@ bool CHDMintTracker::UpdateMetaStatus(const std::set<uint256>& setMempool, CMint
 
     // Mempool might hold pending spend
     if(!isPendingSpend && fSpend)
-        isPendingSpend = IsMempoolSpendOurs(setMempool, mint.hashSerial);
+        isPendingSpend = IsMempoolSpendOurs(mint.hashSerial);
 
     LogPrintf("UpdateMetaStatus : isPendingSpend: %d\n", isPendingSpend);
 
@@ -427,7 +467,7 @@ bool CHDMintTracker::UpdateMetaStatus(const std::set<uint256>& setMempool, CMint
 
         LogPrintf("UpdateMetaStatus : mint.txid = %d\n", mint.txid.GetHex());
 
-        if (setMempool.count(mint.txid)) {
+        if (IsInMempool(mint.txid)) {
             if(mint.nHeight>-1) mint.nHeight = -1;
             if(mint.nId>-1) mint.nId = -1;
             return true;
@@ -492,7 +532,6 @@ void CHDMintTracker::UpdateMintStateFromBlock(const std::vector<sigma::PublicCoi
     uint160 hashSeedMasterEntry;
     CKeyID seedId;
     int32_t nCount;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for (auto& mint : mints) {
         uint256 hashPubcoin = primitives::GetPubCoinValueHash(mint.getValue());
         CMintMeta meta;
@@ -504,7 +543,7 @@ void CHDMintTracker::UpdateMintStateFromBlock(const std::vector<sigma::PublicCoi
                 mintPoolEntries.push_back(std::make_pair(hashPubcoin, mintPoolEntry));
                 continue;
             }
-            if(UpdateMetaStatus(setMempool, meta)){
+            if(UpdateMetaStatus(meta)){
                 updatedMeta.emplace_back(meta);
             }
         }
@@ -520,9 +559,9 @@ void CHDMintTracker::UpdateSpendStateFromBlock(const sigma::spend_info_container
     uint160 hashSeedMasterEntry;
     CKeyID seedId;
     int32_t nCount;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for(auto& spentSerial : spentSerials){
         uint256 spentSerialHash = primitives::GetSerialHash(spentSerial.first);
+        mapMempoolSpends.erase(spentSerialHash);
         CMintMeta meta;
         GroupElement pubcoin;
         // Check serialHash in db
@@ -537,7 +576,7 @@ void CHDMintTracker::UpdateSpendStateFromBlock(const sigma::spend_info_container
                 mintPoolEntries.push_back(std::make_pair(hashPubcoin, mintPoolEntry));
                 continue;
             }
-            if(UpdateMetaStatus(setMempool, meta, true)){
+            if(UpdateMetaStatus(meta, true)){
                 updatedMeta.emplace_back(meta);
             }
         }
@@ -553,7 +592,6 @@ void CHDMintTracker::UpdateMintStateFromMempool(const std::vector<GroupElement>&
     uint160 hashSeedMasterEntry;
     CKeyID seedId;
     int32_t nCount;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for (auto& pubcoin : pubCoins) {
         uint256 hashPubcoin = primitives::GetPubCoinValueHash(pubcoin);
 
@@ -568,7 +606,7 @@ void CHDMintTracker::UpdateMintStateFromMempool(const std::vector<GroupElement>&
             }
             CMintMeta meta;
             GetMetaFromPubcoin(hashPubcoin, meta);
-            if(UpdateMetaStatus(setMempool, meta)){
+            if(UpdateMetaStatus(meta)){
                 updatedMeta.emplace_back(meta);
             }
         }
@@ -577,20 +615,21 @@ void CHDMintTracker::UpdateMintStateFromMempool(const std::vector<GroupElement>&
     UpdateFromBlock(mintPoolEntries, updatedMeta);
 }
 
-void CHDMintTracker::UpdateSpendStateFromMempool(const vector<Scalar>& spentSerials){
+void CHDMintTracker::UpdateSpendStateFromMempool(const vector<Scalar>& spentSerials, const uint256& txid){
     CWalletDB walletdb(strWalletFile);
     std::vector<CMintMeta> updatedMeta;
     std::list<std::pair<uint256, MintPoolEntry>> mintPoolEntries;
     uint160 hashSeedMasterEntry;
     CKeyID seedId;
     int32_t nCount;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for(auto& spentSerial : spentSerials){
         uint256 spentSerialHash = primitives::GetSerialHash(spentSerial);
         CMintMeta meta;
         GroupElement pubcoin;
         // Check serialHash in db
         if(walletdb.ReadPubcoin(spentSerialHash, pubcoin)){
+            // only the wallet's own serials are tracked
+            mapMempoolSpends[spentSerialHash] = txid;
             // If found in db but not in memory - this is likely a resync
             if(!GetMetaFromSerial(spentSerialHash, meta)){
                 uint256 hashPubcoin = primitives::GetPubCoinValueHash(pubcoin);
@@ -601,7 +640,7 @@ void CHDMintTracker::UpdateSpendStateFromMempool(const vector<Scalar>& spentSeri
                 mintPoolEntries.push_back(std::make_pair(hashPubcoin, mintPoolEntry));
                 continue;
             }
-            if(UpdateMetaStatus(setMempool, meta, true)){
+            if(UpdateMetaStatus(meta, true)){
                 updatedMeta.emplace_back(meta);
             }
         }
@@ -644,7 +683,6 @@ std::vector<CMintMeta> CHDMintTracker::ListMints(bool fUnusedOnly, bool fMatureO
     }
 
     std::vector<CMintMeta> vOverWrite;
-    std::set<uint256> setMempool = GetMempoolTxids();
     for (auto& it : mapSerialHashes) {
         CMintMeta mint = it.second;
 
@@ -652,9 +690,10 @@ std::vector<CMintMeta> CHDMintTracker::ListMints(bool fUnusedOnly, bool fMatureO
         if (mint.isArchived)
             continue;
 
-        // Update the metadata of the mints if requested
-        if (fUpdateStatus){
-            if(UpdateMetaStatus(setMempool, mint)) {
+        // Update the metadata of the mints if requested. Once every mint has been
+        // checked, block and mempool notifications keep settled mints current.
+        if (fUpdateStatus && (!fStatusSynced || !IsStatusSettled(mint))){
+            if(UpdateMetaStatus(mint)) {
                 if (mint.isArchived)
                     continue;
 
@@ -682,21 +721,15 @@ std::vector<CMintMeta> CHDMintTracker::ListMints(bool fUnusedOnly, bool fMatureO
     for (CMintMeta& meta : vOverWrite)
         UpdateState(meta);
 
-    return setMints;
-}
+    if (fUpdateStatus)
+        fStatusSynced = true;
 
-std::set<uint256> CHDMintTracker::GetMempoolTxids(){
-    std::set<uint256> setMempool;
-    setMempool.clear();
-    {
-        LOCK(mempool.cs);
-        mempool.getTransactions(setMempool);
-        stempool.getTransactions(setMempool);
-    }
-    return setMempool;
+    return setMints;
 }
 
 void CHDMintTracker::Clear()
 {
     mapSerialHashes.clear();
+    fBalanceCached = false;
+    fStatusSynced = false;
 }
@@ -19,9 +19,19 @@ private:
     std::string strWalletFile;
     std::map<uint256, CMintMeta> mapSerialHashes;
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
-    bool IsMempoolSpendOurs(const std::set<uint256>& setMempool, const uint256& hashSerial);
-    bool UpdateMetaStatus(const std::set<uint256>& setMempool, CMintMeta& mint, bool fSpend=false);
-    std::set<uint256> GetMempoolTxids();
+    std::map<uint256, uint256> mapMempoolSpends; //serialhash, txid of spend seen in mempool or stempool
+    // balance totals over mapSerialHashes, valid until a mint changes or the chain height moves
+    mutable bool fBalanceCached;
+    mutable int nBalanceCachedHeight;
+    mutable CAmount nBalanceConfirmedCached;
+    mutable CAmount nBalanceUnconfirmedCached;
+    // set once ListMints has looked up the status of every mint
+    bool fStatusSynced;
+    bool IsMempoolSpendOurs(const uint256& hashSerial);
+    void RemoveMempoolSpend(const CTransaction& tx);
+    bool IsInMempool(const uint256& txid);
+    bool IsStatusSettled(const CMintMeta& mint);
+    bool UpdateMetaStatus(CMintMeta& mint, bool fSpend=false);
 public:
     CHDMintTracker(std::string strWalletFile);
     ~CHDMintTracker();
@@ -43,7 +53,7 @@ public:
     void UpdateMintStateFromBlock(const std::vector<sigma::PublicCoin>& mints);
     void UpdateSpendStateFromBlock(const sigma::spend_info_container& spentSerials);
     void UpdateMintStateFromMempool(const std::vector<GroupElement>& pubCoins);
-    void UpdateSpendStateFromMempool(const vector<Scalar>& spentSerials);
+    void UpdateSpendStateFromMempool(const vector<Scalar>& spentSerials, const uint256& txid);
     list<CSigmaEntry> MintsAsZerocoinEntries(bool fUnusedOnly = true, bool fMatureOnly = true);
     std::vector<CMintMeta> ListMints(bool fUnusedOnly = true, bool fMatureOnly = true, bool fUpdateStatus = true, bool fLoad = false, bool fWrongSeed = false);
     void RemovePending(const uint256& txid);
@@ -15,6 +15,9 @@
 #include "crypto/hmac_sha512.h"
 #include "keystore.h"
 #include <boost/optional.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
 
 CHDMintWallet::CHDMintWallet(const std::string& strWalletFile) : tracker(strWalletFile)
 {
@@ -65,7 +68,8 @@ bool CHDMintWallet::SetupWallet(const uint160& hashSeedMaster, bool fResetCount)
 }
 
 // Regenerate mintPool entry from given values
-std::pair<uint256,uint256> CHDMintWallet::RegenerateMintPoolEntry(const uint160& mintHashSeedMaster, CKeyID& seedId, const int32_t& nCount)
+// Entries are written through pwalletdb if passed, so a caller can batch them into one transaction
+std::pair<uint256,uint256> CHDMintWallet::RegenerateMintPoolEntry(const uint160& mintHashSeedMaster, CKeyID& seedId, const int32_t& nCount, CWalletDB* pwalletdb)
 {
     // hashPubcoin, hashSerial
     std::pair<uint256,uint256> nIndexes;
@@ -89,8 +93,10 @@ std::pair<uint256,uint256> CHDMintWallet::RegenerateMintPoolEntry(const uint160&
 
     MintPoolEntry mintPoolEntry(mintHashSeedMaster, seedId, nCount);
     mintPool.Add(make_pair(hashPubcoin, mintPoolEntry));
-    CWalletDB(strWalletFile).WritePubcoin(hashSerial, commitmentValue);
-    CWalletDB(strWalletFile).WriteMintPoolPair(hashPubcoin, mintPoolEntry);
+    if (!pwalletdb)
+        pwalletdb = &walletdb;
+    pwalletdb->WritePubcoin(hashSerial, commitmentValue);
+    pwalletdb->WriteMintPoolPair(hashPubcoin, mintPoolEntry);
     LogPrintf("%s : hashSeedMaster=%s hashPubcoin=%s seedId=%s\n count=%d\n", __func__, hashSeedMaster.GetHex(), hashPubcoin.GetHex(), seedId.GetHex(), nCount);
 
     nIndexes.first = hashPubcoin;
@@ -118,33 +124,98 @@ void CHDMintWallet::GenerateMintPool(int32_t nIndex)
     if(nIndex > 0 && nIndex >= nLastCount)
         nStop = nIndex + 20;
     LogPrintf("%s : nLastCount=%d nStop=%d\n", __func__, nLastCount, nStop - 1);
-    for (; nLastCount <= nStop; ++nLastCount) {
-        if (ShutdownRequested())
-            return;
 
+    // Seeds are derived in order as deriving them may add new keys to the wallet
+    struct MintPoolSeed {
+        int32_t nCount;
         CKeyID seedId;
         uint512 seedZerocoin;
-        if(!CreateZerocoinSeed(seedZerocoin, nLastCount, seedId))
+    };
+
+    std::vector<MintPoolSeed> seeds;
+    bool fShutdown = false;
+    for (; nLastCount <= nStop; ++nLastCount) {
+        if (ShutdownRequested()) {
+            fShutdown = true;
+            break;
+        }
+
+        MintPoolSeed seed;
+        seed.nCount = nLastCount;
+        if(!CreateZerocoinSeed(seed.seedZerocoin, nLastCount, seed.seedId))
             continue;
 
-        GroupElement commitmentValue;
-        sigma::PrivateCoin coin(sigma::Params::get_default(), sigma::CoinDenomination::SIGMA_DENOM_X1);
-        if(!SeedToZerocoin(seedZerocoin, commitmentValue, coin))
+        seeds.push_back(seed);
+    }
+
+    // The commitments are independent of each other, compute them on all cores
+    std::vector<GroupElement> commitments(seeds.size());
+    std::vector<uint256> serialHashes(seeds.size());
+    std::vector<char> fValid(seeds.size(), false);
+    std::atomic<size_t> next(0);
+
+    // get_default() initializes the parameters lazily, which is not thread safe
+    const sigma::Params* params = sigma::Params::get_default();
+
+    auto worker = [&, params]() {
+        size_t i;
+        while ((i = next++) < seeds.size()) {
+            sigma::PrivateCoin coin(params, sigma::CoinDenomination::SIGMA_DENOM_X1);
+            if (SeedToZerocoin(seeds[i].seedZerocoin, commitments[i], coin)) {
+                serialHashes[i] = primitives::GetSerialHash(coin.getSerialNumber());
+                fValid[i] = true;
+            }
+        }
+    };
+
+    size_t nThreads = std::min(static_cast<size_t>(std::max(GetNumCores(), 1)), seeds.size());
+    boost::thread_group workers;
+    for (size_t i = 1; i < nThreads; i++)
+        workers.create_thread(worker);
+    worker();
+    workers.join_all();
+
+    // Write the whole batch in a single database transaction, the pool in
+    // memory and the seed count are only updated once it is committed
+    if (!walletdb.TxnBegin()) {
+        LogPrintf("%s : failed to begin the database transaction\n", __func__);
+        return;
+    }
+
+    std::vector<std::pair<uint256, MintPoolEntry>> entries;
+    for (size_t i = 0; i < seeds.size(); i++) {
+        if (!fValid[i])
             continue;
 
-        uint256 hashPubcoin = primitives::GetPubCoinValueHash(commitmentValue);
+        uint256 hashPubcoin = primitives::GetPubCoinValueHash(commitments[i]);
+
+        MintPoolEntry mintPoolEntry(hashSeedMaster, seeds[i].seedId, seeds[i].nCount);
+        if (!walletdb.WritePubcoin(serialHashes[i], commitments[i]) || !walletdb.WriteMintPoolPair(hashPubcoin, mintPoolEntry)) {
+            LogPrintf("%s : failed to write the mint pool entry for count %d\n", __func__, seeds[i].nCount);
+            walletdb.TxnAbort();
+            return;
+        }
+        entries.push_back(make_pair(hashPubcoin, mintPoolEntry));
+        LogPrintf("%s : hashSeedMaster=%s hashPubcoin=%s seedId=%d count=%d\n", __func__, hashSeedMaster.GetHex(), hashPubcoin.GetHex(), seeds[i].seedId.GetHex(), seeds[i].nCount);
+    }
+
+    // Update the DB entry for count last generated, unless interrupted
+    if (!fShutdown && !walletdb.WriteZerocoinSeedCount(nLastCount)) {
+        LogPrintf("%s : failed to write the seed count\n", __func__);
+        walletdb.TxnAbort();
+        return;
+    }
 
-        MintPoolEntry mintPoolEntry(hashSeedMaster, seedId, nLastCount);
-        mintPool.Add(make_pair(hashPubcoin, mintPoolEntry));
-        CWalletDB(strWalletFile).WritePubcoin(primitives::GetSerialHash(coin.getSerialNumber()), commitmentValue);
-        CWalletDB(strWalletFile).WriteMintPoolPair(hashPubcoin, mintPoolEntry);
-        LogPrintf("%s : hashSeedMaster=%s hashPubcoin=%s seedId=%d count=%d\n", __func__, hashSeedMaster.GetHex(), hashPubcoin.GetHex(), seedId.GetHex(), nLastCount);
+    if (!walletdb.TxnCommit()) {
+        LogPrintf("%s : failed to commit the database transaction\n", __func__);
+        return;
     }
 
-    // Update local + DB entries for count last generated
-    nCountNextGenerate = nLastCount;
-    walletdb.WriteZerocoinSeedCount(nCountNextGenerate);
+    for (auto& entry : entries)
+        mintPool.Add(entry);
 
+    if (!fShutdown)
+        nCountNextGenerate = nLastCount;
 }
 
 bool CHDMintWallet::LoadMintPoolFromDB()
@@ -174,9 +245,152 @@ bool CHDMintWallet::GetSerialForPubcoin(const std::vector<std::pair<uint256, Gro
     return fFound;
 }
 
+/**
+ * Matches the mint pool against the given chain mints in a single forward pass. Whenever one of our mints is found
+ * it is added to the wallet and the mint pool is extended, so the mints following it are found in the same pass.
+ *
+ * @param chainMints mints of the active chain in chain order, with their blocks
+ * @param chainMintHashes pubcoin value hashes of chainMints
+ * @param setAddedTx transactions already added to the wallet
+ * @return true if a new mint was found
+ */
+bool CHDMintWallet::ScanChainForMints(const std::vector<std::pair<CBlockIndex*, const sigma::PublicCoin*>>& chainMints, const std::vector<uint256>& chainMintHashes, std::set<uint256>& setAddedTx)
+{
+    CWalletDB walletdb(strWalletFile);
+    bool found = false;
+
+    // matches are in chain order, so mints from the same block are read only once
+    CBlock block;
+    CBlockIndex* pindexBlock = nullptr;
+
+    for (size_t i = 0; i < chainMints.size(); i++) {
+        auto it = mintPool.find(chainMintHashes[i]);
+        if (it == mintPool.end() || tracker.HasPubcoinHash(it->first))
+            continue;
+
+        if (ShutdownRequested())
+            return false;
+
+        std::pair<uint256, MintPoolEntry> pMint = *it;
+        CBlockIndex* pindex = chainMints[i].first;
+        const sigma::PublicCoin& pubCoin = *chainMints[i].second;
+        uint160& mintHashSeedMaster = get<0>(pMint.second);
+        int32_t& mintCount = get<2>(pMint.second);
+
+        if (pindexBlock != pindex) {
+            if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+                LogPrintf("%s : failed to read block %s for mint %s!\n", __func__, pindex->GetBlockHash().GetHex(), pMint.first.GetHex());
+                continue;
+            }
+            pindexBlock = pindex;
+        }
+
+        const CTransaction* ptx = nullptr;
+        for (const CTransaction& tx : block.vtx) {
+            for (const CTxOut& out : tx.vout) {
+                if (out.scriptPubKey.IsSigmaMint() && sigma::ParseSigmaMintScript(out.scriptPubKey) == pubCoin.getValue()) {
+                    ptx = &tx;
+                    break;
+                }
+            }
+            if (ptx)
+                break;
+        }
+
+        if (!ptx) {
+            LogPrintf("%s : failed to get mint %s from block %s!\n", __func__, pMint.first.GetHex(), pindex->GetBlockHash().GetHex());
+            continue;
+        }
+
+        const uint256& txHash = ptx->GetHash();
+        LogPrintf("%s : Found wallet coin mint=%s count=%d tx=%s\n", __func__, pMint.first.GetHex(), mintCount, txHash.GetHex());
+
+        if (!setAddedTx.count(txHash)) {
+            CWalletTx wtx(pwalletMain, *ptx);
+            wtx.SetMerkleBranch(block);
+
+            //Fill out wtx so that a transaction record can be created
+            wtx.nTimeReceived = pindex->GetBlockTime();
+            pwalletMain->AddToWallet(wtx, false, &walletdb);
+            setAddedTx.insert(txHash);
+        }
+
+        if (!SetMintSeedSeen(pMint, pindex->nHeight, txHash, pubCoin.getDenomination()))
+            continue;
+
+        found = true;
+
+        // Only update if the current hashSeedMaster matches the mints'
+        if (hashSeedMaster == mintHashSeedMaster && mintCount >= GetCount()) {
+            SetCount(++mintCount);
+            UpdateCountDB();
+            LogPrint("zero", "%s: updated count to %d\n", __func__, nCountNextUse);
+        }
+
+        // keep the lookahead window ahead of the mints found so far
+        GenerateMintPool();
+    }
+
+    return found;
+}
+
+/**
+ * Catches the counter up with the chain by sweeping over all the sigma mints of the active chain, instead of looking
+ * up every mint pool entry in the chain separately.
+ */
+void CHDMintWallet::SyncWithChainSweep()
+{
+    LOCK2(cs_main, pwalletMain->cs_wallet);
+
+    GenerateMintPool();
+    LogPrintf("%s: Mintpool size=%d\n", __func__, mintPool.size());
+
+    std::vector<std::pair<CBlockIndex*, const sigma::PublicCoin*>> chainMints;
+    for (int nHeight = std::max(Params().GetConsensus().nSigmaStartBlock, 0); nHeight <= chainActive.Height(); nHeight++) {
+        CBlockIndex* pindex = chainActive[nHeight];
+        for (const auto& mints : pindex->sigmaMintedPubCoins) {
+            for (const sigma::PublicCoin& pubCoin : mints.second)
+                chainMints.emplace_back(pindex, &pubCoin);
+        }
+    }
+
+    // Hashing the pubcoins is the expensive part of the sweep, do it on all cores
+    std::vector<uint256> chainMintHashes(chainMints.size());
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < chainMints.size())
+            chainMintHashes[i] = primitives::GetPubCoinValueHash(chainMints[i].second->getValue());
+    };
+
+    size_t nThreads = std::min(static_cast<size_t>(std::max(GetNumCores(), 1)), chainMints.size());
+    boost::thread_group workers;
+    for (size_t i = 1; i < nThreads; i++)
+        workers.create_thread(worker);
+    worker();
+    workers.join_all();
+
+    LogPrintf("%s: Matching %d chain mints\n", __func__, chainMints.size());
+
+    // Mint pool entries added during a pass were not checked against the mints before them. That is only
+    // possible if the mints were not created in order, in which case another pass finds them.
+    std::set<uint256> setAddedTx;
+    while (ScanChainForMints(chainMints, chainMintHashes, setAddedTx)) {
+        if (ShutdownRequested())
+            return;
+    }
+}
+
 //Catch the counter up with the chain
 void CHDMintWallet::SyncWithChain(bool fGenerateMintPool, boost::optional<std::list<std::pair<uint256, MintPoolEntry>>> listMints)
 {
+    // Full sync, match the whole mint pool against the chain at once
+    if (fGenerateMintPool && listMints == boost::none) {
+        SyncWithChainSweep();
+        return;
+    }
+
     bool found = true;
     CWalletDB walletdb(strWalletFile);
 
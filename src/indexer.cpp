@@ -0,0 +1,517 @@
+// Copyright (c) 2019 The BitcoinZero Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexer.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "main.h"
+#include "sigma.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+// Same record prefixes the indexes used when they were part of the block tree database
+static const char DB_ADDRESSINDEX = 'a';
+static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCE = 'b';
+static const char DB_TIMESTAMPINDEX = 's';
+static const char DB_SPENTINDEX = 'p';
+static const char DB_TOTAL_SUPPLY = 'S';
+static const char DB_BEST_BLOCK = 'B';
+
+//! Log progress of an index catching up every that many blocks
+static const int INDEXER_PROGRESS_INTERVAL = 10000;
+
+CAddressIndexer* paddressindexer = NULL;
+CSpentIndexer* pspentindexer = NULL;
+CTimestampIndexer* ptimestampindexer = NULL;
+
+CBaseIndexer::CBaseIndexer(const std::string& name, size_t nCacheSize, bool fWipe) :
+    db(GetDataDir() / "indexes" / name, nCacheSize, false, fWipe, false, name + "index"),
+    name(name),
+    threadName(name + "index"),
+    pindexBest(NULL),
+    fSynced(false),
+    fWake(false)
+{
+}
+
+void CBaseIndexer::Init()
+{
+    AssertLockHeld(cs_main);
+
+    CBlockLocator locator;
+    if (!db.Read(DB_BEST_BLOCK, locator) || locator.IsNull()) {
+        LogPrintf("%s index: no blocks indexed yet, building from genesis\n", name);
+        return;
+    }
+
+    BlockMap::iterator mi = mapBlockIndex.find(locator.vHave.front());
+    if (mi != mapBlockIndex.end()) {
+        pindexBest = mi->second;
+    } else {
+        // Entries of the blocks after the fork cannot be removed without the blocks themselves
+        pindexBest = FindForkInGlobalIndex(chainActive, locator);
+        const CBlockIndex* pindexFork = pindexBest;
+        LogPrintf("%s index: last indexed block %s is unknown, continuing from %s\n",
+                  name, locator.vHave.front().ToString(), pindexFork ? pindexFork->GetBlockHash().ToString() : "genesis");
+    }
+    LogPrintf("%s index: last indexed block at height %d\n", name, GetBestHeight());
+}
+
+int CBaseIndexer::GetBestHeight() const
+{
+    const CBlockIndex* pindex = pindexBest;
+    return pindex ? pindex->nHeight : -1;
+}
+
+void CBaseIndexer::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csWake);
+        fWake = true;
+    }
+    condWake.notify_one();
+}
+
+/**
+ * Read a block and the outputs it spends, and write its entries to the index
+ * together with the new locator in one batch.
+ *
+ * @param pindex The block to connect or disconnect
+ * @param fConnect Whether the block joins or leaves the active chain
+ * @param locator Locator of the last indexed block once this one is processed
+ * @return True if the batch was written
+ */
+bool CBaseIndexer::WriteBlock(const CBlockIndex* pindex, bool fConnect, const CBlockLocator& locator)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+
+    CDiskBlockPos blockPos, undoPos;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+        undoPos = pindex->GetUndoPos();
+    }
+
+    // The block has been validated already, so there is no need to check its PoW again
+    CBlock block;
+    if (!ReadBlockFromDisk(block, blockPos, pindex->nHeight, consensusParams, false))
+        return error("%s: %s index cannot read block %s", __func__, name, pindex->GetBlockHash().ToString());
+    if (block.GetHash() != pindex->GetBlockHash())
+        return error("%s: %s index read wrong block at %s", __func__, name, blockPos.ToString());
+
+    CDBBatch batch(db);
+
+    // Transactions of the genesis block are never connected
+    if (pindex->pprev) {
+        // Rebuild the outputs spent by the block from its undo data, so that
+        // CDbIndexHelper finds them the same way it does during ConnectBlock
+        CCoinsView viewDummy;
+        CCoinsViewCache view(&viewDummy);
+        CAmount nFees = 0;
+
+        if (NeedsSpentOutputs()) {
+            CBlockUndo blockundo;
+            if (undoPos.IsNull() || !UndoReadFromDisk(blockundo, undoPos, pindex->pprev->GetBlockHash()))
+                return error("%s: %s index cannot read undo data of block %s", __func__, name, pindex->GetBlockHash().ToString());
+            if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+                return error("%s: %s index found block and undo data inconsistent", __func__, name);
+
+            for (unsigned int i = 1; i < block.vtx.size(); i++) {
+                const CTransaction& tx = block.vtx[i];
+                if (tx.IsSigmaSpend())
+                    nFees += sigma::GetSigmaSpendInput(tx) - tx.GetValueOut();
+                if (tx.IsZerocoinSpend() || tx.IsSigmaSpend())
+                    continue;
+
+                const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+                if (txundo.vprevout.size() != tx.vin.size())
+                    return error("%s: %s index found transaction and undo data inconsistent", __func__, name);
+
+                CAmount nValueIn = 0;
+                for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                    const COutPoint& prevout = tx.vin[j].prevout;
+                    CCoinsModifier coins = view.ModifyCoins(prevout.hash);
+                    if (coins->vout.size() <= prevout.n)
+                        coins->vout.resize(prevout.n + 1);
+                    coins->vout[prevout.n] = txundo.vprevout[j].txout;
+                    nValueIn += txundo.vprevout[j].txout.nValue;
+                }
+                nFees += nValueIn - tx.GetValueOut();
+            }
+        }
+
+        if (fConnect)
+            ConnectBlock(batch, block, pindex, view, nFees);
+        else
+            DisconnectBlock(batch, block, pindex, view, nFees);
+    }
+
+    batch.Write(DB_BEST_BLOCK, locator);
+    if (!db.WriteBatch(batch))
+        return error("%s: %s index failed to write block %s", __func__, name, pindex->GetBlockHash().ToString());
+
+    BlockWritten();
+    return true;
+}
+
+void CBaseIndexer::ThreadSync()
+{
+    int nLastLogged = GetBestHeight();
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex* pindexPrev = pindexBest;
+        const CBlockIndex* pindex = NULL;
+        bool fConnect = true;
+        CBlockLocator locator;
+        {
+            LOCK(cs_main);
+            if (pindexPrev && !chainActive.Contains(pindexPrev)) {
+                // Reorg: take the last indexed block off first
+                pindex = pindexPrev;
+                fConnect = false;
+                locator = chainActive.GetLocator(pindex->pprev);
+            } else {
+                pindex = pindexPrev ? chainActive.Next(pindexPrev) : chainActive.Genesis();
+                if (pindex)
+                    locator = chainActive.GetLocator(pindex);
+            }
+        }
+
+        if (!pindex) {
+            if (!fSynced) {
+                fSynced = true;
+                LogPrintf("%s index: synced to height %d\n", name, GetBestHeight());
+            }
+            boost::unique_lock<boost::mutex> lock(csWake);
+            while (!fWake)
+                condWake.wait(lock);
+            fWake = false;
+            continue;
+        }
+
+        if (!WriteBlock(pindex, fConnect, locator)) {
+            // Queries must not be answered from an index that stopped following the chain
+            fSynced = false;
+            AbortNode(strprintf("%s index: failed to write block at height %d", name, pindex->nHeight), "");
+            return;
+        }
+        pindexBest = fConnect ? pindex : pindex->pprev;
+
+        if (!fSynced && GetBestHeight() >= nLastLogged + INDEXER_PROGRESS_INTERVAL) {
+            nLastLogged = GetBestHeight();
+            LogPrintf("%s index: indexed up to height %d\n", name, nLastLogged);
+        }
+    }
+}
+
+CAddressIndexer::CAddressIndexer(size_t nCacheSize, bool fWipe) :
+    CBaseIndexer("address", nCacheSize, fWipe),
+    nTotalSupply(0),
+    nTotalSupplyPending(0)
+{
+    fHaveTotalSupply = db.Read(DB_TOTAL_SUPPLY, nTotalSupply);
+    nTotalSupplyPending = nTotalSupply;
+}
+
+void CAddressIndexer::ConnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                                   const CCoinsViewCache& view, CAmount nFees)
+{
+    CDbIndexHelper dbIndexHelper(true, false);
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+        dbIndexHelper.ConnectTransaction(block.vtx[i], pindex->nHeight, i, view);
+
+    for (const auto& entry : dbIndexHelper.getAddressIndex())
+        batch.Write(make_pair(DB_ADDRESSINDEX, entry.first), entry.second);
+    UpdateBalances(batch, dbIndexHelper.getAddressIndex(), true);
+
+    for (const auto& entry : dbIndexHelper.getAddressUnspentIndex()) {
+        if (entry.second.IsNull())
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, entry.first));
+        else
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, entry.first), entry.second);
+    }
+
+    nTotalSupplyPending = nTotalSupply + block.vtx[0].GetValueOut() - nFees;
+    batch.Write(DB_TOTAL_SUPPLY, nTotalSupplyPending);
+}
+
+void CAddressIndexer::DisconnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                                      const CCoinsViewCache& view, CAmount nFees)
+{
+    CDbIndexHelper dbIndexHelper(true, false);
+    for (int i = block.vtx.size() - 1; i >= 0; i--) {
+        dbIndexHelper.DisconnectTransactionOutputs(block.vtx[i], pindex->nHeight, i, view);
+        dbIndexHelper.DisconnectTransactionInputs(block.vtx[i], pindex->nHeight, i, view);
+    }
+
+    for (const auto& entry : dbIndexHelper.getAddressIndex())
+        batch.Erase(make_pair(DB_ADDRESSINDEX, entry.first));
+    UpdateBalances(batch, dbIndexHelper.getAddressIndex(), false);
+
+    for (const auto& entry : dbIndexHelper.getAddressUnspentIndex()) {
+        if (entry.second.IsNull())
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, entry.first));
+        else
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, entry.first), entry.second);
+    }
+
+    nTotalSupplyPending = nTotalSupply - (block.vtx[0].GetValueOut() - nFees);
+    batch.Write(DB_TOTAL_SUPPLY, nTotalSupplyPending);
+}
+
+void CAddressIndexer::UpdateBalances(CDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, bool fConnect)
+{
+    // Sum the deltas of the block per address first, so each balance is read and written once
+    std::map<std::pair<AddressType, uint160>, CAddressBalanceValue> mapDeltas;
+    for (const auto& entry : addressIndex) {
+        CAddressBalanceValue& delta = mapDeltas[make_pair(entry.first.type, entry.first.hashBytes)];
+        delta.balance += entry.second;
+        if (entry.second > 0)
+            delta.received += entry.second;
+    }
+
+    for (const auto& entry : mapDeltas) {
+        CAddressIndexIteratorKey key(entry.first.first, entry.first.second);
+        CAddressBalanceValue value;
+        db.Read(make_pair(DB_ADDRESSBALANCE, key), value);
+        if (fConnect) {
+            value.balance += entry.second.balance;
+            value.received += entry.second.received;
+        } else {
+            value.balance -= entry.second.balance;
+            value.received -= entry.second.received;
+        }
+
+        if (value.IsNull())
+            batch.Erase(make_pair(DB_ADDRESSBALANCE, key));
+        else
+            batch.Write(make_pair(DB_ADDRESSBALANCE, key), value);
+    }
+}
+
+void CAddressIndexer::BlockWritten()
+{
+    nTotalSupply = nTotalSupplyPending;
+    fHaveTotalSupply = true;
+}
+
+bool CAddressIndexer::ForEachAddressIndex(uint160 addressHash, AddressType type, int start, int end,
+                                          const AddressIndexVisitor& visitor)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    if (start > 0) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CAddressIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash && key.second.type == type) {
+            if (end > 0 && key.second.blockHeight > end) {
+                break;
+            }
+            CAmount nValue;
+            if (!pcursor->GetValue(nValue))
+                return error("failed to get address index value");
+            if (!visitor(key.second, nValue))
+                break;
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CAddressIndexer::ReadAddressIndex(uint160 addressHash, AddressType type,
+                                       std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                                       int start, int end)
+{
+    if (start <= 0 || end <= 0)
+        start = end = 0;
+
+    return ForEachAddressIndex(addressHash, type, start, end,
+            [&addressIndex](const CAddressIndexKey& key, CAmount nValue) {
+                addressIndex.push_back(make_pair(key, nValue));
+                return true;
+            });
+}
+
+bool CAddressIndexer::ReadAddressBalance(uint160 addressHash, AddressType type, CAddressBalanceValue& value)
+{
+    value.SetNull();
+    db.Read(make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash)), value);
+    return true;
+}
+
+bool CAddressIndexer::ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
+                                              std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& unspentOutputs)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CAddressUnspentKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            CAddressUnspentValue nValue;
+            if (pcursor->GetValue(nValue)) {
+                unspentOutputs.push_back(make_pair(key.second, nValue));
+                pcursor->Next();
+            } else {
+                return error("failed to get address unspent value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CAddressIndexer::ReadTotalSupply(CAmount& supply)
+{
+    if (!fHaveTotalSupply)
+        return false;
+    supply = nTotalSupply;
+    return true;
+}
+
+CSpentIndexer::CSpentIndexer(size_t nCacheSize, bool fWipe) :
+    CBaseIndexer("spent", nCacheSize, fWipe)
+{
+}
+
+void CSpentIndexer::ConnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                                 const CCoinsViewCache& view, CAmount nFees)
+{
+    CDbIndexHelper dbIndexHelper(false, true);
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+        dbIndexHelper.ConnectTransaction(block.vtx[i], pindex->nHeight, i, view);
+
+    for (const auto& entry : dbIndexHelper.getSpentIndex())
+        batch.Write(make_pair(DB_SPENTINDEX, entry.first), entry.second);
+}
+
+void CSpentIndexer::DisconnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                                    const CCoinsViewCache& view, CAmount nFees)
+{
+    // Outputs spent by the block are unspent again
+    CDbIndexHelper dbIndexHelper(false, true);
+    for (int i = block.vtx.size() - 1; i >= 0; i--)
+        dbIndexHelper.DisconnectTransactionInputs(block.vtx[i], pindex->nHeight, i, view);
+
+    for (const auto& entry : dbIndexHelper.getSpentIndex())
+        batch.Erase(make_pair(DB_SPENTINDEX, entry.first));
+}
+
+bool CSpentIndexer::ReadSpentIndex(CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return db.Read(make_pair(DB_SPENTINDEX, key), value);
+}
+
+CTimestampIndexer::CTimestampIndexer(size_t nCacheSize, bool fWipe) :
+    CBaseIndexer("timestamp", nCacheSize, fWipe)
+{
+}
+
+void CTimestampIndexer::ConnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                                     const CCoinsViewCache& view, CAmount nFees)
+{
+    batch.Write(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())), 0);
+}
+
+void CTimestampIndexer::DisconnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                                        const CCoinsViewCache& view, CAmount nFees)
+{
+    batch.Erase(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())));
+}
+
+bool CTimestampIndexer::ReadTimestampIndex(const unsigned int& high, const unsigned int& low, std::vector<uint256>& hashes)
+{
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CTimestampIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
+            hashes.push_back(key.second.blockHash);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+static std::vector<CBaseIndexer*> GetIndexers()
+{
+    std::vector<CBaseIndexer*> indexers;
+    if (paddressindexer)
+        indexers.push_back(paddressindexer);
+    if (pspentindexer)
+        indexers.push_back(pspentindexer);
+    if (ptimestampindexer)
+        indexers.push_back(ptimestampindexer);
+    return indexers;
+}
+
+void InitIndexers(size_t nCacheSize, bool fWipe)
+{
+    if (!fAddressIndex && !fSpentIndex && !fTimestampIndex)
+        return;
+
+    TryCreateDirectory(GetDataDir() / "indexes");
+
+    if (fAddressIndex)
+        paddressindexer = new CAddressIndexer(nCacheSize, fWipe);
+    if (fSpentIndex)
+        pspentindexer = new CSpentIndexer(nCacheSize, fWipe);
+    if (fTimestampIndex)
+        ptimestampindexer = new CTimestampIndexer(nCacheSize, fWipe);
+
+    LOCK(cs_main);
+    for (CBaseIndexer* indexer : GetIndexers())
+        indexer->Init();
+}
+
+void StartIndexers(boost::thread_group& threadGroup)
+{
+    for (CBaseIndexer* indexer : GetIndexers()) {
+        RegisterValidationInterface(indexer);
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >,
+                indexer->GetThreadName(), boost::function<void()>(boost::bind(&CBaseIndexer::ThreadSync, indexer))));
+    }
+}
+
+void StopIndexers()
+{
+    for (CBaseIndexer* indexer : GetIndexers()) {
+        UnregisterValidationInterface(indexer);
+        delete indexer;
+    }
+    paddressindexer = NULL;
+    pspentindexer = NULL;
+    ptimestampindexer = NULL;
+}
@@ -0,0 +1,172 @@
+// Copyright (c) 2019 The BitcoinZero Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEXER_H
+#define BITCOIN_INDEXER_H
+
+#include "amount.h"
+#include "dbwrapper.h"
+#include "spentindex.h"
+#include "validationinterface.h"
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlock;
+class CBlockIndex;
+class CCoinsViewCache;
+struct CBlockLocator;
+
+namespace boost {
+class thread_group;
+} // namespace boost
+
+//! -indexdbcache default, per background index database (MiB)
+static const int64_t nDefaultIndexDBCache = 16;
+
+/**
+ * Base of the optional indexes (address, spent, timestamp) that are not
+ * written by ConnectBlock. Each one lives in its own database under indexes/
+ * together with the locator of the last block it has indexed, and a thread
+ * follows the active chain from there: connecting blocks as the tip moves,
+ * disconnecting them on reorgs and catching up after restarts. An index can
+ * therefore be enabled on a running node without -reindex.
+ */
+class CBaseIndexer : public CValidationInterface
+{
+public:
+    CBaseIndexer(const std::string& name, size_t nCacheSize, bool fWipe);
+    virtual ~CBaseIndexer() {}
+
+    //! Find the last indexed block in the block index. Requires cs_main.
+    void Init();
+
+    //! Body of the indexer thread, returns when interrupted or on a write failure, which shuts the node down
+    void ThreadSync();
+
+    const std::string& GetName() const { return name; }
+
+    //! Name of the indexer thread, kept here as TraceThread holds on to the pointer
+    const char* GetThreadName() const { return threadName.c_str(); }
+
+    //! Whether the index has caught up with the active chain since startup
+    bool IsSynced() const { return fSynced; }
+
+    //! Height of the last indexed block, -1 if there is none
+    int GetBestHeight() const;
+
+protected:
+    //! Queue the entries of a newly connected block
+    virtual void ConnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                              const CCoinsViewCache& view, CAmount nFees) = 0;
+    //! Queue the removal of the entries of a block leaving the active chain
+    virtual void DisconnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                                 const CCoinsViewCache& view, CAmount nFees) = 0;
+    //! Called once the batch of a block has been written
+    virtual void BlockWritten() {}
+    //! Whether the index needs the outputs spent by the block, read from its undo data
+    virtual bool NeedsSpentOutputs() const { return true; }
+
+    void UpdatedBlockTip(const CBlockIndex* pindex);
+
+    CDBWrapper db;
+
+private:
+    bool WriteBlock(const CBlockIndex* pindex, bool fConnect, const CBlockLocator& locator);
+
+    const std::string name;
+    const std::string threadName;
+    std::atomic<const CBlockIndex*> pindexBest;
+    std::atomic<bool> fSynced;
+
+    boost::mutex csWake;
+    boost::condition_variable condWake;
+    bool fWake;
+};
+
+/**
+ * Address deltas, running balance by address, unspent outputs by address and
+ * total coin supply (-addressindex)
+ */
+class CAddressIndexer : public CBaseIndexer
+{
+public:
+    CAddressIndexer(size_t nCacheSize, bool fWipe);
+
+    bool ReadAddressIndex(uint160 addressHash, AddressType type,
+                          std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                          int start = 0, int end = 0);
+    //! Stream the deltas of an address, optionally limited to the heights start..end
+    bool ForEachAddressIndex(uint160 addressHash, AddressType type, int start, int end,
+                             const AddressIndexVisitor& visitor);
+    //! Balance and total received of an address without walking its deltas
+    bool ReadAddressBalance(uint160 addressHash, AddressType type, CAddressBalanceValue& value);
+    bool ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect);
+    bool ReadTotalSupply(CAmount& supply);
+
+protected:
+    void ConnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                      const CCoinsViewCache& view, CAmount nFees);
+    void DisconnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                         const CCoinsViewCache& view, CAmount nFees);
+    void BlockWritten();
+
+private:
+    void UpdateBalances(CDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, bool fConnect);
+
+    CAmount nTotalSupply;
+    CAmount nTotalSupplyPending;
+    bool fHaveTotalSupply;
+};
+
+/** Spending input of every spent output (-spentindex) */
+class CSpentIndexer : public CBaseIndexer
+{
+public:
+    CSpentIndexer(size_t nCacheSize, bool fWipe);
+
+    bool ReadSpentIndex(CSpentIndexKey& key, CSpentIndexValue& value);
+
+protected:
+    void ConnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                      const CCoinsViewCache& view, CAmount nFees);
+    void DisconnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                         const CCoinsViewCache& view, CAmount nFees);
+};
+
+/** Block hashes by block time (-timestampindex) */
+class CTimestampIndexer : public CBaseIndexer
+{
+public:
+    CTimestampIndexer(size_t nCacheSize, bool fWipe);
+
+    bool ReadTimestampIndex(const unsigned int& high, const unsigned int& low, std::vector<uint256>& hashes);
+
+protected:
+    void ConnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                      const CCoinsViewCache& view, CAmount nFees);
+    void DisconnectBlock(CDBBatch& batch, const CBlock& block, const CBlockIndex* pindex,
+                         const CCoinsViewCache& view, CAmount nFees);
+    bool NeedsSpentOutputs() const { return false; }
+};
+
+/** The enabled background indexes, NULL when disabled */
+extern CAddressIndexer* paddressindexer;
+extern CSpentIndexer* pspentindexer;
+extern CTimestampIndexer* ptimestampindexer;
+
+/** Open the databases of the indexes enabled by fAddressIndex, fSpentIndex and fTimestampIndex */
+void InitIndexers(size_t nCacheSize, bool fWipe);
+/** Start one thread per enabled index */
+void StartIndexers(boost::thread_group& threadGroup);
+/** Close the indexes, their threads must have been joined already */
+void StopIndexers();
+
+#endif // BITCOIN_INDEXER_H
@@ -20,6 +20,7 @@
 #include "exodus/exodus.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "indexer.h"
 #include "key.h"
 #include "main.h"
 #include "zerocoin.h"
@@ -43,6 +44,7 @@
 
 #ifdef ENABLE_WALLET
 #include "wallet/wallet.h"
+#include "wallet/sigmaspendbuilder.h"
 #endif
 
 #include <stdint.h>
@@ -199,7 +201,6 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB *pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher *pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -307,11 +308,15 @@ void Shutdown() {
         pcoinsTip = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
+        // Finishes the last background write
+        delete pcoinswritebehind;
+        pcoinswritebehind = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
         delete pblocktree;
         pblocktree = NULL;
     }
+    StopIndexers();
 
     if (isExodusEnabled()) {
         exodus_shutdown();
@@ -404,6 +409,10 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-checkblocks=<n>",
                                strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"),
                                          DEFAULT_CHECKBLOCKS));
+    strUsage += HelpMessageOpt("-backgroundverify",
+                               strprintf(_("Check the -checkblocks blocks once the node has started instead of before, "
+                                           "warning on a corrupted database instead of rebuilding it (default: %u)"),
+                                         DEFAULT_BACKGROUND_VERIFY));
     strUsage += HelpMessageOpt("-checklevel=<n>",
                                strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"),
                                          DEFAULT_CHECKLEVEL));
@@ -418,6 +427,9 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-dbcache=<n>",
                                strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache,
                                          nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-dboption=<profile>:<setting>=<value>", _("Tune the LevelDB databases of a profile (chainstate, blockindex, addressindex, spentindex, timestampindex or exodus). "
+            "Settings are blockcache and writebuffer in megabytes, bloombits, compression (0 or 1) and maxopenfiles. Can be specified multiple times"));
+    strUsage += HelpMessageOpt("-writebehind", strprintf(_("Write the chainstate to disk in the background while blocks keep being validated. The batch being written takes half of the in-memory UTXO set share of -dbcache (default: %u)"), DEFAULT_WRITE_BEHIND));
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf(
                 "Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
@@ -454,6 +466,7 @@ std::string HelpMessage(HelpMessageMode mode) {
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-indexdbcache=<n>", strprintf(_("Database cache size in megabytes of each of -addressindex, -timestampindex and -spentindex (default: %d)"), nDefaultIndexDBCache));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -838,18 +851,7 @@ void ThreadImport(std::vector <boost::filesystem::path> vImportFiles) {
     CImportingNow imp;
     // -reindex
     if (fReindex) {
-        int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int) nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
-        }
+        ReindexBlockFiles(chainparams);
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
@@ -1203,6 +1205,8 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (GetArg("-prune", 0)) {
         if (GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) || GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex, -spentindex and -timestampindex."));
 #ifdef ENABLE_WALLET
         if (GetBoolArg("-rescan", false)) {
             return InitError(_("Rescans are not possible in pruned mode. You will need to use -reindex which will download the whole blockchain again."));
@@ -1471,7 +1475,7 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
             return InitError(_("Unable to start HTTP server. See debug log for details."));
     }
 
-    int64_t nStart;
+    int64_t nStart = GetTimeMillis();
 
     // ********************************************************* Step 5: verify wallet database integrity
 #ifdef ENABLE_WALLET
@@ -1770,6 +1774,9 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     }
 
     // cache size calculations
+    std::string strDBOptionError;
+    if (!CheckDBOptions(strDBOptionError))
+        return InitError(strDBOptionError);
     int64_t nTotalCache = (GetArg("-dbcache", nDefaultDbCache) << 20);
 //    nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
 //    nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greater than nMaxDbcache
@@ -1786,13 +1793,20 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     nTotalCache -= nCoinDBCache;
 //    nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     nCoinCacheUsage = nTotalCache / 300;
+    // The batch of the last flush stays in memory until it is written in the background, and it is at most as
+    // large as the cache it was flushed from, so with -writebehind the two share the in-memory budget
+    bool fWriteBehind = GetBoolArg("-writebehind", DEFAULT_WRITE_BEHIND);
+    if (fWriteBehind)
+        nCoinCacheUsage /= 2;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
+    if (fWriteBehind)
+        LogPrintf("* Using %.1fMiB for the UTXO set batch written in the background\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
-    while (!fLoaded) {
+    while (!fLoaded && !fRequestShutdown) {
         bool fReset = fReindex;
         std::string strLoadError;
         LogPrintf("Loading block index...\n");
@@ -1804,14 +1818,28 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
                 LogPrintf("UnloadBlockIndex() \n");
                 UnloadBlockIndex();
                 delete pcoinsTip;
-                delete pcoinsdbview;
                 delete pcoinscatcher;
+                delete pcoinswritebehind;
+                pcoinswritebehind = NULL;
+                delete pcoinsdbview;
                 delete pblocktree;
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
 
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
-                pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
+                if (!pcoinsdbview->Upgrade()) {
+                    strLoadError = _("Error upgrading chainstate database");
+                    break;
+                }
+                // an interrupted upgrade is resumed at the next start, the check below the loop exits
+                if (fRequestShutdown)
+                    break;
+                if (fWriteBehind) {
+                    pcoinswritebehind = new CCoinsViewWriteBehind(pcoinsdbview);
+                    pcoinscatcher = new CCoinsViewErrorCatcher(pcoinswritebehind);
+                } else {
+                    pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
+                }
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
                 LogPrintf("fReindex = %s\n", fReindex);
 
@@ -1881,11 +1909,15 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
                         break;
                     }
                 }
-                LogPrintf("CVerifyDB().VerifyDB...\n");
-                if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview, GetArg("-checklevel", DEFAULT_CHECKLEVEL),
-                                          GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
-                    strLoadError = _("Corrupted block database detected");
-                    break;
+                if (GetBoolArg("-backgroundverify", DEFAULT_BACKGROUND_VERIFY)) {
+                    LogPrintf("Block verification deferred until startup completes\n");
+                } else {
+                    LogPrintf("CVerifyDB().VerifyDB...\n");
+                    if (!CVerifyDB().VerifyDB(chainparams, pcoinswritebehind ? (CCoinsView*)pcoinswritebehind : pcoinsdbview, GetArg("-checklevel", DEFAULT_CHECKLEVEL),
+                                              GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
+                        strLoadError = _("Corrupted block database detected");
+                        break;
+                    }
                 }
             } catch (const std::exception &e) {
                 if (fDebug) LogPrintf("%s\n", e.what());
@@ -1896,7 +1928,7 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
             fLoaded = true;
         } while (false);
 
-        if (!fLoaded) {
+        if (!fLoaded && !fRequestShutdown) {
             // first suggest a reindex
             if (!fReset) {
 
@@ -1922,6 +1954,26 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     }
     LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
 
+    // Index records written into the block index by earlier versions are no longer read
+    if (!pblocktree->EraseLegacyIndexes())
+        return InitError(_("Error erasing old index records from the block index database"));
+    if (fRequestShutdown) {
+        LogPrintf("Shutdown requested. Exiting.\n");
+        return false;
+    }
+
+    // The optional indexes are kept in their own databases and can be switched on and off without a reindex
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    LogPrintf("Address index %s, timestamp index %s, spent index %s\n", fAddressIndex ? "enabled" : "disabled",
+              fTimestampIndex ? "enabled" : "disabled", fSpentIndex ? "enabled" : "disabled");
+    try {
+        InitIndexers(GetArg("-indexdbcache", nDefaultIndexDBCache) << 20, fReindex);
+    } catch (const std::exception &e) {
+        return InitError(strprintf(_("Error opening index databases: %s"), e.what()));
+    }
+
     boost::filesystem::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
     CAutoFile est_filein(fopen(est_path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
     // Allowed to fail as this file IS missing on first startup.
@@ -2034,6 +2086,10 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (mapArgs.count("-blocknotify"))
         uiInterface.NotifyBlockTip.connect(BlockNotifyCallback);
 
+    // gettxoutsetinfo reads statistics stored with the chainstate, compute them when they are not
+    if (!LoadUTXOStats())
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "utxostats", &ThreadRebuildUTXOStats));
+
     std::vector <boost::filesystem::path> vImportFiles;
     if (mapArgs.count("-loadblock")) {
         BOOST_FOREACH(
@@ -2073,6 +2129,7 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     if (GetBoolArg("-listenonion", DEFAULT_LISTEN_ONION))
         StartTorControl(threadGroup, scheduler);
 
+    StartIndexers(threadGroup);
     StartNode(threadGroup, scheduler);
     // Generate coins in the background
     GenerateBitcoins(GetBoolArg("-gen", DEFAULT_GENERATE), GetArg("-genproclimit", DEFAULT_GENERATE_THREADS),
@@ -2211,6 +2268,15 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
     // ********************************************************* Step 12: finished
 
     SetRPCWarmupFinished();
+
+    if (GetBoolArg("-backgroundverify", DEFAULT_BACKGROUND_VERIFY)) {
+        if (GetArg("-checklevel", DEFAULT_CHECKLEVEL) > 3)
+            InitWarning(_("-checklevel=4 reconnects blocks and can't run on a live node, -backgroundverify checks up to level 3"));
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "verifydb",
+                                              boost::function<void()>(boost::bind(&ThreadVerifyDB,
+                                                                                  GetArg("-checklevel", DEFAULT_CHECKLEVEL),
+                                                                                  GetArg("-checkblocks", DEFAULT_CHECKBLOCKS)))));
+    }
     uiInterface.InitMessage(_("Done loading"));
 
 #ifdef ENABLE_WALLET
@@ -2221,6 +2287,10 @@ bool AppInit2(boost::thread_group &threadGroup, CScheduler &scheduler) {
 
         // Run a thread to flush wallet periodically
         threadGroup.create_thread(boost::bind(&ThreadFlushWalletDB, boost::ref(pwalletMain->strWalletFile)));
+
+        // Prepare spend proofs of coins whose anonymity set will not change anymore
+        if (GetBoolArg("-sigmaprecomputeproofs", DEFAULT_SIGMA_PRECOMPUTE_PROOFS))
+            threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "sigmaproofs", &ThreadSigmaProofPrecompute));
     }
 #endif
 
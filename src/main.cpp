@@ -9,6 +9,8 @@
 #include "addrman.h"
 #include "arith_uint256.h"
 #include "blockencodings.h"
+#include "blockstore.h"
+#include "crypto/common.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
@@ -17,6 +19,7 @@
 #include "consensus/validation.h"
 #include "exodus/exodus.h"
 #include "hash.h"
+#include "indexer.h"
 #include "init.h"
 #include "base58.h"
 #include "merkleblock.h"
@@ -41,6 +44,7 @@
 #include "sigma.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
+#include "utxostats.h"
 #include "validationinterface.h"
 #include "versionbits.h"
 #include "definition.h"
@@ -80,6 +84,8 @@ using namespace std;
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+/** Storage of the entries of mapBlockIndex */
+static CBlockIndexArena blockIndexArena;
 CChain chainActive;
 CBlockIndex *pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
@@ -742,6 +748,9 @@ CBlockIndex *FindForkInGlobalIndex(const CChain &chain, const CBlockLocator &loc
 }
 
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewDB *pcoinsdbview = NULL;
+CCoinsViewWriteBehind *pcoinswritebehind = NULL;
+CUTXOStatsTracker utxoStatsTracker;
 CBlockTreeDB *pblocktree = NULL;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1110,6 +1119,16 @@ int64_t GetTransactionSigOpCost(const CTransaction &tx, const CCoinsViewCache &i
     return nSigOps;
 }
 
+CBlockCheckSnapshot GetBlockCheckSnapshot()
+{
+    CBlockCheckSnapshot snapshot;
+    snapshot.fBlockchainSynced = bznodeSync.IsBlockchainSynced();
+    snapshot.fSigmaSporkActive = sporkManager.IsSporkActive(SPORK_20_SIGMA);
+    snapshot.fSigmaSurgeCondition = sigma::CSigmaState::GetState()->IsSurgeConditionDetected();
+    snapshot.fFoundersEnforced = sporkManager.IsSporkActive(SPORK_13_F_PAYMENT_ENFORCEMENT) && bznodeSync.IsSynced();
+    return snapshot;
+}
+
 
 bool CheckTransaction(
         const CTransaction &tx,
@@ -1120,7 +1139,8 @@ bool CheckTransaction(
         bool isCheckWallet,
         bool fStatefulZerocoinCheck,
         CZerocoinTxInfo *zerocoinTxInfo,
-        sigma::CSigmaTxInfo *sigmaTxInfo)
+        sigma::CSigmaTxInfo *sigmaTxInfo,
+        const CBlockCheckSnapshot *psnapshot)
 {
     LogPrintf("CheckTransaction nHeight=%s, isVerifyDB=%s, isCheckWallet=%s, txHash=%s\n", nHeight, isVerifyDB, isCheckWallet, tx.GetHash().ToString());
 //    LogPrintf("transaction = %s\n", tx.ToString());
@@ -1180,7 +1200,8 @@ bool CheckTransaction(
 		    }
 	    }
 
-        if (tx.IsZerocoinV3SigmaTransaction() && (bznodeSync.IsBlockchainSynced()))
+        if (tx.IsZerocoinV3SigmaTransaction() &&
+            (psnapshot ? psnapshot->fBlockchainSynced : bznodeSync.IsBlockchainSynced()))
         {
             if (!CheckSigmaTransaction(
                     tx,
@@ -1190,7 +1211,8 @@ bool CheckTransaction(
                     nHeight,
                     isCheckWallet,
                     fStatefulZerocoinCheck,
-                    sigmaTxInfo))
+                    sigmaTxInfo,
+                    psnapshot))
             return false;
         }
 
@@ -1792,7 +1814,7 @@ bool AcceptToMemoryPoolWorker(
 #ifdef ENABLE_WALLET
         if (zwalletMain) {
             LogPrintf("Updating spend state from Mempool..");
-            zwalletMain->GetTracker().UpdateSpendStateFromMempool(zcSpendSerialsV3);
+            zwalletMain->GetTracker().UpdateSpendStateFromMempool(zcSpendSerialsV3, hash);
         }
 #endif
     }
@@ -1871,14 +1893,15 @@ GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::Params
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
+            CBlockFileSpan span;
+            if (!blockFileReader.Read(postx, "blk", 0, span))
+                return error("%s: reading block file failed", __func__);
             CBlockHeader header;
             try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
+                CMemoryReader reader = span.GetReader(SER_DISK, CLIENT_VERSION);
+                reader >> header;
+                reader.ignore(postx.nTxOffset);
+                reader >> txOut;
             } catch (const std::exception &e) {
                 return error("%s: Deserialize or I/O error - %s", __func__, e.what());
             }
@@ -1923,7 +1946,10 @@ bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::v
     if (!fTimestampIndex)
         return error("Timestamp index not enabled");
 
-    if (!pblocktree->ReadTimestampIndex(high, low, hashes))
+    if (!ptimestampindexer->IsSynced())
+        return error("Timestamp index is still being built, at height %d", ptimestampindexer->GetBestHeight());
+
+    if (!ptimestampindexer->ReadTimestampIndex(high, low, hashes))
         return error("Unable to get hashes for timestamps");
 
     return true;
@@ -1938,7 +1964,10 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value))
         return true;
 
-    if (!pblocktree->ReadSpentIndex(key, value))
+    if (!pspentindexer->IsSynced())
+        return error("spent index is still being built, at height %d", pspentindexer->GetBestHeight());
+
+    if (!pspentindexer->ReadSpentIndex(key, value))
         return false;
 
     return true;
@@ -1950,19 +1979,54 @@ bool GetAddressIndex(uint160 addressHash, AddressType type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!paddressindexer->IsSynced())
+        return error("address index is still being built, at height %d", paddressindexer->GetBestHeight());
+
+    if (!paddressindexer->ReadAddressIndex(addressHash, type, addressIndex, start, end))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool ForEachAddressIndex(uint160 addressHash, AddressType type, int start, int end,
+                         const AddressIndexVisitor &visitor)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!paddressindexer->IsSynced())
+        return error("address index is still being built, at height %d", paddressindexer->GetBestHeight());
+
+    if (!paddressindexer->ForEachAddressIndex(addressHash, type, start, end, visitor))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressBalance(uint160 addressHash, AddressType type, CAddressBalanceValue &value)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!paddressindexer->IsSynced())
+        return error("address index is still being built, at height %d", paddressindexer->GetBestHeight());
+
+    if (!paddressindexer->ReadAddressBalance(addressHash, type, value))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, AddressType type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!paddressindexer->IsSynced())
+        return error("address index is still being built, at height %d", paddressindexer->GetBestHeight());
+
+    if (!paddressindexer->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
         return error("unable to get txids for address");
 
     return true;
@@ -1994,24 +2058,24 @@ bool WriteBlockToDisk(const CBlock &block, CDiskBlockPos &pos, const CMessageHea
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, const Consensus::Params &consensusParams) {
+bool ReadBlockFromDisk(CBlock &block, const CDiskBlockPos &pos, int nHeight, const Consensus::Params &consensusParams, bool fCheckPOW) {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    CBlockFileSpan span;
+    if (!blockFileReader.Read(pos, "blk", 0, span))
+        return error("ReadBlockFromDisk: reading block file failed for %s", pos.ToString());
 
     // Read block
     try {
-        filein >> block;
+        CMemoryReader reader = span.GetReader(SER_DISK, CLIENT_VERSION);
+        reader >> block;
     }
     catch (const std::exception &e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
     // Check the header
-    if (!CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams)){
+    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams)){
         //Maybe cache is not valid
         if (!CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams)){
             return error("ReadBlockFromDisk: CheckProofOfWork: Errors in block header at %s", pos.ToString());
@@ -2032,12 +2096,13 @@ bool ReadBlockFromDisk(CBlock &block, const CBlockIndex *pindex, const Consensus
 }
 
 bool ReadBlockHeaderFromDisk(CBlock &block, const CDiskBlockPos &pos) {
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    CBlockFileSpan span;
+    if (!blockFileReader.Read(pos, "blk", 0, span))
+        return error("ReadBlockFromDisk: reading block file failed for %s", pos.ToString());
 
     try {
-        block.SerializationOp(filein, CBlockHeader::CReadBlockHeader(), SER_DISK, CLIENT_VERSION);
+        CMemoryReader reader = span.GetReader(SER_DISK, CLIENT_VERSION);
+        block.SerializationOp(reader, CBlockHeader::CReadBlockHeader(), SER_DISK, CLIENT_VERSION);
     }
     catch (const std::exception &e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
@@ -2485,32 +2550,6 @@ namespace {
         return true;
     }
 
-    bool UndoReadFromDisk(CBlockUndo &blockundo, const CDiskBlockPos &pos, const uint256 &hashBlock) {
-        // Open history file to read
-        CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-        if (filein.IsNull())
-            return error("%s: OpenUndoFile failed", __func__);
-
-        // Read block
-        uint256 hashChecksum;
-        try {
-            filein >> blockundo;
-            filein >> hashChecksum;
-        }
-        catch (const std::exception &e) {
-            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-        }
-
-        // Verify checksum
-        CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
-        hasher << hashBlock;
-        hasher << blockundo;
-        if (hashChecksum != hasher.GetHash())
-            return error("%s: Checksum mismatch", __func__);
-
-        return true;
-    }
-
 /** Abort with a message */
     /*bool AbortNode(const std::string &strMessage, const std::string &userMessage = "") {
         strMiscWarning = strMessage;
@@ -2530,6 +2569,33 @@ namespace {
 
 } // anon namespace
 
+bool UndoReadFromDisk(CBlockUndo &blockundo, const CDiskBlockPos &pos, const uint256 &hashBlock) {
+    // The checksum follows the undo record
+    CBlockFileSpan span;
+    if (!blockFileReader.Read(pos, "rev", sizeof(uint256), span))
+        return error("%s: reading undo file failed", __func__);
+
+    // Read block
+    uint256 hashChecksum;
+    try {
+        CMemoryReader reader = span.GetReader(SER_DISK, CLIENT_VERSION);
+        reader >> blockundo;
+        reader >> hashChecksum;
+    }
+    catch (const std::exception &e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    // Verify checksum
+    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+    hasher << hashBlock;
+    hasher << blockundo;
+    if (hashChecksum != hasher.GetHash())
+        return error("%s: Checksum mismatch", __func__);
+
+    return true;
+}
+
 /**
  * Apply the undo operation of a CTxInUndo to the given chain state.
  * @param undo The undo object.
@@ -2563,7 +2629,7 @@ static bool ApplyTxInUndo(const CTxInUndo &undo, CCoinsViewCache &view, const CO
 }
 
 bool DisconnectBlock(const CBlock &block, CValidationState &state, const CBlockIndex *pindex, CCoinsViewCache &view,
-                     bool *pfClean) {
+                     bool *pfClean, CUTXOStats *pstats) {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
     if (pfClean)
@@ -2582,18 +2648,12 @@ bool DisconnectBlock(const CBlock &block, CValidationState &state, const CBlockI
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
         return error("DisconnectBlock(): block and undo data inconsistent");
 
-    CDbIndexHelper dbIndexHelper(fAddressIndex, fSpentIndex);
-
-    CAmount nFees = 0;
-
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction &tx = block.vtx[i];
 
         uint256 hash = tx.GetHash();
 
-        dbIndexHelper.DisconnectTransactionOutputs(tx, pindex->nHeight, i, view);
-
         // Check that all outputs are available and match the outputs in the block itself
         // exactly.
         {
@@ -2609,6 +2669,15 @@ bool DisconnectBlock(const CBlock &block, CValidationState &state, const CBlockI
             if (*outs != outsBlock)
                 fClean = fClean && error("DisconnectBlock(): added transaction mismatch? database corrupted");
 
+            if (pstats) {
+                if (!outs->IsPruned())
+                    pstats->nTransactions--;
+                for (unsigned int j = 0; j < outs->vout.size(); j++) {
+                    if (outs->IsAvailable(j))
+                        pstats->RemoveCoin(COutPoint(hash, j), outs->vout[j], outs->nHeight, outs->fCoinBase);
+                }
+            }
+
             // remove outputs
             outs->Clear();
         }
@@ -2621,40 +2690,24 @@ bool DisconnectBlock(const CBlock &block, CValidationState &state, const CBlockI
             for (unsigned int j = tx.vin.size(); j-- > 0;) {
                 const COutPoint &out = tx.vin[j].prevout;
                 const CTxInUndo &undo = txundo.vprevout[j];
-                if (!ApplyTxInUndo(undo, view, out))
+                bool fWasSpent = pstats && !view.HaveCoins(out.hash);
+                if (!ApplyTxInUndo(undo, view, out)) {
+                    // the undo overwrote what was there, which the statistics can't follow; the block fails
+                    // to disconnect cleanly and the caller drops the view together with the statistics
                     fClean = false;
+                } else if (pstats) {
+                    const CCoins *coins = view.AccessCoins(out.hash);
+                    if (fWasSpent)
+                        pstats->nTransactions++;
+                    pstats->AddCoin(out, coins->vout[out.n], coins->nHeight, coins->fCoinBase);
+                }
             }
-            nFees += view.GetValueIn(tx) - tx.GetValueOut();
         }
-
-        if(tx.IsSigmaSpend())
-            nFees += sigma::GetSigmaSpendInput(tx) - tx.GetValueOut();
-
-        dbIndexHelper.DisconnectTransactionInputs(tx, pindex->nHeight, i, view);
     }
 
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
-    //The pfClean flag is specified only when called from CVerifyDB::VerifyDB.
-    //When called from there, no real disconnect happens.
-    if(!pfClean) {
-        if (fAddressIndex) {
-            if (!pblocktree->EraseAddressIndex(dbIndexHelper.getAddressIndex())) {
-                AbortNode(state, "Failed to delete address index");
-                return error("Failed to delete address index");
-            }
-            if (!pblocktree->UpdateAddressUnspentIndex(dbIndexHelper.getAddressUnspentIndex())) {
-                AbortNode(state, "Failed to write address unspent index");
-                return error("Failed to write address unspent index");
-            }
-            if (!pblocktree->AddTotalSupply(-(block.vtx[0].GetValueOut() - nFees))) {
-                AbortNode(state, "Failed to write total supply");
-                return error("Failed to write total supply");
-            }
-        }
-    }
-
     if (pfClean) {
         *pfClean = fClean;
         return true;
@@ -2748,7 +2801,7 @@ static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 
 bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pindex, CCoinsViewCache &view,
-                  const CChainParams &chainparams, bool fJustCheck) {
+                  const CChainParams &chainparams, bool fJustCheck, CUTXOStats *pstats) {
 
     AssertLockHeld(cs_main);
 
@@ -2879,7 +2932,6 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     std::vector <std::pair<uint256, CDiskTxPos>> vPos;
     vPos.reserve(block.vtx.size());
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
-    CDbIndexHelper dbIndexHelper(fAddressIndex, fSpentIndex);
 
     std::vector <PrecomputedTransactionData> txdata;
     txdata.reserve(
@@ -2942,9 +2994,6 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
                                  REJECT_INVALID, "bad-txns-zerocoin");
         }
 
-        if (!fJustCheck)
-            dbIndexHelper.ConnectTransaction(tx, pindex->nHeight, i, view);
-
         // GetTransactionSigOpCost counts 3 types of sigops:
         // * legacy (always)
         // * p2sh (when P2SH enabled in flags and excludes coinbase)
@@ -2967,12 +3016,48 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
             control.Add(vChecks);
         }
 
+        // Outputs leave the statistics with the height and coinbase flag they entered with
+        std::set<uint256> setSpentTxids;
+        if (pstats && !tx.IsCoinBase() && !tx.IsZerocoinSpend() && !tx.IsSigmaSpend()) {
+            BOOST_FOREACH(const CTxIn &txin, tx.vin) {
+                const CCoins *coins = view.AccessCoins(txin.prevout.hash);
+                pstats->RemoveCoin(txin.prevout, coins->vout[txin.prevout.n], coins->nHeight, coins->fCoinBase);
+                setSpentTxids.insert(txin.prevout.hash);
+            }
+        }
+        // A duplicate transaction replaces the unspent outputs of the earlier one (see BIP30)
+        if (pstats) {
+            const CCoins *coinsOld = view.AccessCoins(txHash);
+            if (coinsOld && !coinsOld->IsPruned()) {
+                pstats->nTransactions--;
+                for (unsigned int j = 0; j < coinsOld->vout.size(); j++) {
+                    if (coinsOld->IsAvailable(j))
+                        pstats->RemoveCoin(COutPoint(txHash, j), coinsOld->vout[j], coinsOld->nHeight, coinsOld->fCoinBase);
+                }
+            }
+        }
+
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
 
+        if (pstats) {
+            BOOST_FOREACH(const uint256 &txid, setSpentTxids) {
+                if (!view.HaveCoins(txid))
+                    pstats->nTransactions--;
+            }
+            const CCoins *coins = view.AccessCoins(txHash);
+            if (coins && !coins->IsPruned()) {
+                pstats->nTransactions++;
+                for (unsigned int j = 0; j < coins->vout.size(); j++) {
+                    if (coins->IsAvailable(j))
+                        pstats->AddCoin(COutPoint(txHash, j), coins->vout[j], pindex->nHeight, tx.IsCoinBase());
+                }
+            }
+        }
+
         vPos.push_back(std::make_pair(tx.GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
 
@@ -3046,25 +3131,6 @@ bool ConnectBlock(const CBlock &block, CValidationState &state, CBlockIndex *pin
     if (fTxIndex)
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
-    if (fAddressIndex) {
-        if (!pblocktree->WriteAddressIndex(dbIndexHelper.getAddressIndex()))
-            return AbortNode(state, "Failed to write address index");
-
-        if (!pblocktree->UpdateAddressUnspentIndex(dbIndexHelper.getAddressUnspentIndex()))
-            return AbortNode(state, "Failed to write address unspent index");
-
-        if (!pblocktree->AddTotalSupply(block.vtx[0].GetValueOut() - nFees))
-            return AbortNode(state, "Failed to write total supply");
-    }
-
-    if (fSpentIndex)
-        if (!pblocktree->UpdateSpentIndex(dbIndexHelper.getSpentIndex()))
-            return AbortNode(state, "Failed to write transaction index");
-
-
-    if (fTimestampIndex)
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -3164,8 +3230,11 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
             nLastSetChain = nNow;
         }
         size_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        // With -writebehind, flushes that are not due yet are put off while the last batch is still being
+        // written, rather than waiting for it. The batch has its own share of -dbcache.
+        bool fWriteBehindBusy = mode == FLUSH_STATE_PERIODIC && pcoinswritebehind && pcoinswritebehind->IsWriting();
         // The cache is large and close to the limit, but we have time now (not in the middle of a block processing).
-        bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize * (10.0 / 9) > nCoinCacheUsage;
+        bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && !fWriteBehindBusy && cacheSize * (10.0 / 9) > nCoinCacheUsage;
         // The cache is over the limit, we have to write now.
         bool fCacheCritical = mode == FLUSH_STATE_IF_NEEDED && cacheSize > nCoinCacheUsage;
         // It's been a while since we wrote the block index to disk. Do this frequently, so we don't need to redownload after a crash.
@@ -3173,7 +3242,7 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
                 mode == FLUSH_STATE_PERIODIC && nNow > nLastWrite + (int64_t) DATABASE_WRITE_INTERVAL * 1000000;
         // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
         bool fPeriodicFlush =
-                mode == FLUSH_STATE_PERIODIC && nNow > nLastFlush + (int64_t) DATABASE_FLUSH_INTERVAL * 1000000;
+                mode == FLUSH_STATE_PERIODIC && !fWriteBehindBusy && nNow > nLastFlush + (int64_t) DATABASE_FLUSH_INTERVAL * 1000000;
         // Combine all conditions that result in a full cache flush.
         bool fDoFullFlush =
                 (mode == FLUSH_STATE_ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
@@ -3219,6 +3288,16 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            // With -writebehind the write happens in the background, except when the
+            // state has to be on disk on return or the blocks behind it are being pruned
+            if ((mode == FLUSH_STATE_ALWAYS || fFlushForPrune) && pcoinswritebehind && !pcoinswritebehind->Sync())
+                return AbortNode(state, "Failed to write to coin database");
+            // The statistics name the block they belong to, so a crash between the
+            // two writes leaves them unused rather than wrong
+            CUTXOStats utxoStats;
+            uint256 hashUTXOStats;
+            if (utxoStatsTracker.Get(utxoStats, hashUTXOStats) && !pcoinsdbview->WriteUTXOStats(hashUTXOStats, utxoStats))
+                return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
         }
         if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) &&
@@ -3331,9 +3410,11 @@ bool static DisconnectTip(CValidationState &state, const CChainParams &chainpara
     int64_t nStart = GetTimeMicros();
     {
         CCoinsViewCache view(pcoinsTip);
-        if (!DisconnectBlock(block, state, pindexDelete, view))
+        CUTXOStats delta;
+        if (!DisconnectBlock(block, state, pindexDelete, view, NULL, &delta))
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         assert(view.Flush());
+        utxoStatsTracker.Apply(delta, pindexDelete->pprev->GetBlockHash());
     }
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
 
@@ -3454,7 +3535,8 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
 //    LogPrintf("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
     {
         CCoinsViewCache view(pcoinsTip);
-        bool rv = ConnectBlock(*pblock, state, pindexNew, view, chainparams);
+        CUTXOStats delta;
+        bool rv = ConnectBlock(*pblock, state, pindexNew, view, chainparams, false, &delta);
         GetMainSignals().BlockChecked(*pblock, state);
         if (!rv) {
             if (state.IsInvalid())
@@ -3467,6 +3549,7 @@ ConnectTip(CValidationState &state, const CChainParams &chainparams, CBlockIndex
         LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001,
                  nTimeConnectTotal * 0.000001);
         assert(view.Flush());
+        utxoStatsTracker.Apply(delta, pindexNew->GetBlockHash());
     }
     int64_t nTime4 = GetTimeMicros();
     nTimeFlush += nTime4 - nTime3;
@@ -4049,8 +4132,7 @@ CBlockIndex *AddToBlockIndex(const CBlockHeader &block) {
         return it->second;
 
     // Construct new block index object
-    CBlockIndex *pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex *pindexNew = blockIndexArena.Allocate(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -4211,8 +4293,21 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
     return true;
 }
 
+namespace {
+    /** Blocks whose proof of work the reindex scanners have checked already */
+    CCriticalSection cs_preverifiedPoW;
+    std::set<uint256> setPreverifiedPoW;
+
+    bool IsPoWPreverified(const CBlockHeader &block) {
+        LOCK(cs_preverifiedPoW);
+        return !setPreverifiedPoW.empty() && setPreverifiedPoW.count(block.GetHash()) > 0;
+    }
+}
+
 //btzc: code from vertcoin, add
 bool CheckBlockHeader(const CBlockHeader &block, CValidationState &state, const Consensus::Params &consensusParams, bool fCheckPOW) {
+    if (!fCheckPOW || IsPoWPreverified(block))
+        return true;
     int nHeight = ZerocoinGetNHeight(block);
     if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams)) {
         //Maybe cache is not valid
@@ -4225,7 +4320,7 @@ bool CheckBlockHeader(const CBlockHeader &block, CValidationState &state, const
 
 bool CheckBlock(const CBlock &block, CValidationState &state,
                 const Consensus::Params &consensusParams, bool fCheckPOW,
-                bool fCheckMerkleRoot, int nHeight, bool isVerifyDB) {
+                bool fCheckMerkleRoot, int nHeight, bool isVerifyDB, const CBlockCheckSnapshot *psnapshot) {
     // CheckBlock not only checks the block, but also fills up zerocoinTxInfo and sigmaTxInfo.
     if (!block.zerocoinTxInfo)
         block.zerocoinTxInfo = std::make_shared<CZerocoinTxInfo>();
@@ -4290,7 +4385,8 @@ bool CheckBlock(const CBlock &block, CValidationState &state,
         }
 
         // DASH : CHECK TRANSACTIONS FOR INSTANTSEND
-        if(true) {
+        // Blocks of the active chain checked again by VerifyDB are not judged by current locks
+        if(!isVerifyDB) {
             // We should never accept block which conflicts with completed transaction lock,
             // that's why this is in CheckBlock unlike coinbase payee/amount.
             // Require other nodes to comply, send them some data in case they are missing it.
@@ -4314,21 +4410,19 @@ bool CheckBlock(const CBlock &block, CValidationState &state,
                     }
                 }
             }
-        } else {
-            LogPrintf("CheckBlock(BZX): spork is off, skipping transaction locking checks\n");
         }
 
         // Check transactions
         if (nHeight == INT_MAX)
             nHeight = ZerocoinGetNHeight(block.GetBlockHeader());
 
-        if (!CheckZerocoinFoundersInputs(block.vtx[0], state, Params().GetConsensus(), nHeight)) {
+        if (!CheckZerocoinFoundersInputs(block.vtx[0], state, Params().GetConsensus(), nHeight, psnapshot)) {
             return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(), "Founders' reward check failed");
         }
 
         BOOST_FOREACH(const CTransaction &tx, block.vtx) {
             // We don't check transactions against zerocoin state here, we'll check it again later in ConnectBlock
-            if (!CheckTransaction(tx, state, tx.GetHash(), isVerifyDB, nHeight, false, false, NULL, NULL)) {
+            if (!CheckTransaction(tx, state, tx.GetHash(), isVerifyDB, nHeight, false, false, NULL, NULL, psnapshot)) {
                 LogPrintf("block=%s\n", block.ToString());
                 return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
                                  strprintf("Transaction check failed (tx hash %s) %s", tx.GetHash().ToString(),
@@ -4839,6 +4933,7 @@ void PruneOneBlockFile(const int fileNumber) {
 void UnlinkPrunedFiles(std::set<int> &setFilesToPrune) {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockFileReader.Forget(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -4946,19 +5041,22 @@ CBlockIndex *InsertBlockIndex(uint256 hash) {
         return (*mi).second;
 
     // Create new
-    CBlockIndex *pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error(std::string(__func__) + ": new CBlockIndex failed");
+    CBlockIndex *pindexNew = blockIndexArena.Allocate();
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
+void ReserveBlockIndex(size_t nCount) {
+    mapBlockIndex.reserve(mapBlockIndex.size() + nCount);
+    blockIndexArena.Reserve(nCount);
+}
+
 bool static LoadBlockIndexDB() {
     LogPrintf("LoadBlockIndexDB\n");
     const CChainParams &chainparams = Params();
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
+    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, ReserveBlockIndex))
         return false;
 
     boost::this_thread::interruption_point();
@@ -5054,18 +5152,6 @@ bool static LoadBlockIndexDB() {
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
 
-    // Check whether we have an address index
-    pblocktree->ReadFlag("addressindex", fAddressIndex);
-    LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
-
-    // Check whether we have a timestamp index
-    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
-    LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
-
-    // Check whether we have a spent index
-    pblocktree->ReadFlag("spentindex", fSpentIndex);
-    LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
-
 
     // Load pointer to end of best chain
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
@@ -5102,28 +5188,158 @@ CVerifyDB::~CVerifyDB() {
     uiInterface.ShowProgress("", 100);
 }
 
+namespace {
+
+/** A block of the active chain to be checked by VerifyDB, as it was when the checks started */
+struct CVerifyTarget {
+    CBlockIndex *pindex;
+    int nHeight;
+    uint256 hash;
+    uint256 hashPrev;
+    CDiskBlockPos pos;
+    CDiskBlockPos undoPos;
+};
+
+/** Outcome of the context-free checks of a target */
+struct CVerifyResult {
+    CBlock block;
+    bool fValid;
+    bool fReadFailed;
+};
+
+/** Check levels 0-2 of a target: read the block with its proof of work, check it, read its undo data */
+void CheckVerifyTarget(const Consensus::Params &consensusParams, const CVerifyTarget &target, int nCheckLevel,
+                       const CBlockCheckSnapshot &snapshot, CVerifyResult &result) {
+    result.fValid = false;
+    result.fReadFailed = false;
+
+    // check level 0: read from disk
+    if (!ReadBlockFromDisk(result.block, target.pos, target.nHeight, consensusParams) ||
+        result.block.GetHash() != target.hash) {
+        result.fReadFailed = true;
+        error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", target.nHeight, target.hash.ToString());
+        return;
+    }
+    // check level 1: verify block validity, the proof of work was checked by the read
+    CValidationState state;
+    if (nCheckLevel >= 1 &&
+        !CheckBlock(result.block, state, consensusParams, false, true, target.nHeight, true, &snapshot)) {
+        error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
+              target.nHeight, target.hash.ToString(), FormatStateMessage(state));
+        return;
+    }
+    // check level 2: verify undo validity
+    if (nCheckLevel >= 2 && !target.undoPos.IsNull()) {
+        CBlockUndo undo;
+        if (!UndoReadFromDisk(undo, target.undoPos, target.hashPrev)) {
+            error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", target.nHeight, target.hash.ToString());
+            return;
+        }
+    }
+    result.fValid = true;
+}
+
+} // anon namespace
+
 bool CVerifyDB::VerifyDB(const CChainParams &chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth) {
-    LOCK(cs_main);
-    if (chainActive.Tip() == NULL || chainActive.Tip()->pprev == NULL)
-        return true;
+    const Consensus::Params &consensusParams = chainparams.GetConsensus();
+
+    // Take the blocks to check from the active chain; cs_main is only held for
+    // the ordered checks from here on, so the node keeps running meanwhile
+    CBlockIndex *pindexTip;
+    std::vector<CVerifyTarget> vTargets;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+        if (pindexTip == NULL || pindexTip->pprev == NULL)
+            return true;
+
+        // Verify blocks in the best chain
+        if (nCheckDepth <= 0)
+            nCheckDepth = 1000000000; // suffices until the year 19000
+        if (nCheckDepth > chainActive.Height())
+            nCheckDepth = chainActive.Height();
+        nCheckLevel = std::max(0, std::min(4, nCheckLevel));
+        for (CBlockIndex *pindex = pindexTip; pindex && pindex->pprev; pindex = pindex->pprev) {
+            if (pindex->nHeight < chainActive.Height() - nCheckDepth)
+                break;
+            if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+                // If pruning, only go back as far as we have data.
+                LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+                break;
+            }
+            CVerifyTarget target;
+            target.pindex = pindex;
+            target.nHeight = pindex->nHeight;
+            target.hash = pindex->GetBlockHash();
+            target.hashPrev = pindex->pprev->GetBlockHash();
+            target.pos = pindex->GetBlockPos();
+            target.undoPos = pindex->GetUndoPos();
+            vTargets.push_back(target);
+        }
+    }
+
+    // Levels 0-2 do not depend on each other, so workers run them ahead of
+    // the ordered checks by at most nWindow blocks
+    const int nWorkers = std::max(GetNumCores(), 1);
+    const size_t nWindow = 2 * nWorkers;
 
-    // Verify blocks in the best chain
-    if (nCheckDepth <= 0)
-        nCheckDepth = 1000000000; // suffices until the year 19000
-    if (nCheckDepth > chainActive.Height())
-        nCheckDepth = chainActive.Height();
-    nCheckLevel = std::max(0, std::min(4, nCheckLevel));
-    LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+    // The workers must not initialize the sigma parameters or read node state concurrently
+    sigma::Params::get_default();
+    const CBlockCheckSnapshot snapshot = GetBlockCheckSnapshot();
+    LogPrintf("Verifying last %i blocks at level %i with %d threads\n", nCheckDepth, nCheckLevel, nWorkers);
+
+    boost::mutex csVerify;
+    boost::condition_variable condVerify;
+    std::map<size_t, std::shared_ptr<CVerifyResult> > mapResults;
+    size_t nNextCheck = 0;
+    size_t nNextOrdered = 0;
+
+    auto worker = [&]() {
+        while (true) {
+            size_t nTarget;
+            {
+                boost::unique_lock<boost::mutex> lock(csVerify);
+                while (nNextCheck < vTargets.size() && nNextCheck >= nNextOrdered + nWindow)
+                    condVerify.wait(lock);
+                if (nNextCheck >= vTargets.size())
+                    return;
+                nTarget = nNextCheck++;
+            }
+
+            std::shared_ptr<CVerifyResult> result = std::make_shared<CVerifyResult>();
+            CheckVerifyTarget(consensusParams, vTargets[nTarget], nCheckLevel, snapshot, *result);
+
+            {
+                boost::unique_lock<boost::mutex> lock(csVerify);
+                mapResults[nTarget] = result;
+            }
+            condVerify.notify_all();
+        }
+    };
+
+    struct CWorkers {
+        boost::thread_group threads;
+        ~CWorkers() {
+            threads.interrupt_all();
+            threads.join_all();
+        }
+    } workers;
+    for (int i = 0; i < nWorkers; i++)
+        workers.threads.create_thread(worker);
+
+    // The stateful checks run in chain order and stop if the tip moves under them
+    bool fStateful = nCheckLevel >= 3;
     CCoinsViewCache coins(coinsview);
-    CBlockIndex *pindexState = chainActive.Tip();
+    CBlockIndex *pindexState = pindexTip;
     CBlockIndex *pindexFailure = NULL;
     int nGoodTransactions = 0;
     CValidationState state;
     int reportDone = 0;
     LogPrintf("[0%]...");
-    for (CBlockIndex *pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
-        boost::this_thread::interruption_point();
-        int percentageDone = std::max(1, std::min(99, (int) (((double) (chainActive.Height() - pindex->nHeight)) /
+    for (size_t i = 0; i < vTargets.size(); i++) {
+        const CVerifyTarget &target = vTargets[i];
+        int percentageDone = std::max(1, std::min(99, (int) (((double) (pindexTip->nHeight - target.nHeight)) /
                                                              (double) nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
         if (reportDone < percentageDone / 10) {
             // report every 10% step
@@ -5131,47 +5347,47 @@ bool CVerifyDB::VerifyDB(const CChainParams &chainparams, CCoinsView *coinsview,
             reportDone = percentageDone / 10;
         }
         uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone);
-        if (pindex->nHeight < chainActive.Height() - nCheckDepth)
-            break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
-            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
-            break;
+
+        std::shared_ptr<CVerifyResult> result;
+        {
+            boost::unique_lock<boost::mutex> lock(csVerify);
+            while (mapResults.count(i) == 0)
+                condVerify.wait(lock);
+            result = mapResults[i];
+            mapResults.erase(i);
+            nNextOrdered = i + 1;
         }
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight,
-                         pindex->GetBlockHash().ToString());
-        LogPrintf("VerifyDB->CheckBlock() nHeight=%s\n", pindex->nHeight);
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 &&
-            !CheckBlock(block, state, chainparams.GetConsensus(), true, true, pindex->nHeight, true))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
-                         pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!UndoReadFromDisk(undo, pos, pindex->pprev->GetBlockHash()))
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight,
-                                 pindex->GetBlockHash().ToString());
+        condVerify.notify_all();
+
+        if (!result->fValid) {
+            if (result->fReadFailed) {
+                LOCK(cs_main);
+                if (!(target.pindex->nStatus & BLOCK_HAVE_DATA)) {
+                    LogPrintf("VerifyDB(): block verification stopping at height %d (pruned while verifying)\n", target.nHeight);
+                    break;
+                }
             }
+            return false;
         }
+
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState &&
-            (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            bool fClean = true;
-            if (!DisconnectBlock(block, state, pindex, coins, &fClean))
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s",
-                             pindex->nHeight, pindex->GetBlockHash().ToString());
-            pindexState = pindex->pprev;
-            if (!fClean) {
-                nGoodTransactions = 0;
-                pindexFailure = pindex;
-            } else
-                nGoodTransactions += block.vtx.size();
+        if (fStateful && target.pindex == pindexState) {
+            LOCK(cs_main);
+            if (chainActive.Tip() != pindexTip) {
+                LogPrintf("VerifyDB(): the chain tip moved at height %d, skipping checks above level 2\n", target.nHeight);
+                fStateful = false;
+            } else if ((coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
+                bool fClean = true;
+                if (!DisconnectBlock(result->block, state, target.pindex, coins, &fClean))
+                    return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s",
+                                 target.nHeight, target.hash.ToString());
+                pindexState = target.pindex->pprev;
+                if (!fClean) {
+                    nGoodTransactions = 0;
+                    pindexFailure = target.pindex;
+                } else
+                    nGoodTransactions += result->block.vtx.size();
+            }
         }
         if (ShutdownRequested())
             return true;
@@ -5179,18 +5395,23 @@ bool CVerifyDB::VerifyDB(const CChainParams &chainparams, CCoinsView *coinsview,
     if (pindexFailure)
         return error(
                 "VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n",
-                chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
+                pindexTip->nHeight - pindexFailure->nHeight + 1, nGoodTransactions);
 
     // check level 4: try reconnecting blocks
-    if (nCheckLevel >= 4) {
+    if (nCheckLevel >= 4 && fStateful) {
         CBlockIndex *pindex = pindexState;
-        while (pindex != chainActive.Tip()) {
+        while (pindex != pindexTip) {
             boost::this_thread::interruption_point();
             uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int) (((double) (
-                    chainActive.Height() - pindex->nHeight)) / (double) nCheckDepth * 50))));
+                    pindexTip->nHeight - pindex->nHeight)) / (double) nCheckDepth * 50))));
+            LOCK(cs_main);
+            if (chainActive.Tip() != pindexTip) {
+                LogPrintf("VerifyDB(): the chain tip moved at height %d, skipping checks of level 4\n", pindex->nHeight);
+                break;
+            }
             pindex = chainActive.Next(pindex);
             CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            if (!ReadBlockFromDisk(block, pindex, consensusParams))
                 return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight,
                              pindex->GetBlockHash().ToString());
             if (!ConnectBlock(block, state, pindex, coins, chainparams))
@@ -5201,11 +5422,64 @@ bool CVerifyDB::VerifyDB(const CChainParams &chainparams, CCoinsView *coinsview,
 
     LogPrintf("[DONE].\n");
     LogPrintf("No coin database inconsistencies in last %i blocks (%i transactions)\n",
-              chainActive.Height() - pindexState->nHeight, nGoodTransactions);
+              pindexTip->nHeight - pindexState->nHeight, nGoodTransactions);
+
+    return true;
+}
 
+bool LoadUTXOStats() {
+    LOCK(cs_main);
+    uint256 hashBest = pcoinsTip->GetBestBlock();
+    if (hashBest.IsNull()) {
+        // Empty chainstate, as after a reindex
+        utxoStatsTracker.Reset(CUTXOStats(), hashBest);
+        return true;
+    }
+    CUTXOStats stats;
+    uint256 hashStats;
+    if (!pcoinsdbview->ReadUTXOStats(hashStats, stats) || hashStats != hashBest)
+        return false;
+    utxoStatsTracker.Reset(stats, hashBest);
     return true;
 }
 
+void ThreadRebuildUTXOStats() {
+    int64_t nStart = GetTimeMillis();
+    boost::scoped_ptr<CCoinsViewCursor> pcursor;
+    {
+        LOCK(cs_main);
+        // The cursor sees the database as it is when created, so bring it up to the tip first
+        FlushStateToDisk();
+        pcursor.reset(pcoinsTip->Cursor());
+        if (!pcursor) {
+            LogPrintf("%s: the chainstate cannot be walked, no UTXO set statistics\n", __func__);
+            return;
+        }
+        utxoStatsTracker.StartRebuild(pcursor->GetBestBlock());
+    }
+    LogPrintf("Computing UTXO set statistics at %s\n", pcursor->GetBestBlock().ToString());
+
+    CUTXOStats stats;
+    if (!ComputeUTXOStats(pcursor.get(), stats))
+        return;
+
+    LOCK(cs_main);
+    utxoStatsTracker.FinishRebuild(stats);
+    LogPrintf("Computed UTXO set statistics of %d outputs in %dms\n", stats.nTransactionOutputs, GetTimeMillis() - nStart);
+}
+
+void ThreadVerifyDB(int nCheckLevel, int nCheckDepth) {
+    int64_t nStart = GetTimeMillis();
+    nCheckLevel = std::min(nCheckLevel, 3);
+    LogPrintf("Verifying blocks in the background\n");
+    if (!CVerifyDB().VerifyDB(Params(), pcoinsTip, nCheckLevel, nCheckDepth)) {
+        strMiscWarning = _("Warning: Corrupted block database detected, restart with -reindex to rebuild it");
+        AlertNotify(strMiscWarning);
+        return;
+    }
+    LogPrintf("Verified blocks in the background in %dms\n", GetTimeMillis() - nStart);
+}
+
 bool RewindBlockIndex(const CChainParams &params) {
     LOCK(cs_main);
 
@@ -5321,11 +5595,8 @@ void UnloadBlockIndex() {
         warningcache[b].clear();
     }
 
-    BOOST_FOREACH(BlockMap::value_type & entry, mapBlockIndex)
-    {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 }
 
@@ -5350,17 +5621,6 @@ bool InitBlockIndex(const CChainParams &chainparams) {
     fTxIndex = GetBoolArg("-txindex", DEFAULT_TXINDEX);
     pblocktree->WriteFlag("txindex", fTxIndex);
 
-    // Use the provided setting for -timestampindex in the new database
-    fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-    pblocktree->WriteFlag("timestampindex", fTimestampIndex);
-
-    // Use the provided setting for -addressindex in the new database
-    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
-    pblocktree->WriteFlag("addressindex", fAddressIndex);
-
-    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
-    pblocktree->WriteFlag("spentindex", fSpentIndex);
-
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -5519,6 +5779,274 @@ bool LoadExternalBlockFile(const CChainParams &chainparams, FILE *fileIn, CDiskB
     return nLoaded > 0;
 }
 
+namespace {
+
+/** A block record found in a blk file by the reindex scanners */
+struct CScannedBlock {
+    CDiskBlockPos pos;
+    uint256 hash;
+    uint256 hashPrevBlock;
+    bool fValidPoW;
+};
+
+/**
+ * Find the block records of a blk file the way LoadExternalBlockFile does, and
+ * check the proof of work of their headers. Every block but the genesis block
+ * is at least at height HF_ALGO, so the PoW algorithm is known without the parent.
+ */
+void ScanBlockFile(const CChainParams &chainparams, int nFile, std::vector<CScannedBlock> &vBlocks) {
+    boost::filesystem::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+
+    std::shared_ptr<const CMappedBlockFile> mapping = CMappedBlockFile::Open(path);
+    std::vector<char> vData;
+    const char *pdata = NULL;
+    size_t nDataSize = 0;
+    if (mapping) {
+        pdata = mapping->Data();
+        nDataSize = mapping->Size();
+    } else {
+        CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            LogPrintf("%s: unable to open %s\n", __func__, path.string());
+            return;
+        }
+        vData.resize(boost::filesystem::file_size(path));
+        if (fread(vData.data(), 1, vData.size(), filein.Get()) != vData.size()) {
+            LogPrintf("%s: unable to read %s\n", __func__, path.string());
+            return;
+        }
+        pdata = vData.data();
+        nDataSize = vData.size();
+    }
+
+    const Consensus::Params &consensusParams = chainparams.GetConsensus();
+    const unsigned char *pchMessageStart = chainparams.MessageStart();
+    size_t nPos = 0;
+    while (nPos < nDataSize) {
+        boost::this_thread::interruption_point();
+
+        // locate a header
+        const char *pfound = (const char *) memchr(pdata + nPos, pchMessageStart[0], nDataSize - nPos);
+        if (!pfound)
+            break;
+        size_t nRecord = pfound - pdata;
+        if (nRecord + MESSAGE_START_SIZE + sizeof(uint32_t) > nDataSize)
+            break;
+        nPos = nRecord + 1;
+        if (memcmp(pfound, pchMessageStart, MESSAGE_START_SIZE))
+            continue;
+        // read size
+        unsigned int nSize = ReadLE32((const unsigned char *) pfound + MESSAGE_START_SIZE);
+        size_t nBlockPos = nRecord + MESSAGE_START_SIZE + sizeof(uint32_t);
+        if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE || nBlockPos + nSize > nDataSize)
+            continue;
+
+        CBlockHeader header;
+        try {
+            CMemoryReader reader(pdata + nBlockPos, pdata + nBlockPos + nSize, SER_DISK, CLIENT_VERSION);
+            reader >> header;
+        } catch (const std::exception &e) {
+            LogPrintf("%s: Deserialize error in blk%05u.dat - %s\n", __func__, (unsigned int) nFile, e.what());
+            continue;
+        }
+
+        CScannedBlock scanned;
+        scanned.pos = CDiskBlockPos(nFile, nBlockPos);
+        scanned.hash = header.GetHash();
+        scanned.hashPrevBlock = header.hashPrevBlock;
+        int nHeight = scanned.hash == consensusParams.hashGenesisBlock ? 0 : HF_ALGO;
+        scanned.fValidPoW = CheckProofOfWork(header.GetPoWHash(nHeight), header.nBits, consensusParams);
+        vBlocks.push_back(scanned);
+
+        nPos = nBlockPos + nSize;
+    }
+}
+
+/** Accept a scanned block and the out of order children waiting for it. Returns false to stop reading its file. */
+bool ImportScannedBlock(const CChainParams &chainparams, const CScannedBlock &scanned,
+                        std::multimap<uint256, CDiskBlockPos> &mapBlocksUnknownParent, int &nLoaded) {
+    const Consensus::Params &consensusParams = chainparams.GetConsensus();
+    const uint256 &hash = scanned.hash;
+
+    bool fKnown;
+    {
+        LOCK(cs_main);
+        // detect out of order blocks, and store them for later
+        if (hash != consensusParams.hashGenesisBlock && mapBlockIndex.count(scanned.hashPrevBlock) == 0) {
+            mapBlocksUnknownParent.insert(std::make_pair(scanned.hashPrevBlock, scanned.pos));
+            return true;
+        }
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        fKnown = mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA);
+        if (fKnown && hash != consensusParams.hashGenesisBlock && mi->second->nHeight % 1000 == 0)
+            LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mi->second->nHeight);
+    }
+
+    CBlock block;
+    // process in case the block isn't known yet; AcceptBlock checks the proof of work
+    if (!fKnown) {
+        CDiskBlockPos pos = scanned.pos;
+        if (!ReadBlockFromDisk(block, pos, 0, consensusParams, false))
+            return true;
+
+        LOCK(cs_main);
+        CValidationState state;
+        if (AcceptBlock(block, state, chainparams, NULL, true, &pos, NULL)) {
+            nLoaded++;
+            if (!ActivateBestChain(state, chainparams, &block))
+                return false;
+        }
+        if (state.IsError()) {
+            LogPrintf("error=%s\n", state.GetDebugMessage());
+            return false;
+        }
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == consensusParams.hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams))
+            return false;
+    }
+
+    NotifyHeaderTip();
+    // Recursively process earlier encountered successors of this block
+    deque <uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair <std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(
+                head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            if (ReadBlockFromDisk(block, it->second, 0, consensusParams, false)) {
+                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__,
+                         block.GetHash().ToString(), head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (AcceptBlock(block, dummy, chainparams, NULL, true, &it->second, NULL)) {
+                    nLoaded++;
+                    queue.push_back(block.GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
+} // anon namespace
+
+bool ReindexBlockFiles(const CChainParams &chainparams) {
+    int64_t nStart = GetTimeMillis();
+
+    // Scanners run ahead of the connect stage by at most nWindow files
+    const int nScanners = std::max(GetNumCores(), 1);
+    const int nWindow = 2 * nScanners;
+
+    boost::mutex csScan;
+    boost::condition_variable condScan;
+    std::map<int, std::vector<CScannedBlock> > mapScanned;
+    int nNextScan = 0;
+    int nNextConnect = 0;
+    int nEndFile = std::numeric_limits<int>::max();
+
+    auto scanner = [&]() {
+        while (true) {
+            int nFile;
+            {
+                boost::unique_lock<boost::mutex> lock(csScan);
+                while (nNextScan < nEndFile && nNextScan >= nNextConnect + nWindow)
+                    condScan.wait(lock);
+                if (nNextScan >= nEndFile)
+                    return;
+                nFile = nNextScan++;
+            }
+
+            std::vector<CScannedBlock> vBlocks;
+            bool fExists = boost::filesystem::exists(GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"));
+            if (fExists)
+                ScanBlockFile(chainparams, nFile, vBlocks);
+
+            {
+                boost::unique_lock<boost::mutex> lock(csScan);
+                if (fExists)
+                    mapScanned[nFile].swap(vBlocks);
+                else
+                    nEndFile = std::min(nEndFile, nFile); // No block files left to reindex
+            }
+            condScan.notify_all();
+        }
+    };
+
+    boost::thread_group scannerThreads;
+    for (int i = 0; i < nScanners; i++)
+        scannerThreads.create_thread(scanner);
+
+    std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+    int nLoaded = 0;
+    try {
+        for (int nFile = 0; ; nFile++) {
+            std::vector<CScannedBlock> vBlocks;
+            {
+                boost::unique_lock<boost::mutex> lock(csScan);
+                while (nFile < nEndFile && mapScanned.count(nFile) == 0)
+                    condScan.wait(lock);
+                if (nFile >= nEndFile)
+                    break;
+                mapScanned[nFile].swap(vBlocks);
+                mapScanned.erase(nFile);
+                nNextConnect = nFile + 1;
+            }
+            condScan.notify_all();
+
+            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int) nFile);
+            {
+                LOCK(cs_preverifiedPoW);
+                for (const CScannedBlock &scanned : vBlocks)
+                    if (scanned.fValidPoW)
+                        setPreverifiedPoW.insert(scanned.hash);
+            }
+
+            for (const CScannedBlock &scanned : vBlocks) {
+                boost::this_thread::interruption_point();
+                try {
+                    if (!ImportScannedBlock(chainparams, scanned, mapBlocksUnknownParent, nLoaded))
+                        break;
+                } catch (const std::exception &e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                }
+            }
+
+            // Keep the checked headers of blocks still waiting for their parent only
+            LOCK2(cs_main, cs_preverifiedPoW);
+            for (const CScannedBlock &scanned : vBlocks) {
+                BlockMap::iterator mi = mapBlockIndex.find(scanned.hash);
+                if (mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA))
+                    setPreverifiedPoW.erase(scanned.hash);
+            }
+        }
+    } catch (...) {
+        scannerThreads.interrupt_all();
+        scannerThreads.join_all();
+        LOCK(cs_preverifiedPoW);
+        setPreverifiedPoW.clear();
+        throw;
+    }
+
+    scannerThreads.join_all();
+    {
+        LOCK(cs_preverifiedPoW);
+        setPreverifiedPoW.clear();
+    }
+
+    LogPrintf("Reindexed %i blocks with %d scanner threads in %dms\n", nLoaded, nScanners, GetTimeMillis() - nStart);
+    return nLoaded > 0;
+}
+
 void static CheckBlockIndex(const Consensus::Params &consensusParams) {
     if (!fCheckBlockIndex) {
         return;
@@ -8412,10 +8940,8 @@ public:
 
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
 
         // orphan transactions
         mapOrphanTransactions.clear();
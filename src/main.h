@@ -37,13 +37,18 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CBloomFilter;
 class CChainParams;
+class CCoinsViewDB;
+class CCoinsViewWriteBehind;
 class CInv;
 class CScriptCheck;
 class CTxMemPool;
 class CValidationInterface;
 class CValidationState;
+class CUTXOStats;
+class CUTXOStatsTracker;
 
 struct PrecomputedTransactionData;
 struct CNodeStateStats;
@@ -187,6 +192,9 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
+extern bool fTimestampIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
@@ -224,6 +232,8 @@ static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
 
 static const signed int DEFAULT_CHECKBLOCKS = 6;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+/** Whether to check the -checkblocks blocks after startup rather than before it */
+static const bool DEFAULT_BACKGROUND_VERIFY = false;
 
 // Require that user allocate at least 550MB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 288 blocks = 288MB.
@@ -263,6 +273,8 @@ FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = NULL);
+/** Rebuild the block index from the blk files, checking proof of work on a pool of scanner threads */
+bool ReindexBlockFiles(const CChainParams& chainparams);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk */
@@ -319,6 +331,8 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune);
 
 /** Create a new block index entry for a given block hash */
 CBlockIndex * InsertBlockIndex(uint256 hash);
+/** Make room for nCount more block index entries, stored next to each other */
+void ReserveBlockIndex(size_t nCount);
 /** Abort with a message */
 bool AbortNode(const std::string &strMessage, const std::string &userMessage);
 /* Sends out an alert */
@@ -396,9 +410,25 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
 
+/**
+ * Node state the block and transaction checks read besides the block itself: sporks, bznode sync and the
+ * sigma surge flag. None of it may be read off the main threads, so checks running on worker threads get
+ * a snapshot taken beforehand. Without one the checks read the current state.
+ */
+struct CBlockCheckSnapshot
+{
+    bool fBlockchainSynced;
+    bool fSigmaSporkActive;
+    bool fSigmaSurgeCondition;
+    bool fFoundersEnforced;
+};
+
+/** The current state for checks that run on worker threads */
+CBlockCheckSnapshot GetBlockCheckSnapshot();
+
 /** Context-independent validity checks */
 //BTZC: ADD params for BitcoinZero works
-bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, int nHeight = INT_MAX, bool isCheckWallet = false, bool fStatefulZerocoinCheck = true, CZerocoinTxInfo *zerocoinTxInfo = NULL, sigma::CSigmaTxInfo *sigmaTxInfo = NULL);
+bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, int nHeight = INT_MAX, bool isCheckWallet = false, bool fStatefulZerocoinCheck = true, CZerocoinTxInfo *zerocoinTxInfo = NULL, sigma::CSigmaTxInfo *sigmaTxInfo = NULL, const CBlockCheckSnapshot *psnapshot = NULL);
 /**
  * Check if transaction is final and can be included in a block with the
  * specified height and time. Consensus critical.
@@ -492,19 +522,26 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint160 addressHash, AddressType type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                      int start = 0, int end = 0);
+/** Streams the address index entries of an address at heights start..end (0 for no bound) */
+bool ForEachAddressIndex(uint160 addressHash, AddressType type, int start, int end,
+                         const AddressIndexVisitor &visitor);
+bool GetAddressBalance(uint160 addressHash, AddressType type, CAddressBalanceValue &value);
 bool GetAddressUnspent(uint160 addressHash, AddressType type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams);
+/** Reads a block from disk. fCheckPOW can be unset for blocks which have already been validated. */
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams, bool fCheckPOW = true);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Reads the undo data of a block, checking it against the hash of the block's parent. */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true);
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, int nHeight = INT_MAX, bool isVerifyDB = false);
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, int nHeight = INT_MAX, bool isVerifyDB = false, const CBlockCheckSnapshot *psnapshot = NULL);
 
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx, CTransaction& tx);
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx);
@@ -520,13 +557,15 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins,
-                  const CChainParams& chainparams, bool fJustCheck = false);
+                  const CChainParams& chainparams, bool fJustCheck = false, CUTXOStats* pstats = NULL);
 
 /** Undo the effects of this block (with given index) on the UTXO set represented by coins.
  *  In case pfClean is provided, operation will try to be tolerant about errors, and *pfClean
  *  will be true if no problems were found. Otherwise, the return value will be false in case
- *  of problems. Note that in any case, coins may be modified. */
-bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& coins, bool* pfClean = NULL);
+ *  of problems. Note that in any case, coins may be modified.
+ *  Both add the changes they make to the UTXO set to *pstats when given. */
+bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockIndex* pindex, CCoinsViewCache& coins, bool* pfClean = NULL,
+                     CUTXOStats* pstats = NULL);
 
 /** Reprocess a number of blocks to try and get on the correct chain again **/
 bool DisconnectBlocks(int blocks);
@@ -553,7 +592,13 @@ void UpdateUncommittedBlockStructures(CBlock& block, const CBlockIndex* pindexPr
 /** Produce the necessary coinbase commitment for a block (modifies the hash, don't call for mined blocks). */
 std::vector<unsigned char> GenerateCoinbaseCommitment(CBlock& block, const CBlockIndex* pindexPrev, const Consensus::Params& consensusParams);
 
-/** RAII wrapper for VerifyDB: Verify consistency of the block and coin databases */
+/**
+ * RAII wrapper for VerifyDB: Verify consistency of the block and coin databases.
+ * Reading the blocks, their proof of work, the context-free checks and reading
+ * the undo data (levels 0-2) run on one thread per core. The disconnect and
+ * reconnect checks (levels 3-4) follow in chain order and take cs_main block by
+ * block, so VerifyDB can run while the node is up.
+ */
 class CVerifyDB {
 public:
     CVerifyDB();
@@ -561,6 +606,12 @@ public:
     bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
 };
 
+/**
+ * Run CVerifyDB on the active chain once the node is up; failures raise a warning instead of a reindex.
+ * Level 4 reconnects blocks and would change the sigma state of the running node, so it is limited to 3.
+ */
+void ThreadVerifyDB(int nCheckLevel, int nCheckDepth);
+
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
@@ -579,6 +630,20 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** The chainstate database below pcoinsTip */
+extern CCoinsViewDB *pcoinsdbview;
+
+/** Background writer of chainstate flushes below pcoinsTip, NULL unless -writebehind */
+extern CCoinsViewWriteBehind *pcoinswritebehind;
+
+/** Statistics of the UTXO set at pcoinsTip's best block (protected by cs_main) */
+extern CUTXOStatsTracker utxoStatsTracker;
+
+/** Take the UTXO set statistics stored with the chainstate, false if they are missing or stale */
+bool LoadUTXOStats();
+/** Compute the UTXO set statistics from a snapshot of the chainstate while the node runs */
+void ThreadRebuildUTXOStats();
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
@@ -208,8 +208,8 @@ void ExoAssetsDialog::PopulateBalances(unsigned int propertyId)
         bool propertyIsDivisible = isPropertyDivisible(propertyId); // only fetch the SP once, not for every address
 
         // iterate mp_tally_map looking for addresses that hold a balance in propertyId
-        for(std::unordered_map<string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-            const std::string& address = my_it->first;
+        for(TallyMap::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+            const CAddressKey& key = my_it->first;
             CMPTally& tally = my_it->second;
             tally.init();
 
@@ -224,7 +224,7 @@ void ExoAssetsDialog::PopulateBalances(unsigned int propertyId)
             if (!includeAddress) continue; //ignore this address, has never transacted in this propertyId
 
             // determine if this address is in the wallet
-            int addressIsMine = IsMyAddress(address);
+            int addressIsMine = IsMyAddress(key);
             if (!addressIsMine) continue; // ignore this address, not in wallet
             if (addressIsMine != ISMINE_SPENDABLE) watchAddress = true;
 
@@ -246,10 +246,11 @@ void ExoAssetsDialog::PopulateBalances(unsigned int propertyId)
             }
 
             // add the row
+            const std::string address = key.ToString();
             if (!watchAddress) {
-                AddRow(GetAddressLabel(my_it->first), address, reservedStr, availableStr);
+                AddRow(GetAddressLabel(address), address, reservedStr, availableStr);
             } else {
-                AddRow(GetAddressLabel(my_it->first), address + " (watch-only)", reservedStr, availableStr);
+                AddRow(GetAddressLabel(address), address + " (watch-only)", reservedStr, availableStr);
             }
         }
     }
@@ -137,14 +137,14 @@ void MetaDExDialog::PopulateAddresses()
         uint32_t propertyId = GetPropForSale();
         QString currentSetAddress = ui->comboAddress->currentText();
         ui->comboAddress->clear();
-        for (std::unordered_map<string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-            string address = (my_it->first).c_str();
+        for (TallyMap::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+            const CAddressKey& key = my_it->first;
             uint32_t id;
             (my_it->second).init();
             while (0 != (id = (my_it->second).next())) {
                 if (id == propertyId) {
-                    if (!getUserAvailableMPbalance(address, propertyId)) continue; // ignore this address, has no available balance to spend
-                    if (IsMyAddress(address)) ui->comboAddress->addItem((my_it->first).c_str()); // only include wallet addresses
+                    if (!getUserAvailableMPbalance(key, propertyId)) continue; // ignore this address, has no available balance to spend
+                    if (IsMyAddress(key)) ui->comboAddress->addItem(key.ToString().c_str()); // only include wallet addresses
                 }
             }
         }
@@ -186,8 +186,8 @@ void SendMPDialog::updateProperty()
     QString spId = ui->propertyComboBox->itemData(ui->propertyComboBox->currentIndex()).toString();
     uint32_t propertyId = spId.toUInt();
     LOCK(cs_tally);
-    for (std::unordered_map<string, CMPTally>::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
-        string address = (my_it->first).c_str();
+    for (TallyMap::iterator my_it = mp_tally_map.begin(); my_it != mp_tally_map.end(); ++my_it) {
+        const CAddressKey& key = my_it->first;
         uint32_t id = 0;
         bool includeAddress=false;
         (my_it->second).init();
@@ -195,9 +195,10 @@ void SendMPDialog::updateProperty()
             if(id == propertyId) { includeAddress=true; break; }
         }
         if (!includeAddress) continue; //ignore this address, has never transacted in this propertyId
-        if (IsMyAddress(address) != ISMINE_SPENDABLE) continue; // ignore this address, it's not spendable
-        if (!getUserAvailableMPbalance(address, propertyId)) continue; // ignore this address, has no available balance to spend
-        ui->sendFromComboBox->addItem(QString::fromStdString(address + " \t" + FormatMP(propertyId, getUserAvailableMPbalance(address, propertyId)) + getTokenLabel(propertyId)));
+        if (IsMyAddress(key) != ISMINE_SPENDABLE) continue; // ignore this address, it's not spendable
+        int64_t available = getUserAvailableMPbalance(key, propertyId);
+        if (!available) continue; // ignore this address, has no available balance to spend
+        ui->sendFromComboBox->addItem(QString::fromStdString(key.ToString() + " \t" + FormatMP(propertyId, available) + getTokenLabel(propertyId)));
     }
 
     // attempt to set from address back to cached value
@@ -8,7 +8,9 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "coins.h"
+#include "compressor.h"
 #include "consensus/validation.h"
+#include "dbwrapper.h"
 #include "main.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
@@ -18,12 +20,15 @@
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "utxostats.h"
 #include "hash.h"
 
 #include <stdint.h>
 
 #include <univalue.h>
 
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
 using namespace std;
@@ -681,97 +686,305 @@ UniValue getblock(const UniValue& params, bool fHelp)
     return blockToJSON(block, pblockindex);
 }
 
-struct CCoinsStats
+//! Size and hash of the serialized UTXO set, as gettxoutsetinfo reported them before the statistics were kept up to date
+static bool GetSerializedUTXOStats(CCoinsViewCursor *pcursor, uint64_t &nSerializedSize, uint256 &hashSerialized)
 {
-    int nHeight;
-    uint256 hashBlock;
-    uint64_t nTransactions;
-    uint64_t nTransactionOutputs;
-    uint64_t nSerializedSize;
-    uint256 hashSerialized;
-    CAmount nTotalAmount;
-
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
-};
-
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
-{
-    boost::scoped_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
-    }
-    ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
+    ss << pcursor->GetBestBlock();
+    nSerializedSize = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         uint256 key;
         CCoins coins;
         if (pcursor->GetKey(key) && pcursor->GetValue(coins)) {
-            stats.nTransactions++;
             ss << key;
             for (unsigned int i=0; i<coins.vout.size(); i++) {
                 const CTxOut &out = coins.vout[i];
                 if (!out.IsNull()) {
-                    stats.nTransactionOutputs++;
                     ss << VARINT(i+1);
                     ss << out;
-                    nTotalAmount += out.nValue;
                 }
             }
-            stats.nSerializedSize += 32 + pcursor->GetValueSize();
+            nSerializedSize += 32 + pcursor->GetValueSize();
             ss << VARINT(0);
         } else {
             return error("%s: unable to read value", __func__);
         }
         pcursor->Next();
     }
-    stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
+    hashSerialized = ss.GetHash();
     return true;
 }
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( include_serialized )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "The statistics are kept up to date as blocks are connected. After an upgrade they are\n"
+            "computed once in the background, and this call fails until that is done.\n"
+            "\nArguments:\n"
+            "1. include_serialized    (boolean, optional, default=false) Also walk the whole set to compute\n"
+            "                         bytes_serialized and hash_serialized. This may take some time.\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
-            "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
+            "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
+            "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
+            "  \"utxo_commitment\": \"hash\", (string) Hash of the multiset hash of the unspent outputs\n"
+            "  \"bytes_serialized\": n,  (numeric) The serialized size, only with include_serialized\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash, only with include_serialized\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "true")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    bool fSerialized = params.size() > 0 && params[0].get_bool();
+
+    CUTXOStats stats;
+    uint256 hashBlock;
+    int nHeight;
+    boost::scoped_ptr<CCoinsViewCursor> pcursor;
+    {
+        LOCK(cs_main);
+        if (fSerialized) {
+            // The cursor sees the database as it is when created, so bring it up to the tip first
+            FlushStateToDisk();
+            pcursor.reset(pcoinsTip->Cursor());
+            if (!pcursor)
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+
+        if (!utxoStatsTracker.Get(stats, hashBlock))
+            throw JSONRPCError(RPC_IN_WARMUP, "UTXO set statistics are still being computed");
+        if (pcursor && hashBlock != pcursor->GetBestBlock())
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "UTXO set statistics do not match the chainstate");
+        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+        nHeight = mi == mapBlockIndex.end() ? -1 : mi->second->nHeight;
+    }
+
     UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("height", (int64_t)nHeight));
+    ret.push_back(Pair("bestblock", hashBlock.GetHex()));
+    ret.push_back(Pair("transactions", stats.nTransactions));
+    ret.push_back(Pair("txouts", stats.nTransactionOutputs));
+    ret.push_back(Pair("bogosize", stats.nBogoSize));
+    ret.push_back(Pair("utxo_commitment", stats.GetCommitmentHash().GetHex()));
+    if (pcursor) {
+        uint64_t nSerializedSize;
+        uint256 hashSerialized;
+        if (!GetSerializedUTXOStats(pcursor.get(), nSerializedSize, hashSerialized))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        ret.push_back(Pair("bytes_serialized", (int64_t)nSerializedSize));
+        ret.push_back(Pair("hash_serialized", hashSerialized.GetHex()));
+    }
+    ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+    return ret;
+}
 
-    CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsTip, stats)) {
-        ret.push_back(Pair("height", (int64_t)stats.nHeight));
-        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
-        ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
-        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
-        ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
-        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
-        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
-    } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the unspent transaction output set at the current tip to a file.\n"
+            "The set is read from a snapshot of the chainstate, so the node keeps running meanwhile.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to write, relative to the data directory unless absolute.\n"
+            "               It must not exist yet.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"path\": \"path\",         (string) The file written\n"
+            "  \"base_hash\": \"hex\",     (string) The block the set belongs to\n"
+            "  \"base_height\": n,       (numeric) The height of that block\n"
+            "  \"transactions\": n,      (numeric) The number of transactions written\n"
+            "  \"txouts\": n,            (numeric) The number of unspent outputs written\n"
+            "  \"utxo_commitment\": \"hash\", (string) The commitment of gettxoutsetinfo for that block\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path(params[0].get_str());
+    if (!path.is_complete())
+        path = GetDataDir() / path;
+    if (boost::filesystem::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    boost::filesystem::path pathTmp = path.string() + ".incomplete";
+
+    CUTXOSnapshotHeader header;
+    boost::scoped_ptr<CCoinsViewCursor> pcursor;
+    {
+        LOCK(cs_main);
+        // The cursor sees the database as it is when created, so bring it up to the tip first
+        FlushStateToDisk();
+        pcursor.reset(pcoinsTip->Cursor());
+        if (!pcursor)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+
+        CUTXOStats stats;
+        if (!utxoStatsTracker.Get(stats, header.hashBlock))
+            throw JSONRPCError(RPC_IN_WARMUP, "UTXO set statistics are still being computed");
+        if (header.hashBlock != pcursor->GetBestBlock())
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "UTXO set statistics do not match the chainstate");
+        memcpy(header.pchMessageStart, Params().MessageStart(), sizeof(header.pchMessageStart));
+        header.nHeight = mapBlockIndex.find(header.hashBlock)->second->nHeight;
+        header.nTransactions = stats.nTransactions;
+        header.nTransactionOutputs = stats.nTransactionOutputs;
+        header.hashCommitment = stats.GetCommitmentHash();
+    }
+
+    CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to open " + pathTmp.string());
+
+    uint64_t nTransactions = 0;
+    uint64_t nTransactionOutputs = 0;
+    try {
+        fileout << header;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            uint256 txid;
+            CCoins coins;
+            if (!pcursor->GetKey(txid) || !pcursor->GetValue(coins))
+                throw std::runtime_error("unable to read UTXO set");
+            std::vector<uint32_t> vAvailable;
+            for (unsigned int i = 0; i < coins.vout.size(); i++) {
+                if (!coins.vout[i].IsNull())
+                    vAvailable.push_back(i);
+            }
+            if (!vAvailable.empty()) {
+                fileout << txid;
+                fileout << VARINT(vAvailable.size());
+                uint32_t nCode = coins.nHeight * 2 + (coins.fCoinBase ? 1 : 0);
+                BOOST_FOREACH(uint32_t n, vAvailable) {
+                    fileout << VARINT(n);
+                    fileout << VARINT(nCode);
+                    fileout << CTxOutCompressor(coins.vout[n]);
+                }
+                nTransactions++;
+                nTransactionOutputs += vAvailable.size();
+            }
+            pcursor->Next();
+        }
+    } catch (const std::exception& e) {
+        fileout.fclose();
+        boost::filesystem::remove(pathTmp);
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Unable to write %s: %s", pathTmp.string(), e.what()));
     }
+
+    if (nTransactions != header.nTransactions || nTransactionOutputs != header.nTransactionOutputs) {
+        fileout.fclose();
+        boost::filesystem::remove(pathTmp);
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "UTXO set does not match its statistics");
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+    boost::filesystem::rename(pathTmp, path);
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("base_hash", header.hashBlock.GetHex()));
+    ret.push_back(Pair("base_height", header.nHeight));
+    ret.push_back(Pair("transactions", nTransactions));
+    ret.push_back(Pair("txouts", nTransactionOutputs));
+    ret.push_back(Pair("utxo_commitment", header.hashCommitment.GetHex()));
+    return ret;
+}
+
+static UniValue DBStatsToJSON(const CDBStatsEntry& entry)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("name", entry.strName));
+
+    UniValue profile(UniValue::VOBJ);
+    profile.push_back(Pair("name", entry.profile.strName));
+    profile.push_back(Pair("blockcache", (uint64_t)entry.profile.nBlockCache));
+    profile.push_back(Pair("writebuffer", (uint64_t)entry.profile.nWriteBuffer));
+    profile.push_back(Pair("bloombits", entry.profile.nBloomBits));
+    profile.push_back(Pair("compression", entry.profile.fCompression));
+    profile.push_back(Pair("maxopenfiles", entry.profile.nMaxOpenFiles));
+    ret.push_back(Pair("profile", profile));
+
+    if (entry.fAccessCounters) {
+        ret.push_back(Pair("reads", (uint64_t)entry.pstats->nReads));
+        ret.push_back(Pair("reads_notfound", (uint64_t)entry.pstats->nReadsNotFound));
+        ret.push_back(Pair("batches", (uint64_t)entry.pstats->nBatches));
+        ret.push_back(Pair("bytes_written", (uint64_t)entry.pstats->nBytesWritten));
+        ret.push_back(Pair("iterators", (uint64_t)entry.pstats->nIterators));
+    }
+    uint64_t nHits = entry.pstats->nCacheHits, nMisses = entry.pstats->nCacheMisses;
+    ret.push_back(Pair("cache_hits", nHits));
+    ret.push_back(Pair("cache_misses", nMisses));
+    ret.push_back(Pair("cache_hit_rate", nHits + nMisses > 0 ? (double)nHits / (nHits + nMisses) : 0.0));
+
+    UniValue levels(UniValue::VARR);
+    for (int nLevel = 0; ; nLevel++) {
+        std::string strValue;
+        if (!entry.pdb->GetProperty(strprintf("leveldb.num-files-at-level%d", nLevel), &strValue))
+            break;
+        levels.push_back(atoi(strValue));
+    }
+    ret.push_back(Pair("files_per_level", levels));
+
+    std::string strStats;
+    UniValue compactions(UniValue::VARR);
+    if (entry.pdb->GetProperty("leveldb.stats", &strStats)) {
+        std::vector<std::string> lines;
+        boost::split(lines, strStats, boost::is_any_of("\n"));
+        BOOST_FOREACH(const std::string& line, lines)
+            if (!line.empty())
+                compactions.push_back(line);
+    }
+    ret.push_back(Pair("compactions", compactions));
+    return ret;
+}
+
+UniValue getdbstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getdbstats ( \"name\" )\n"
+            "\nReturns the settings and usage statistics of the open LevelDB databases.\n"
+            "\nArguments:\n"
+            "1. \"name\"      (string, optional) Only the database with this name\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",            (string) The database\n"
+            "    \"profile\": {...},          (object) The LevelDB settings it was opened with, see -dboption\n"
+            "    \"reads\": n,                (numeric) Point lookups since startup\n"
+            "    \"reads_notfound\": n,       (numeric) Point lookups that found nothing\n"
+            "    \"batches\": n,              (numeric) Write batches\n"
+            "    \"bytes_written\": n,        (numeric) Bytes of keys and values written\n"
+            "    \"iterators\": n,            (numeric) Iterators created\n"
+            "    \"cache_hits\": n,           (numeric) Table blocks found in the block cache\n"
+            "    \"cache_misses\": n,         (numeric) Table blocks read from disk\n"
+            "    \"cache_hit_rate\": x.xxx,   (numeric) Share of table block lookups served by the cache\n"
+            "    \"files_per_level\": [n,...], (array) Table files at each level\n"
+            "    \"compactions\": [\"...\"]    (array) Compaction statistics by level, as reported by LevelDB\n"
+            "  }, ...\n"
+            "]\n"
+            "Read and write counters are not kept for the Exodus databases.\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbstats", "")
+            + HelpExampleCli("getdbstats", "\"chainstate\"")
+            + HelpExampleRpc("getdbstats", "")
+        );
+
+    std::string strName = params.size() > 0 ? params[0].get_str() : "";
+    UniValue ret(UniValue::VARR);
+    ForEachDBStats([&ret, &strName](const CDBStatsEntry& entry) {
+        if (strName.empty() || entry.strName == strName)
+            ret.push_back(DBStatsToJSON(entry));
+    });
     return ret;
 }
 
@@ -1272,6 +1485,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblockhashes",         &getblockhashes,         true  },
     { "blockchain",         "getblockheader",         &getblockheader,         true  },
     { "blockchain",         "getchaintips",           &getchaintips,           true  },
+    { "blockchain",         "getdbstats",             &getdbstats,             true  },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    true  },
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  true  },
@@ -1281,6 +1495,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "clearmempool",           &clearmempool,           true  },
     { "blockchain",         "gettxout",               &gettxout,               true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
 
     /* Not shown in help */
@@ -87,6 +87,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "fundrawtransaction", 1 },
     { "gettxout", 1 },
     { "gettxout", 2 },
+    { "gettxoutsetinfo", 0 },
     { "gettxoutproof", 0 },
     { "lockunspent", 0 },
     { "lockunspent", 1 },
@@ -159,6 +160,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
 	{ "exodus_getfeedistribution", 0 },
 	{ "exodus_getfeedistributions", 0 },
 	{ "exodus_getbalanceshash", 0 },
+	{ "exodus_getperfstats", 0 },
 
 	/* Exodus - transaction calls */
 	{ "exodus_send", 2 },
@@ -5,6 +5,7 @@
 
 #include "base58.h"
 #include "clientversion.h"
+#include "indexer.h"
 #include "init.h"
 #include "main.h"
 #include "net.h"
@@ -637,6 +638,26 @@ bool getZerocoinAddressesFromParams(const UniValue& params, std::vector<std::pai
     return true;
 }
 
+/** Reads the optional "skip" and "limit" paging parameters, limit stays -1 when not given */
+void getPageFromParams(const UniValue& params, int &skip, int &limit)
+{
+    if (!params[0].isObject())
+        return;
+
+    UniValue skipValue = find_value(params[0].get_obj(), "skip");
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    if (skipValue.isNum()) {
+        skip = skipValue.get_int();
+        if (skip < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative skip");
+    }
+    if (limitValue.isNum()) {
+        limit = limitValue.get_int();
+        if (limit < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative limit");
+    }
+}
+
 bool heightSort(std::pair<CAddressUnspentKey, CAddressUnspentValue> a,
                 std::pair<CAddressUnspentKey, CAddressUnspentValue> b) {
     return a.second.blockHeight < b.second.blockHeight;
@@ -799,6 +820,8 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
                         "    ]\n"
                         "  \"start\" (number) The start block height\n"
                         "  \"end\" (number) The end block height\n"
+                        "  \"skip\" (number, optional) The number of deltas to skip\n"
+                        "  \"limit\" (number, optional) The maximum number of deltas to return\n"
                         "}\n"
                         "\nResult:\n"
                         "[\n"
@@ -837,36 +860,48 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    // Height bounds only apply when both are given
+    if (start <= 0 || end <= 0)
+        start = end = 0;
 
-    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
+    int skip = 0;
+    int limit = -1;
+    getPageFromParams(params, skip, limit);
 
     UniValue result(UniValue::VARR);
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+    // Deltas are converted as they are read, so long histories are never held in memory twice
+    AddressIndexVisitor addDelta = [&result, &skip, &limit](const CAddressIndexKey& key, CAmount nValue) {
+        if (skip > 0) {
+            skip--;
+            return true;
+        }
+        if (limit == 0)
+            return false;
+
         std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
+        if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
 
         UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
+        delta.push_back(Pair("satoshis", nValue));
+        delta.push_back(Pair("txid", key.txhash.GetHex()));
+        delta.push_back(Pair("index", (int)key.index));
+        delta.push_back(Pair("blockindex", (int)key.txindex));
+        delta.push_back(Pair("height", key.blockHeight));
         delta.push_back(Pair("address", address));
         result.push_back(delta);
+
+        if (limit > 0)
+            limit--;
+        return true;
+    };
+
+    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end() && limit != 0; it++) {
+        if (!ForEachAddressIndex((*it).first, (*it).second, start, end, addDelta)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
     }
 
     return result;
@@ -902,22 +937,16 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressBalanceValue value;
+        if (!GetAddressBalance((*it).first, (*it).second, value)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += value.balance;
+        received += value.received;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -943,6 +972,8 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
                         "    ]\n"
                         "  \"start\" (number) The start block height\n"
                         "  \"end\" (number) The end block height\n"
+                        "  \"skip\" (number, optional) The number of txids to skip\n"
+                        "  \"limit\" (number, optional) The maximum number of txids to return\n"
                         "}\n"
                         "\nResult:\n"
                         "[\n"
@@ -971,40 +1002,61 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         }
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    // Height bounds only apply when both are given
+    if (start <= 0 || end <= 0)
+        start = end = 0;
 
-    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    int skip = 0;
+    int limit = -1;
+    getPageFromParams(params, skip, limit);
+
+    UniValue result(UniValue::VARR);
+
+    if (addresses.size() == 1) {
+        // Entries of a transaction are adjacent in the index, so the txids can be streamed in order
+        uint256 lastTxid;
+        AddressIndexVisitor addTxid = [&result, &skip, &limit, &lastTxid](const CAddressIndexKey& key, CAmount nValue) {
+            if (key.txhash == lastTxid)
+                return true;
+            lastTxid = key.txhash;
+            if (skip > 0) {
+                skip--;
+                return true;
             }
+            if (limit == 0)
+                return false;
+            result.push_back(key.txhash.GetHex());
+            if (limit > 0)
+                limit--;
+            return true;
+        };
+
+        if (!ForEachAddressIndex(addresses[0].first, addresses[0].second, start, end, addTxid)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
+        return result;
     }
 
     std::set<std::pair<int, std::string> > txids;
-    UniValue result(UniValue::VARR);
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
+    AddressIndexVisitor collectTxid = [&txids](const CAddressIndexKey& key, CAmount nValue) {
+        txids.insert(std::make_pair(key.blockHeight, key.txhash.GetHex()));
+        return true;
+    };
 
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
+    for (std::vector<std::pair<uint160, AddressType> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        if (!ForEachAddressIndex((*it).first, (*it).second, start, end, collectTxid)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
 
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
+    for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end() && limit != 0; it++) {
+        if (skip > 0) {
+            skip--;
+            continue;
         }
+        result.push_back(it->second);
+        if (limit > 0)
+            limit--;
     }
 
     return result;
@@ -1048,6 +1100,8 @@ UniValue getspentinfo(const UniValue& params, bool fHelp)
     CSpentIndexValue value;
 
     if (!GetSpentIndex(key, value)) {
+        if (pspentindexer && !pspentindexer->IsSynced())
+            throw JSONRPCError(RPC_DATABASE_ERROR, strprintf("The spent index is still being built, at height %d", pspentindexer->GetBestHeight()));
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
     }
 
@@ -1077,8 +1131,11 @@ UniValue gettotalsupply(const UniValue& params, bool fHelp)
 
     CAmount total = 0;
 
-    if(!pblocktree->ReadTotalSupply(total))
-        throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the total supply from the database. This functionality requires -addressindex to be enabled. Enabling -addressindex requires reindexing.");
+    if(!paddressindexer)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the total supply from the database. This functionality requires -addressindex to be enabled.");
+
+    if(!paddressindexer->IsSynced() || !paddressindexer->ReadTotalSupply(total))
+        throw JSONRPCError(RPC_DATABASE_ERROR, strprintf("The address index is still being built, at height %d", paddressindexer->GetBestHeight()));
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("total", total));
@@ -1122,7 +1179,7 @@ UniValue getinfoex(const UniValue& params, bool fHelp)
 
     CAmount total = 0, zerocoin = 0;
 
-    if(!pblocktree->ReadTotalSupply(total))
+    if(!paddressindexer || !paddressindexer->IsSynced() || !paddressindexer->ReadTotalSupply(total))
         throw JSONRPCError(RPC_DATABASE_ERROR, "Cannot read the total supply from the database");
 
     info.push_back(Pair("moneysupply", total + zerocoin));
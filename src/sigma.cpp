@@ -16,6 +16,7 @@
 #include "bznode-sync.h"
 #include "primitives/zerocoin.h"
 #include "spork.h"
+#include "txdb.h"
 
 #include <atomic>
 #include <sstream>
@@ -391,7 +392,8 @@ bool CheckSigmaTransaction(
         int nHeight,
         bool isCheckWallet,
         bool fStatefulSigmaCheck,
-        CSigmaTxInfo *sigmaTxInfo)
+        CSigmaTxInfo *sigmaTxInfo,
+        const CBlockCheckSnapshot *psnapshot)
 {
     auto& consensus = ::Params().GetConsensus();
 
@@ -403,14 +405,15 @@ bool CheckSigmaTransaction(
         realHeight = chainActive.Height();
     }
 
-    if (sporkManager.IsSporkActive(SPORK_20_SIGMA) && (bznodeSync.IsBlockchainSynced()))
+    if (psnapshot ? (psnapshot->fSigmaSporkActive && psnapshot->fBlockchainSynced)
+                  : (sporkManager.IsSporkActive(SPORK_20_SIGMA) && bznodeSync.IsBlockchainSynced()))
     {
         return false;
     }
 
     bool allowSigma = (realHeight >= consensus.nSigmaStartBlock);
 
-    if (allowSigma && sigmaState.IsSurgeConditionDetected()) {
+    if (allowSigma && (psnapshot ? psnapshot->fSigmaSurgeCondition : sigmaState.IsSurgeConditionDetected())) {
         return state.DoS(100, false,
             REJECT_INVALID,
             "Sigma surge protection is ON.");
@@ -418,10 +421,15 @@ bool CheckSigmaTransaction(
 
     // Check Mint Sigma Transaction
     if (allowSigma) {
-        for (const CTxOut &txout : tx.vout) {
+        for (uint32_t nIndex = 0; nIndex < tx.vout.size(); nIndex++) {
+            const CTxOut &txout = tx.vout[nIndex];
             if (!txout.scriptPubKey.empty() && txout.scriptPubKey.IsSigmaMint()) {
                 if (!CheckSigmaMintTransaction(txout, state, hashTx, fStatefulSigmaCheck, sigmaTxInfo))
                     return false;
+                // the mint was just added to the info, reuse its parsed value
+                if (sigmaTxInfo && !sigmaTxInfo->fInfoIsComplete)
+                    sigmaTxInfo->mintOutPoints.push_back(std::make_pair(
+                            sigmaTxInfo->mints.back().getValueHash(), COutPoint(hashTx, nIndex)));
             }
         }
     }
@@ -608,6 +616,10 @@ bool ConnectBlockSigma(
             return true;
 
         sigmaState.AddMintsToStateAndBlockIndex(pindexNew, pblock);
+        if (!sigmaState.AddMintOutPoints(*pblock->sigmaTxInfo)) {
+            AbortNode("Failed to write sigma mint outpoints", "");
+            return state.Error("Failed to write sigma mint outpoints");
+        }
     }
     else if (!fJustCheck) { // TODO(martun): not sure if this else is necessary here. Check again later.
         sigmaState.AddBlock(pindexNew);
@@ -640,6 +652,14 @@ bool GetOutPointFromBlock(COutPoint& outPoint, const GroupElement &pubCoinValue,
     return false;
 }
 
+// Remember an outpoint found by reading its block, for mints connected before the index was kept
+static void StoreMintOutPoint(const uint256 &pubCoinValueHash, const COutPoint &outPoint) {
+    std::vector<std::pair<uint256, COutPoint>> mintOutPoints;
+    mintOutPoints.push_back(std::make_pair(pubCoinValueHash, outPoint));
+    if (pblocktree && !pblocktree->WriteSigmaMintOutPoints(mintOutPoints))
+        LogPrintf("can't store outpoint of sigma mint %s\n", pubCoinValueHash.ToString());
+}
+
 bool GetOutPoint(COutPoint& outPoint, const sigma::PublicCoin &pubCoin) {
 
     sigma::CSigmaState *sigmaState = sigma::CSigmaState::GetState();
@@ -650,13 +670,23 @@ bool GetOutPoint(COutPoint& outPoint, const sigma::PublicCoin &pubCoin) {
     if(mintHeight==-1 && coinId==-1)
         return false;
 
+    // the stored outpoint is only trusted for coins in the active chain
+    if (sigmaState->GetMintOutPoint(pubCoin.getValueHash(), outPoint))
+        return true;
+
     // get block containing mint
     CBlockIndex *mintBlock = chainActive[mintHeight];
     CBlock block;
-    if(!ReadBlockFromDisk(block, mintBlock, ::Params().GetConsensus()))
+    if(!ReadBlockFromDisk(block, mintBlock, ::Params().GetConsensus())) {
         LogPrintf("can't read block from disk.\n");
+        return false;
+    }
 
-    return GetOutPointFromBlock(outPoint, pubCoin.getValue(), block);
+    if (!GetOutPointFromBlock(outPoint, pubCoin.getValue(), block))
+        return false;
+
+    StoreMintOutPoint(pubCoin.getValueHash(), outPoint);
+    return true;
 }
 
 bool GetOutPoint(COutPoint& outPoint, const GroupElement &pubCoinValue) {
@@ -678,13 +708,23 @@ bool GetOutPoint(COutPoint& outPoint, const GroupElement &pubCoinValue) {
     if(mintHeight==-1 && coinId==-1)
         return false;
 
+    uint256 pubCoinValueHash = primitives::GetPubCoinValueHash(pubCoinValue);
+    if (sigmaState->GetMintOutPoint(pubCoinValueHash, outPoint))
+        return true;
+
     // get block containing mint
     CBlockIndex *mintBlock = chainActive[mintHeight];
     CBlock block;
-    if(!ReadBlockFromDisk(block, mintBlock, ::Params().GetConsensus()))
+    if(!ReadBlockFromDisk(block, mintBlock, ::Params().GetConsensus())) {
         LogPrintf("can't read block from disk.\n");
+        return false;
+    }
 
-    return GetOutPointFromBlock(outPoint, pubCoinValue, block);
+    if (!GetOutPointFromBlock(outPoint, pubCoinValue, block))
+        return false;
+
+    StoreMintOutPoint(pubCoinValueHash, outPoint);
+    return true;
 }
 
 bool GetOutPoint(COutPoint& outPoint, const uint256 &pubCoinValueHash) {
@@ -950,6 +990,17 @@ void CSigmaState::RemoveBlock(CBlockIndex *index) {
     BOOST_FOREACH(const spend_info_container::value_type &serial, index->sigmaSpentSerials) {
         containers.RemoveSpend(serial.first);
     }
+
+    // forget outpoints of the mints
+    std::vector<uint256> mintHashes;
+    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(sigma::CoinDenomination, int),vector<sigma::PublicCoin>) &pubCoins,
+                  index->sigmaMintedPubCoins) {
+        BOOST_FOREACH(const sigma::PublicCoin &coin, pubCoins.second) {
+            mintHashes.push_back(coin.getValueHash());
+        }
+    }
+    if (pblocktree && !mintHashes.empty() && !pblocktree->EraseSigmaMintOutPoints(mintHashes))
+        LogPrintf("can't erase outpoints of sigma mints of block %s\n", index->GetBlockHash().ToString());
 }
 
 bool CSigmaState::GetCoinGroupInfo(
@@ -1035,6 +1086,49 @@ int CSigmaState::GetCoinSetForSpend(
     return numberOfCoins;
 }
 
+bool CSigmaState::AddMintOutPoints(const CSigmaTxInfo& sigmaTxInfo) {
+    AssertLockHeld(cs_main);
+
+    if (!pblocktree || sigmaTxInfo.mintOutPoints.empty())
+        return true;
+
+    return pblocktree->WriteSigmaMintOutPoints(sigmaTxInfo.mintOutPoints);
+}
+
+bool CSigmaState::GetMintOutPoint(const uint256& pubCoinValueHash, COutPoint& outPoint) const {
+    return pblocktree && pblocktree->ReadSigmaMintOutPoint(pubCoinValueHash, outPoint);
+}
+
+int CSigmaState::GetCoinSetSizeForSpend(
+        CChain *chain,
+        int maxHeight,
+        sigma::CoinDenomination denomination,
+        int coinGroupID) {
+
+    pair<sigma::CoinDenomination, int> denomAndId = std::make_pair(denomination, coinGroupID);
+
+    auto groupIt = coinGroups.find(denomAndId);
+    if (groupIt == coinGroups.end())
+        return 0;
+
+    const SigmaCoinGroupInfo& coinGroup = groupIt->second;
+
+    int numberOfCoins = 0;
+    for (CBlockIndex *block = coinGroup.lastBlock;
+            ;
+            block = block->pprev) {
+        if (block->nHeight <= maxHeight) {
+            auto mintsIt = block->sigmaMintedPubCoins.find(denomAndId);
+            if (mintsIt != block->sigmaMintedPubCoins.end())
+                numberOfCoins += mintsIt->second.size();
+        }
+        if (block == coinGroup.firstBlock) {
+            break ;
+        }
+    }
+    return numberOfCoins;
+}
+
 std::pair<int, int> CSigmaState::GetMintedCoinHeightAndId(
         const sigma::PublicCoin& pubCoin) {
     auto coinIt = containers.GetMints().find(pubCoin);
@@ -1051,6 +1145,7 @@ bool CSigmaState::AddSpendToMempool(const vector<Scalar> &coinSerials, uint256 t
             return false;
 
         mempoolCoinSerials[coinSerial] = txHash;
+        mempoolCoinSerialHashes[primitives::GetSerialHash(coinSerial)] = txHash;
     }
 
     return true;
@@ -1061,11 +1156,20 @@ bool CSigmaState::AddSpendToMempool(const Scalar &coinSerial, uint256 txHash) {
         return false;
 
     mempoolCoinSerials[coinSerial] = txHash;
+    mempoolCoinSerialHashes[primitives::GetSerialHash(coinSerial)] = txHash;
     return true;
 }
 
 void CSigmaState::RemoveSpendFromMempool(const Scalar& coinSerial) {
-    mempoolCoinSerials.erase(coinSerial);
+    if (mempoolCoinSerials.erase(coinSerial))
+        mempoolCoinSerialHashes.erase(primitives::GetSerialHash(coinSerial));
+}
+
+uint256 CSigmaState::GetMempoolSpendTxHash(const uint256& coinSerialHash) const {
+    auto it = mempoolCoinSerialHashes.find(coinSerialHash);
+    if (it == mempoolCoinSerialHashes.end())
+        return uint256();
+    return it->second;
 }
 
 uint256 CSigmaState::GetMempoolConflictingTxHash(const Scalar& coinSerial) {
@@ -1083,6 +1187,7 @@ void CSigmaState::Reset() {
     coinGroups.clear();
     latestCoinIds.clear();
     mempoolCoinSerials.clear();
+    mempoolCoinSerialHashes.clear();
     containers.Reset();
 }
 
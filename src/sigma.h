@@ -20,6 +20,8 @@ namespace sigma_mintspend { struct sigma_mintspend_test; }
 namespace sigma_partialspend_mempool_tests { struct partialspend; }
 namespace zerocoin_tests3_v3 { struct zerocoin_mintspend_v3; }
 
+struct CBlockCheckSnapshot;
+
 namespace sigma {
 
 // Zerocoin transaction info, added to the CBlock to ensure zerocoin mint/spend transactions got their info stored into
@@ -32,6 +34,9 @@ public:
     // Vector of <pubCoin> for all the mints.
     std::vector<sigma::PublicCoin> mints;
 
+    // Outpoint of every mint by hash of its pubCoin value, in block order as mints get sorted
+    std::vector<std::pair<uint256, COutPoint>> mintOutPoints;
+
     // serial for every spend (map from serial to denomination)
     spend_info_container spentSerials;
 
@@ -61,7 +66,8 @@ bool CheckSigmaTransaction(
 	int nHeight,
   bool isCheckWallet,
   bool fStatefulSigmaCheck,
-  CSigmaTxInfo *zerocoinTxInfo);
+  CSigmaTxInfo *zerocoinTxInfo,
+  const CBlockCheckSnapshot *psnapshot = NULL);
 
 void DisconnectTipSigma(CBlock &block, CBlockIndex *pindexDelete);
 
@@ -150,9 +156,23 @@ public:
         uint256& blockHash_out,
         std::vector<sigma::PublicCoin>& coins_out);
 
+    // Same as GetCoinSetForSpend but only counts the coins instead of copying them
+    int GetCoinSetSizeForSpend(
+        CChain *chain,
+        int maxHeight,
+        sigma::CoinDenomination denomination,
+        int id);
+
     // Return height of mint transaction and id of minted coin
     std::pair<int, int> GetMintedCoinHeightAndId(const sigma::PublicCoin& pubCoin);
 
+    // Store outpoints of the mints of a connected block in the block tree database, so they can be found
+    // without reading the block again. False if writing them failed
+    bool AddMintOutPoints(const CSigmaTxInfo& sigmaTxInfo);
+
+    // Query outpoint of the mint with given hash of pubCoin value, if it is stored
+    bool GetMintOutPoint(const uint256& pubCoinValueHash, COutPoint& outPoint) const;
+
     // Reset to initial values
     void Reset();
 
@@ -173,6 +193,9 @@ public:
     // Remove spend from the mempool (usually as the result of adding tx to the block)
     void RemoveSpendFromMempool(const Scalar& coinSerial);
 
+    // Get hash of the mempool tx spending the coin with given serial hash, null if there is none
+    uint256 GetMempoolSpendTxHash(const uint256& coinSerialHash) const;
+
     static CSigmaState* GetState();
 
     int GetLatestCoinID(sigma::CoinDenomination denomination) const;
@@ -197,6 +220,9 @@ private:
     // serials of spends currently in the mempool mapped to tx hashes
     std::unordered_map<Scalar, uint256, CScalarHash> mempoolCoinSerials;
 
+    // the same spends keyed by hash of the serial, which is all the wallet knows about its coins
+    mempool_serial_hash_container mempoolCoinSerialHashes;
+
     std::atomic<bool> surgeCondition;
 
     struct Containers {
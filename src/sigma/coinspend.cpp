@@ -50,6 +50,28 @@ CoinSpend::CoinSpend(
     updateMetaData(coin, m);
 }
 
+CoinSpend::CoinSpend(const Params* p, const PrivateCoin& coin, const uint256& accumulatorBlockHash)
+    :
+    params(p),
+    denomination(coin.getPublicCoin().getDenomination()),
+    accumulatorBlockHash(accumulatorBlockHash),
+    coinSerialNumber(coin.getSerialNumber()),
+    ecdsaSignature(64, 0),
+    ecdsaPubkey(33, 0),
+    sigmaProof(p->get_n(), p->get_m())
+{
+    // all group elements and scalars serialize to a fixed size, so only the shape of the proof matters
+    sigmaProof.r1Proof_.f_.resize(p->get_m() * (p->get_n() - 1));
+    sigmaProof.Gk_.resize(p->get_m());
+}
+
+CoinSpend CoinSpend::CreatePlaceholder(
+    const Params* p,
+    const PrivateCoin& coin,
+    const SpendMetaData& m) {
+    return CoinSpend(p, coin, m.blockHash);
+}
+
 void CoinSpend::updateMetaData(const PrivateCoin& coin, const SpendMetaData& m){
     // Proves that the coin is correct w.r.t. serial number and hidden coin secret
     // (This proof is bound to the coin 'metadata', i.e., transaction hash)
@@ -27,6 +27,14 @@ public:
               const std::vector<sigma::PublicCoin>& anonymity_set,
               const SpendMetaData& m);
 
+    /**
+     * Creates a spend without proof and signature, which has the serialized size of a real spend.
+     * Used to estimate transaction sizes and fees before generating the proof.
+     */
+    static CoinSpend CreatePlaceholder(const Params* p,
+                                       const PrivateCoin& coin,
+                                       const SpendMetaData& m);
+
     void updateMetaData(const PrivateCoin& coin, const SpendMetaData& m);
 
     const Scalar& getCoinSerialNumber();
@@ -73,6 +81,9 @@ public:
     
     uint256 signatureHash(const SpendMetaData& m) const;
 
+private:
+    CoinSpend(const Params* p, const PrivateCoin& coin, const uint256& accumulatorBlockHash);
+
 private:
     const Params* params;
     unsigned int version = 0;
@@ -11,6 +11,8 @@
 #include "script/script.h"
 #include "addresstype.h"
 
+#include <boost/function.hpp>
+
 struct CSpentIndexKey {
     uint256 txid;
     unsigned int outputIndex;
@@ -238,6 +240,33 @@ struct CAddressUnspentValue {
     }
 };
 
+/** Sum of all the address index deltas of an address, kept up to date as blocks are indexed */
+struct CAddressBalanceValue {
+    CAmount balance;
+    CAmount received;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+    }
+
+    CAddressBalanceValue() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+    }
+
+    bool IsNull() const {
+        return (balance == 0 && received == 0);
+    }
+};
+
 struct CAddressIndexKey {
     AddressType type;
     uint160 hashBytes;
@@ -301,6 +330,9 @@ struct CAddressIndexKey {
 
 };
 
+/** Called for each address index entry in order, returning false stops the iteration */
+typedef boost::function<bool (const CAddressIndexKey& key, CAmount nValue)> AddressIndexVisitor;
+
 struct CAddressIndexIteratorKey {
     AddressType type;
     uint160 hashBytes;
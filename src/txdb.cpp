@@ -7,7 +7,9 @@
 
 #include "chainparams.h"
 #include "hash.h"
+#include "init.h"
 #include "pow.h"
+#include "ui_interface.h"
 #include "uint256.h"
 #include "main.h"
 #include "consensus/consensus.h"
@@ -15,36 +17,141 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
 
+static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
-static const char DB_ADDRESSINDEX = 'a';
-static const char DB_ADDRESSUNSPENTINDEX = 'u';
-static const char DB_TIMESTAMPINDEX = 's';
-static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
-static const char DB_TOTAL_SUPPLY = 'S';
+static const char DB_SIGMA_MINT_OUTPOINT = 'm';
+static const char DB_UTXO_STATS = 'U';
+
+
+namespace {
+
+/** Key of an unspent output in the coin database */
+struct CoinEntry
+{
+    char key;
+    uint256 txid;
+    uint32_t n;
+
+    CoinEntry() : key(0), n(0) {}
+    CoinEntry(const uint256& txidIn, uint32_t nIn) : key(DB_COIN), txid(txidIn), n(nIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(key);
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+    }
+};
+
+/**
+ * Value of an unspent output in the coin database:
+ * - VARINT(nHeight * 2 + fCoinBase)
+ * - VARINT(nVersion) of the transaction
+ * - the CTxOut (via CTxOutCompressor)
+ */
+class CDiskCoin
+{
+public:
+    CTxOut txout;
+    bool fCoinBase;
+    int nHeight;
+    int nVersion;
+
+    CDiskCoin() : fCoinBase(false), nHeight(0), nVersion(0) {}
+    CDiskCoin(const CCoins& coins, uint32_t nPos) : txout(coins.vout[nPos]), fCoinBase(coins.fCoinBase), nHeight(coins.nHeight), nVersion(coins.nVersion) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return ::GetSerializeSize(VARINT((unsigned int)nHeight*2+(fCoinBase ? 1 : 0)), nType, nVersion) +
+               ::GetSerializeSize(VARINT(this->nVersion), nType, nVersion) +
+               ::GetSerializeSize(CTxOutCompressor(REF(txout)), nType, nVersion);
+    }
 
+    template<typename Stream>
+    void Serialize(Stream &s, int nType, int nVersion) const {
+        ::Serialize(s, VARINT((unsigned int)nHeight*2+(fCoinBase ? 1 : 0)), nType, nVersion);
+        ::Serialize(s, VARINT(this->nVersion), nType, nVersion);
+        ::Serialize(s, CTxOutCompressor(REF(txout)), nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s, int nType, int nVersion) {
+        unsigned int nCode = 0;
+        ::Unserialize(s, VARINT(nCode), nType, nVersion);
+        nHeight = nCode / 2;
+        fCoinBase = nCode & 1;
+        ::Unserialize(s, VARINT(this->nVersion), nType, nVersion);
+        ::Unserialize(s, REF(CTxOutCompressor(REF(txout))), nType, nVersion);
+    }
+};
+
+/**
+ * Collect the outputs of a transaction starting at the cursor position, and
+ * leave the cursor on the first record of the next transaction.
+ *
+ * @return False if the cursor is not on an output of txid
+ */
+bool ReadTxOutputs(CDBIterator* pcursor, const uint256& txid, CCoins& coins, unsigned int* pnSize)
+{
+    coins.Clear();
+    bool fFound = false;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        CoinEntry entry;
+        if (!pcursor->GetKey(entry) || entry.key != DB_COIN || entry.txid != txid)
+            break;
+        CDiskCoin coin;
+        if (!pcursor->GetValue(coin))
+            throw std::runtime_error("Database read failure");
+        if (pnSize)
+            *pnSize += pcursor->GetValueSize();
+        if (coins.vout.size() <= entry.n)
+            coins.vout.resize(entry.n + 1);
+        coins.vout[entry.n] = coin.txout;
+        coins.fCoinBase = coin.fCoinBase;
+        coins.nHeight = coin.nHeight;
+        coins.nVersion = coin.nVersion;
+        fFound = true;
+    }
+    return fFound;
+}
+
+} // anon namespace
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, "chainstate")
 {
 }
 
 bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+    // A short-lived iterator per lookup, it doesn't fill the block cache and pins no snapshot past the call
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper&>(db).NewIterator());
+    pcursor->Seek(CoinEntry(txid, 0));
+    return ReadTxOutputs(pcursor.get(), txid, coins, NULL);
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+    // Output 0 is unspent for most transactions that have unspent outputs at all
+    if (db.Exists(CoinEntry(txid, 0)))
+        return true;
+    boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper&>(db).NewIterator());
+    pcursor->Seek(CoinEntry(txid, 1));
+    CoinEntry entry;
+    return pcursor->Valid() && pcursor->GetKey(entry) && entry.key == DB_COIN && entry.txid == txid;
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -54,30 +161,248 @@ uint256 CCoinsViewDB::GetBestBlock() const {
     return hashBestChain;
 }
 
+bool CCoinsViewDB::ReadUTXOStats(uint256 &hashBlock, CUTXOStats &stats) const {
+    std::pair<uint256, CUTXOStats> value;
+    if (!db.Read(DB_UTXO_STATS, value))
+        return false;
+    hashBlock = value.first;
+    stats = value.second;
+    return true;
+}
+
+bool CCoinsViewDB::WriteUTXOStats(const uint256 &hashBlock, const CUTXOStats &stats) {
+    return db.Write(DB_UTXO_STATS, std::make_pair(hashBlock, stats));
+}
+
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    bool fOk = WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return fOk;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    size_t written = 0;
+    size_t erased = 0;
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(make_pair(DB_COINS, it->first));
-            else
-                batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
+            const CCoins& coins = it->second.coins;
+            if (it->second.flags & CCoinsCacheEntry::FRESH) {
+                // None of the outputs are in the database yet
+                for (unsigned int i = 0; i < coins.vout.size(); i++) {
+                    if (coins.IsAvailable(i)) {
+                        batch.Write(CoinEntry(it->first, i), CDiskCoin(coins, i));
+                        written++;
+                    }
+                }
+            } else {
+                BOOST_FOREACH(uint32_t nPos, it->second.vChanged) {
+                    if (coins.IsAvailable(nPos)) {
+                        batch.Write(CoinEntry(it->first, nPos), CDiskCoin(coins, nPos));
+                        written++;
+                    } else {
+                        batch.Erase(CoinEntry(it->first, nPos));
+                        erased++;
+                    }
+                }
+            }
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed transactions (out of %u), %u outputs written and %u erased, to coin database...\n",
+             (unsigned int)changed, (unsigned int)count, (unsigned int)written, (unsigned int)erased);
     return db.WriteBatch(batch);
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+bool CCoinsViewDB::Upgrade() {
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(make_pair(DB_COINS, uint256()));
+    std::pair<char, uint256> key;
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_COINS)
+        return true;
+
+    LogPrintf("Upgrading the coin database to one record per output...\n");
+    uiInterface.InitMessage(_("Upgrading UTXO database"));
+    int64_t nTxs = 0, nOutputs = 0;
+    while (pcursor->Valid()) {
+        // Each transaction is converted in the batch that erases its old
+        // record, so an interrupted upgrade resumes where it stopped.
+        CDBBatch batch(db);
+        unsigned int nBatchTxs = 0;
+        for (; pcursor->Valid() && nBatchTxs < 100000; pcursor->Next()) {
+            if (!pcursor->GetKey(key) || key.first != DB_COINS)
+                break;
+            CCoins coins;
+            if (!pcursor->GetValue(coins))
+                return error("%s: unable to read coins of %s", __func__, key.second.ToString());
+            for (unsigned int i = 0; i < coins.vout.size(); i++) {
+                if (coins.IsAvailable(i)) {
+                    batch.Write(CoinEntry(key.second, i), CDiskCoin(coins, i));
+                    nOutputs++;
+                }
+            }
+            batch.Erase(key);
+            nBatchTxs++;
+        }
+        if (!db.WriteBatch(batch))
+            return error("%s: failed to write to coin database", __func__);
+        nTxs += nBatchTxs;
+        if (nBatchTxs == 0)
+            break;
+        // Transaction ids are uniformly distributed, so the first byte tells how far along we are
+        LogPrintf("Upgraded %d transactions (%d outputs), at %u%%\n", nTxs, nOutputs, (unsigned int)*key.second.begin() * 100 / 256);
+        if (ShutdownRequested()) {
+            LogPrintf("Coin database upgrade interrupted, it will resume at the next start\n");
+            return true;
+        }
+    }
+    LogPrintf("Coin database upgrade done: %d transactions split into %d outputs\n", nTxs, nOutputs);
+    return true;
+}
+
+CCoinsViewWriteBehind::CCoinsViewWriteBehind(CCoinsViewDB* dbIn) : db(dbIn), fPending(false), fFailed(false), fStop(false)
+{
+    thread = boost::thread(boost::bind(&CCoinsViewWriteBehind::ThreadWrite, this));
+}
+
+CCoinsViewWriteBehind::~CCoinsViewWriteBehind()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fStop = true;
+        cond.notify_all();
+    }
+    thread.join();
+}
+
+void CCoinsViewWriteBehind::ThreadWrite()
+{
+    RenameThread("bitcoin-coinswrite");
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (true) {
+        while (!fPending && !fStop)
+            cond.wait(lock);
+        if (!fPending)
+            return;
+
+        // Readers only look entries up while the batch is being written, it
+        // is not modified until it is done
+        lock.unlock();
+        int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = db->WriteCoins(mapPending, hashPending);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        LogPrint("coindb", "Wrote %u transactions to the coin database in the background in %.2fms\n",
+                 (unsigned int)mapPending.size(), 0.001 * (GetTimeMicros() - nStart));
+        lock.lock();
+
+        if (fOk) {
+            mapPending.clear();
+            hashPending.SetNull();
+        } else {
+            // Keep answering reads from the batch; the next flush reports the failure
+            error("%s: failed to write to coin database", __func__);
+            fFailed = true;
+        }
+        fPending = false;
+        cond.notify_all();
+    }
+}
+
+bool CCoinsViewWriteBehind::Sync() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (fPending)
+        cond.wait(lock);
+    return !fFailed;
+}
+
+bool CCoinsViewWriteBehind::IsWriting() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return fPending;
+}
+
+bool CCoinsViewWriteBehind::GetCoins(const uint256 &txid, CCoins &coins) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        CCoinsMap::const_iterator it = mapPending.find(txid);
+        if (it != mapPending.end()) {
+            if (it->second.coins.IsPruned())
+                return false;
+            coins = it->second.coins;
+            return true;
+        }
+    }
+    return db->GetCoins(txid, coins);
+}
+
+bool CCoinsViewWriteBehind::HaveCoins(const uint256 &txid) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        CCoinsMap::const_iterator it = mapPending.find(txid);
+        if (it != mapPending.end())
+            return !it->second.coins.IsPruned();
+    }
+    return db->HaveCoins(txid);
+}
+
+uint256 CCoinsViewWriteBehind::GetBestBlock() const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (!hashPending.IsNull())
+            return hashPending;
+    }
+    return db->GetBestBlock();
+}
+
+bool CCoinsViewWriteBehind::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (fPending)
+        cond.wait(lock);
+    if (fFailed)
+        return false;
+
+    // Entries that are unchanged, or that were created and spent since the
+    // last flush, mean nothing to the database
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+        const CCoinsCacheEntry& entry = it->second;
+        if (!(entry.flags & CCoinsCacheEntry::DIRTY) ||
+                ((entry.flags & CCoinsCacheEntry::FRESH) && entry.coins.IsPruned()))
+            mapCoins.erase(it++);
+        else
+            it++;
+    }
+    mapPending.swap(mapCoins);
+    mapCoins.clear();
+    hashPending = hashBlock;
+    fPending = true;
+    cond.notify_all();
+    return true;
+}
+
+CCoinsViewCursor *CCoinsViewWriteBehind::Cursor() const
+{
+    // The database cursor has to see every flushed entry
+    if (!Sync())
+        return NULL;
+    return db->Cursor();
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, "blockindex") {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -106,17 +431,16 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COINS);
-    // Cache key of first record
-    i->pcursor->GetKey(i->keyTmp);
+    i->pcursor->Seek(DB_COIN);
+    // Gather the outputs of the first transaction
+    i->Next();
     return i;
 }
 
 bool CCoinsViewDBCursor::GetKey(uint256 &key) const
 {
-    // Return cached key
-    if (keyTmp.first == DB_COINS) {
-        key = keyTmp.second;
+    if (fValid) {
+        key = txidTmp;
         return true;
     }
     return false;
@@ -124,24 +448,33 @@ bool CCoinsViewDBCursor::GetKey(uint256 &key) const
 
 bool CCoinsViewDBCursor::GetValue(CCoins &coins) const
 {
-    return pcursor->GetValue(coins);
+    if (fValid) {
+        coins = coinsTmp;
+        return true;
+    }
+    return false;
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
 {
-    return pcursor->GetValueSize();
+    return nValueSizeTmp;
 }
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COINS;
+    return fValid;
 }
 
 void CCoinsViewDBCursor::Next()
 {
-    pcursor->Next();
-    if (!pcursor->Valid() || !pcursor->GetKey(keyTmp))
-        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
+    // The outputs of a transaction are adjacent; group them into one CCoins
+    CoinEntry entry;
+    nValueSizeTmp = 0;
+    fValid = pcursor->Valid() && pcursor->GetKey(entry) && entry.key == DB_COIN;
+    if (fValid) {
+        txidTmp = entry.txid;
+        fValid = ReadTxOutputs(pcursor.get(), txidTmp, coinsTmp, &nValueSizeTmp);
+    }
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -167,154 +500,154 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
+bool CBlockTreeDB::ReadSigmaMintOutPoint(const uint256 &pubCoinValueHash, COutPoint &outPoint) {
+    return Read(make_pair(DB_SIGMA_MINT_OUTPOINT, pubCoinValueHash), outPoint);
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
+bool CBlockTreeDB::WriteSigmaMintOutPoints(const std::vector<std::pair<uint256, COutPoint> > &list) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
-        }
-    }
+    for (std::vector<std::pair<uint256, COutPoint> >::const_iterator it = list.begin(); it != list.end(); it++)
+        batch.Write(make_pair(DB_SIGMA_MINT_OUTPOINT, it->first), it->second);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
+bool CBlockTreeDB::EraseSigmaMintOutPoints(const std::vector<uint256> &list) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
-        }
-    }
+    for (std::vector<uint256>::const_iterator it = list.begin(); it != list.end(); it++)
+        batch.Erase(make_pair(DB_SIGMA_MINT_OUTPOINT, *it));
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address unspent value");
-            }
-        } else {
-            break;
-        }
-    }
-
-    return true;
-}
-
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-    batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
+    return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
 
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-    batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
+bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
+    char ch;
+    if (!Read(std::make_pair(DB_FLAG, name), ch))
+        return false;
+    fValue = ch == '1';
+    return true;
 }
 
-bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, AddressType type,
-                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    if (start > 0 && end > 0) {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
-    }
-
+// Records of the indexes that were written here by ConnectBlock, and the flags telling whether they were enabled
+static const char DB_LEGACY_ADDRESSINDEX = 'a';
+static const char DB_LEGACY_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_LEGACY_TIMESTAMPINDEX = 's';
+static const char DB_LEGACY_SPENTINDEX = 'p';
+static const char DB_LEGACY_TOTAL_SUPPLY = 'S';
+static const char* const LEGACY_INDEX_FLAGS[] = {"addressindex", "spentindex", "timestampindex"};
+
+/**
+ * Erase the records of one legacy index, whose keys are the prefix followed by a K.
+ *
+ * @return False on a write failure or when interrupted
+ */
+template <typename K>
+static bool EraseLegacyIndex(CDBWrapper &db, char prefix, const char *name) {
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(prefix);
+    int64_t nErased = 0;
     while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash && key.second.type == type) {
-            if (end > 0 && key.second.blockHeight > end) {
+        CDBBatch batch(db);
+        unsigned int nBatch = 0;
+        for (; pcursor->Valid() && nBatch < 100000; pcursor->Next()) {
+            std::pair<char, K> key;
+            if (!pcursor->GetKey(key) || key.first != prefix)
                 break;
-            }
-            CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
-            }
-        } else {
-            break;
+            batch.Erase(key);
+            nBatch++;
         }
+        if (!db.WriteBatch(batch))
+            return error("%s: failed to erase the old %s records", __func__, name);
+        nErased += nBatch;
+        if (nBatch == 0)
+            break;
+        LogPrintf("Erased %d old %s records\n", nErased, name);
+        if (ShutdownRequested())
+            return false;
     }
-
     return true;
 }
 
+bool CBlockTreeDB::EraseLegacyIndexes() {
+    bool fPresent = false;
+    for (const char *flag : LEGACY_INDEX_FLAGS) {
+        bool fValue;
+        fPresent |= ReadFlag(flag, fValue);
+    }
+    if (!fPresent)
+        return true;
+
+    LogPrintf("Erasing the index records kept in the block index by earlier versions...\n");
+    uiInterface.InitMessage(_("Erasing old index records..."));
+    if (!EraseLegacyIndex<CAddressIndexKey>(*this, DB_LEGACY_ADDRESSINDEX, "address index") ||
+        !EraseLegacyIndex<CAddressUnspentKey>(*this, DB_LEGACY_ADDRESSUNSPENTINDEX, "address unspent index") ||
+        !EraseLegacyIndex<CTimestampIndexKey>(*this, DB_LEGACY_TIMESTAMPINDEX, "timestamp index") ||
+        !EraseLegacyIndex<CSpentIndexKey>(*this, DB_LEGACY_SPENTINDEX, "spent index")) {
+        // the flags are left in place, so an interrupted erase resumes at the next start
+        return ShutdownRequested();
+    }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
     CDBBatch batch(*this);
-    batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
+    batch.Erase(DB_LEGACY_TOTAL_SUPPLY);
+    for (const char *flag : LEGACY_INDEX_FLAGS)
+        batch.Erase(std::make_pair(DB_FLAG, std::string(flag)));
+    if (!WriteBatch(batch, true))
+        return error("%s: failed to erase the old index flags", __func__);
+    LogPrintf("Old index records erased\n");
+    return true;
 }
 
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
+namespace {
 
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+/** Leading fields of a CDiskBlockIndex record, enough to order the records by height */
+struct CDiskBlockIndexHeight
+{
+    int nHeight;
 
-    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+    ADD_SERIALIZE_METHODS;
 
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
-            hashes.push_back(key.second.blockHash);
-            pcursor->Next();
-        } else {
-            break;
-        }
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        int nClientVersion = 0;
+        READWRITE(VARINT(nClientVersion));
+        READWRITE(VARINT(nHeight));
     }
+};
 
-    return true;
-}
-
-bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
-    return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
-}
-
-bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
-    char ch;
-    if (!Read(std::make_pair(DB_FLAG, name), ch))
-        return false;
-    fValue = ch == '1';
-    return true;
-}
+} // namespace
 
-bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex,
+                                      boost::function<void(size_t)> reserveBlockIndex)
 {
     auto consensusParams = Params().GetConsensus();
     LogPrintf("CBlockTreeDB::LoadBlockIndexGuts\n");
     //bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
+    // First pass: create the entries in height order, so that walking the
+    // chain walks memory in order instead of hopping around the heap
+    std::vector<std::pair<int, uint256> > vHeights;
+    pcursor->Seek(make_pair(DB_BLOCK_INDEX, uint256()));
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX)
+            break;
+        CDiskBlockIndexHeight diskheight;
+        if (!pcursor->GetValue(diskheight))
+            return error("LoadBlockIndex() : failed to read value");
+        vHeights.push_back(std::make_pair(diskheight.nHeight, key.second));
+        pcursor->Next();
+    }
+    std::sort(vHeights.begin(), vHeights.end());
+    reserveBlockIndex(vHeights.size());
+    for (size_t i = 0; i < vHeights.size(); i++)
+        insertBlockIndex(vHeights[i].second);
+    std::vector<std::pair<int, uint256> >().swap(vHeights);
+
+    // Second pass: fill them in
     pcursor->Seek(make_pair(DB_BLOCK_INDEX, uint256()));
 
     // Load mapBlockIndex
@@ -324,11 +657,9 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
         if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
             CDiskBlockIndex diskindex;
             if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-            	//if(diskindex.hashBlock != uint256()
-            	//	&& diskindex.hashPrev != uint256()){
-                CBlockIndex* pindexNew    = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev 		  = insertBlockIndex(diskindex.hashPrev);
+                // Construct block index object, the key is the hash of the block
+                CBlockIndex* pindexNew    = insertBlockIndex(key.second);
+                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
 
                 pindexNew->nHeight        = diskindex.nHeight;
                 pindexNew->nFile          = diskindex.nFile;
@@ -342,12 +673,13 @@ bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256
                 pindexNew->nStatus        = diskindex.nStatus;
                 pindexNew->nTx            = diskindex.nTx;
 
-                pindexNew->accumulatorChanges = diskindex.accumulatorChanges;
-                pindexNew->mintedPubCoins     = diskindex.mintedPubCoins;
-                pindexNew->spentSerials       = diskindex.spentSerials;
+                // diskindex is thrown away, so take its maps rather than copy them
+                pindexNew->accumulatorChanges.swap(diskindex.accumulatorChanges);
+                pindexNew->mintedPubCoins.swap(diskindex.mintedPubCoins);
+                pindexNew->spentSerials.swap(diskindex.spentSerials);
 
-                pindexNew->sigmaMintedPubCoins   = diskindex.sigmaMintedPubCoins;
-                pindexNew->sigmaSpentSerials     = diskindex.sigmaSpentSerials;
+                pindexNew->sigmaMintedPubCoins.swap(diskindex.sigmaMintedPubCoins);
+                pindexNew->sigmaSpentSerials.swap(diskindex.sigmaSpentSerials);
 
                 pcursor->Next();
             } else {
@@ -392,24 +724,6 @@ int CBlockTreeDB::GetBlockIndexVersion(uint256 const & blockHash)
 }
 
 
-bool CBlockTreeDB::AddTotalSupply(CAmount const & supply)
-{
-    CAmount current = 0;
-    Read(DB_TOTAL_SUPPLY, current);
-    current += supply;
-    return Write(DB_TOTAL_SUPPLY, current);
-}
-
-bool CBlockTreeDB::ReadTotalSupply(CAmount & supply)
-{
-    CAmount current = 0;
-    if(Read(DB_TOTAL_SUPPLY, current)) {
-        supply = current;
-        return true;
-    }
-    return false;
-}
-
 /******************************************************************************/
 
 CDbIndexHelper::CDbIndexHelper(bool addressIndex_, bool spentIndex_)
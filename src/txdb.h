@@ -10,6 +10,7 @@
 #include "dbwrapper.h"
 #include "chain.h"
 #include "spentindex.h"
+#include "utxostats.h"
 
 #include <map>
 #include <string>
@@ -17,6 +18,10 @@
 #include <vector>
 
 #include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 class CBlockIndex;
 class CCoinsViewDBCursor;
@@ -36,6 +41,8 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -writebehind default
+static const bool DEFAULT_WRITE_BEHIND = false;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -62,7 +69,12 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
-/** CCoinsView backed by the coin database (chainstate/) */
+/**
+ * CCoinsView backed by the coin database (chainstate/). Every unspent output
+ * is a record of its own, keyed by txid and output index, so spending an
+ * output of a transaction with many of them erases one small record instead
+ * of rewriting them all. CCoins are assembled from adjacent records on read.
+ */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
@@ -75,6 +87,19 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     CCoinsViewCursor *Cursor() const;
+
+    //! BatchWrite without consuming the entries, so that others can keep reading them meanwhile
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock);
+
+    /**
+     * Split the per-transaction records of older databases into per-output ones. False on failure.
+     * An interrupted upgrade returns true and resumes at the next start, callers check ShutdownRequested.
+     */
+    bool Upgrade();
+
+    //! Statistics of the chainstate at hashBlock, as last written
+    bool ReadUTXOStats(uint256 &hashBlock, CUTXOStats &stats) const;
+    bool WriteUTXOStats(const uint256 &hashBlock, const CUTXOStats &stats);
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -92,13 +117,62 @@ public:
 
 private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn), fValid(false), nValueSizeTmp(0) {}
     boost::scoped_ptr<CDBIterator> pcursor;
-    std::pair<char, uint256> keyTmp;
+    // The transaction the cursor is on, gathered from its output records
+    bool fValid;
+    uint256 txidTmp;
+    CCoins coinsTmp;
+    unsigned int nValueSizeTmp;
 
     friend class CCoinsViewDB;
 };
 
+/**
+ * Write-behind layer over the coin database (-writebehind). A flush of the
+ * cache above hands its dirty entries over and returns at once; a background
+ * thread writes them to the database while validation goes on, and reads are
+ * answered from the handed over entries until they are on disk. One batch is
+ * in flight at a time, a further flush waits for it. A batch is written
+ * together with its best block, so the chainstate on disk is always that of
+ * some block, whatever the moment of a crash.
+ */
+class CCoinsViewWriteBehind : public CCoinsView
+{
+public:
+    CCoinsViewWriteBehind(CCoinsViewDB* dbIn);
+    //! Writes the batch in flight before returning
+    ~CCoinsViewWriteBehind();
+
+    bool GetCoins(const uint256 &txid, CCoins &coins) const;
+    bool HaveCoins(const uint256 &txid) const;
+    uint256 GetBestBlock() const;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    CCoinsViewCursor *Cursor() const;
+
+    //! Wait until the batch in flight is on disk, false if writing it failed
+    bool Sync() const;
+
+    //! Whether the batch of the last flush is still being written
+    bool IsWriting() const;
+
+private:
+    void ThreadWrite();
+
+    CCoinsViewDB* db;
+
+    mutable boost::mutex cs;
+    mutable boost::condition_variable cond;
+    //! Entries of the last flush, kept until written (or for good if writing them failed)
+    CCoinsMap mapPending;
+    uint256 hashPending;
+    bool fPending;
+    bool fFailed;
+    bool fStop;
+
+    boost::thread thread;
+};
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
@@ -115,26 +189,22 @@ public:
     bool ReadReindexing(bool &fReindex);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
-    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
-    bool ReadAddressUnspentIndex(uint160 addressHash, AddressType type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool ReadAddressIndex(uint160 addressHash, AddressType type,
-                          std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
-
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
-    bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    //! Outpoints of sigma mints in the active chain, by hash of their pubCoin value
+    bool ReadSigmaMintOutPoint(const uint256 &pubCoinValueHash, COutPoint &outPoint);
+    bool WriteSigmaMintOutPoints(const std::vector<std::pair<uint256, COutPoint> > &list);
+    bool EraseSigmaMintOutPoints(const std::vector<uint256> &list);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Erase the address, spent and timestamp index records that were kept here before the indexes moved to
+     * their own databases. Done while the flags of those versions are present. False on a write failure.
+     */
+    bool EraseLegacyIndexes();
+    //! Load the block index, creating its entries in height order after reserving room for all of them
+    bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex,
+                            boost::function<void(size_t)> reserveBlockIndex);
     int GetBlockIndexVersion();
     int GetBlockIndexVersion(uint256 const & blockHash);
-    bool AddTotalSupply(CAmount const & supply);
-    bool ReadTotalSupply(CAmount & supply);
 };
 
 
@@ -0,0 +1,145 @@
+// Copyright (c) 2019 The BitcoinZero Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxostats.h"
+
+#include "coins.h"
+#include "hash.h"
+#include "primitives/transaction.h"
+#include "util.h"
+
+#include <string.h>
+
+#include <boost/thread.hpp>
+
+using secp_primitives::GroupElement;
+
+//! Point of the curve an output hashes to
+static GroupElement CoinElement(const COutPoint& outpoint, const CTxOut& txout, int nHeight, bool fCoinBase)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << outpoint;
+    ss << VARINT(nHeight * 2 + (fCoinBase ? 1 : 0));
+    ss << txout;
+    uint256 hash = ss.GetHash();
+
+    GroupElement element;
+    element.generate(hash.begin());
+    return element;
+}
+
+//! Counted for every output besides its script: txid, index, height and coinbase flag, amount, script size
+static const int64_t COIN_BOGO_OVERHEAD = 32 + 4 + 4 + 8 + 2;
+
+void CUTXOStats::SetNull()
+{
+    nTransactions = 0;
+    nTransactionOutputs = 0;
+    nBogoSize = 0;
+    nTotalAmount = 0;
+    commitment = GroupElement();
+}
+
+void CUTXOStats::AddCoin(const COutPoint& outpoint, const CTxOut& txout, int nHeight, bool fCoinBase)
+{
+    nTransactionOutputs++;
+    nBogoSize += COIN_BOGO_OVERHEAD + txout.scriptPubKey.size();
+    nTotalAmount += txout.nValue;
+    commitment += CoinElement(outpoint, txout, nHeight, fCoinBase);
+}
+
+void CUTXOStats::RemoveCoin(const COutPoint& outpoint, const CTxOut& txout, int nHeight, bool fCoinBase)
+{
+    nTransactionOutputs--;
+    nBogoSize -= COIN_BOGO_OVERHEAD + txout.scriptPubKey.size();
+    nTotalAmount -= txout.nValue;
+    commitment += CoinElement(outpoint, txout, nHeight, fCoinBase).inverse();
+}
+
+void CUTXOStats::Add(const CUTXOStats& other)
+{
+    nTransactions += other.nTransactions;
+    nTransactionOutputs += other.nTransactionOutputs;
+    nBogoSize += other.nBogoSize;
+    nTotalAmount += other.nTotalAmount;
+    commitment += other.commitment;
+}
+
+uint256 CUTXOStats::GetCommitmentHash() const
+{
+    // The point at infinity has no canonical coordinates to hash
+    if (commitment == GroupElement())
+        return uint256();
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << commitment;
+    return ss.GetHash();
+}
+
+static const unsigned char UTXO_SNAPSHOT_MAGIC[5] = {'u', 't', 'x', 'o', 0xff};
+
+CUTXOSnapshotHeader::CUTXOSnapshotHeader() : nSnapshotVersion(CURRENT_VERSION), nHeight(0), nTransactions(0), nTransactionOutputs(0)
+{
+    memcpy(pchMagic, UTXO_SNAPSHOT_MAGIC, sizeof(pchMagic));
+    memset(pchMessageStart, 0, sizeof(pchMessageStart));
+}
+
+bool CUTXOSnapshotHeader::IsValid() const
+{
+    return memcmp(pchMagic, UTXO_SNAPSHOT_MAGIC, sizeof(pchMagic)) == 0 && nSnapshotVersion == CURRENT_VERSION;
+}
+
+bool ComputeUTXOStats(CCoinsViewCursor* pcursor, CUTXOStats& stats)
+{
+    stats.SetNull();
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        uint256 txid;
+        CCoins coins;
+        if (!pcursor->GetKey(txid) || !pcursor->GetValue(coins))
+            return error("%s: unable to read value", __func__);
+        if (!coins.IsPruned())
+            stats.nTransactions++;
+        for (unsigned int i = 0; i < coins.vout.size(); i++) {
+            if (!coins.vout[i].IsNull())
+                stats.AddCoin(COutPoint(txid, i), coins.vout[i], coins.nHeight, coins.fCoinBase);
+        }
+        pcursor->Next();
+    }
+    return true;
+}
+
+bool CUTXOStatsTracker::Get(CUTXOStats& statsOut, uint256& hashBlockOut) const
+{
+    if (!fReady)
+        return false;
+    statsOut = stats;
+    hashBlockOut = hashBlock;
+    return true;
+}
+
+void CUTXOStatsTracker::Apply(const CUTXOStats& delta, const uint256& hashBlockIn)
+{
+    stats.Add(delta);
+    hashBlock = hashBlockIn;
+}
+
+void CUTXOStatsTracker::Reset(const CUTXOStats& statsIn, const uint256& hashBlockIn)
+{
+    stats = statsIn;
+    hashBlock = hashBlockIn;
+    fReady = true;
+}
+
+void CUTXOStatsTracker::StartRebuild(const uint256& hashBlockIn)
+{
+    stats.SetNull();
+    hashBlock = hashBlockIn;
+    fReady = false;
+}
+
+void CUTXOStatsTracker::FinishRebuild(const CUTXOStats& statsSnapshot)
+{
+    stats.Add(statsSnapshot);
+    fReady = true;
+}
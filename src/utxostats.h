@@ -0,0 +1,140 @@
+// Copyright (c) 2019 The BitcoinZero Core Developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSTATS_H
+#define BITCOIN_UTXOSTATS_H
+
+#include "amount.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <secp256k1/include/GroupElement.h>
+
+class CCoinsViewCursor;
+class COutPoint;
+class CTxOut;
+
+/**
+ * Statistics of a set of unspent outputs, with a commitment to its contents.
+ * The commitment is a multiset hash: every output is hashed to a point of the
+ * secp256k1 curve and the points are added up. Outputs can therefore be added
+ * and removed in any order, and the statistics of disjoint changes add up the
+ * same way, which lets the ones of the chainstate follow it block by block
+ * instead of being computed with a walk over the whole database.
+ */
+class CUTXOStats
+{
+public:
+    //! Transactions with at least one unspent output
+    int64_t nTransactions;
+    int64_t nTransactionOutputs;
+    //! Rough size of the set, counting a fixed overhead plus the script of each output
+    int64_t nBogoSize;
+    CAmount nTotalAmount;
+    secp_primitives::GroupElement commitment;
+
+    CUTXOStats() { SetNull(); }
+
+    void SetNull();
+
+    void AddCoin(const COutPoint& outpoint, const CTxOut& txout, int nHeight, bool fCoinBase);
+    void RemoveCoin(const COutPoint& outpoint, const CTxOut& txout, int nHeight, bool fCoinBase);
+
+    //! Add the changes described by other
+    void Add(const CUTXOStats& other);
+
+    //! Hash of the commitment, null for the empty set
+    uint256 GetCommitmentHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nTransactions);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nBogoSize);
+        READWRITE(nTotalAmount);
+        READWRITE(commitment);
+    }
+};
+
+/**
+ * Header of a UTXO set snapshot written by dumptxoutset. It is followed by the
+ * unspent transactions, each one as its txid, the number of its unspent
+ * outputs, and for each of them its index, VARINT(height * 2 + coinbase) and
+ * the output in the compressed form the chainstate uses.
+ */
+struct CUTXOSnapshotHeader
+{
+    static const uint16_t CURRENT_VERSION = 1;
+
+    unsigned char pchMagic[5];
+    uint16_t nSnapshotVersion;
+    //! Network magic of the chain the snapshot belongs to
+    unsigned char pchMessageStart[4];
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint256 hashCommitment;
+
+    CUTXOSnapshotHeader();
+
+    bool IsValid() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(FLATDATA(pchMagic));
+        READWRITE(nSnapshotVersion);
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(hashBlock);
+        READWRITE(nHeight);
+        READWRITE(nTransactions);
+        READWRITE(nTransactionOutputs);
+        READWRITE(hashCommitment);
+    }
+};
+
+/** Statistics of the outputs a cursor walks over, false if a record cannot be read or when interrupted */
+bool ComputeUTXOStats(CCoinsViewCursor* pcursor, CUTXOStats& stats);
+
+/**
+ * The statistics of the chainstate, following pcoinsTip through ConnectTip and
+ * DisconnectTip. When they are not known at startup, a walk over a snapshot of
+ * the database computes them in the background while the changes made since
+ * the snapshot are collected, and both are summed once the walk is done.
+ * Protected by cs_main.
+ */
+class CUTXOStatsTracker
+{
+public:
+    CUTXOStatsTracker() : fReady(false) {}
+
+    //! Whether the statistics are known
+    bool IsReady() const { return fReady; }
+
+    //! The statistics at hashBlockOut, false while not known
+    bool Get(CUTXOStats& statsOut, uint256& hashBlockOut) const;
+
+    //! Take the statistics of a connected or disconnected block, leaving the chainstate at hashBlockIn
+    void Apply(const CUTXOStats& delta, const uint256& hashBlockIn);
+
+    //! Start over from known statistics
+    void Reset(const CUTXOStats& statsIn, const uint256& hashBlockIn);
+
+    //! Start collecting the changes made after the snapshot at hashBlockIn
+    void StartRebuild(const uint256& hashBlockIn);
+
+    //! Add the statistics of the snapshot to the changes made since
+    void FinishRebuild(const CUTXOStats& statsSnapshot);
+
+private:
+    CUTXOStats stats;
+    uint256 hashBlock;
+    bool fReady;
+};
+
+#endif // BITCOIN_UTXOSTATS_H
@@ -2649,6 +2649,9 @@ UniValue regeneratemintpool(const UniValue &params, bool fHelp) {
 
     bool reindexRequired = false;
 
+    // Rewrite all the entries in a single database transaction
+    walletdb.TxnBegin();
+
     for (auto& mintPoolPair : listMintPool){
         LogPrintf("regeneratemintpool: hashPubcoin: %d hashSeedMaster: %d seedId: %d nCount: %s\n", 
             mintPoolPair.first.GetHex(), get<0>(mintPoolPair.second).GetHex(), get<1>(mintPoolPair.second).GetHex(), get<2>(mintPoolPair.second));
@@ -2657,7 +2660,7 @@ UniValue regeneratemintpool(const UniValue &params, bool fHelp) {
         bool hasSerial = zwalletMain->GetSerialForPubcoin(serialPubcoinPairs, oldHashPubcoin, oldHashSerial);
 
         MintPoolEntry entry = mintPoolPair.second;
-        nIndexes = zwalletMain->RegenerateMintPoolEntry(get<0>(entry),get<1>(entry),get<2>(entry));
+        nIndexes = zwalletMain->RegenerateMintPoolEntry(get<0>(entry),get<1>(entry),get<2>(entry), &walletdb);
 
         if(nIndexes.first != oldHashPubcoin){
             walletdb.EraseMintPoolPair(oldHashPubcoin);
@@ -2670,6 +2673,8 @@ UniValue regeneratemintpool(const UniValue &params, bool fHelp) {
         }
     }
 
+    walletdb.TxnCommit();
+
     if(reindexRequired)
         return "Mintpool issue corrected. Please shutdown BitcoinZero and restart with -reindex flag.";
 
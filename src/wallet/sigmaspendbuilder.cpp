@@ -10,19 +10,27 @@
 #include "../main.h"
 #include "../serialize.h"
 #include "../streams.h"
+#include "../sync.h"
 #include "../util.h"
+#include "../utiltime.h"
 #include "../version.h"
 #include "../sigma.h"
 #include "../hdmint/wallet.h"
 
+#include <boost/thread.hpp>
+
+#include <map>
+#include <memory>
+#include <set>
 #include <stdexcept>
 #include <tuple>
+#include <utility>
 
 class SigmaSpendSigner : public InputSigner
 {
 public:
     const sigma::PrivateCoin coin;
-    std::vector<sigma::PublicCoin> group;
+    std::shared_ptr<const std::vector<sigma::PublicCoin>> group;
     uint256 lastBlockOfGroup;
 
 public:
@@ -30,22 +38,33 @@ public:
     {
     }
 
-    CScript Sign(const CMutableTransaction& tx, const uint256& sig) override
+    CScript Sign(const CMutableTransaction& tx, const uint256& sig, bool fDummy) override
     {
-        // construct spend
         sigma::SpendMetaData meta(output.n, lastBlockOfGroup, sig);
-        sigma::CoinSpend spend(coin.getParams(), coin, group, meta);
-
-        spend.setVersion(coin.getVersion());
+        CDataStream serialized(SER_NETWORK, PROTOCOL_VERSION);
 
-        if (!spend.Verify(group, meta)) {
-            throw std::runtime_error(_("The spend coin transaction failed to verify"));
+        if (fDummy) {
+            // skip the proof, only the size of the spend is needed
+            sigma::CoinSpend spend = sigma::CoinSpend::CreatePlaceholder(coin.getParams(), coin, meta);
+            spend.setVersion(coin.getVersion());
+            serialized << spend;
+        } else {
+            // use the precomputed proof if the anonymity set is closed, otherwise construct spend
+            std::unique_ptr<sigma::CoinSpend> spend = GetPrecomputedSigmaSpend(coin, meta);
+
+            if (!spend) {
+                spend.reset(new sigma::CoinSpend(coin.getParams(), coin, *group, meta));
+                spend->setVersion(coin.getVersion());
+
+                if (!spend->Verify(*group, meta)) {
+                    throw std::runtime_error(_("The spend coin transaction failed to verify"));
+                }
+            }
+
+            serialized << *spend;
         }
 
         // construct spend script
-        CDataStream serialized(SER_NETWORK, PROTOCOL_VERSION);
-        serialized << spend;
-
         CScript script;
 
         script << OP_SIGMASPEND;
@@ -55,9 +74,17 @@ public:
     }
 };
 
-static std::unique_ptr<SigmaSpendSigner> CreateSigner(const CSigmaEntry& coin)
+struct SigmaCoinGroup
+{
+    std::shared_ptr<const std::vector<sigma::PublicCoin>> coins;
+    uint256 lastBlock;
+};
+
+// anonymity sets already loaded for this transaction, keyed by denomination and group id
+typedef std::map<std::pair<sigma::CoinDenomination, int>, SigmaCoinGroup> SigmaCoinGroups;
+
+static sigma::PrivateCoin GetPrivateCoin(const CSigmaEntry& coin)
 {
-    sigma::CSigmaState* state = sigma::CSigmaState::GetState();
     auto params = sigma::Params::get_default();
     auto denom = coin.get_denomination();
 
@@ -76,7 +103,15 @@ static std::unique_ptr<SigmaSpendSigner> CreateSigner(const CSigmaEntry& coin)
     priv.setEcdsaSeckey(coin.ecdsaSecretKey);
     priv.setPublicCoin(pub);
 
-    std::unique_ptr<SigmaSpendSigner> signer(new SigmaSpendSigner(priv));
+    return priv;
+}
+
+static std::unique_ptr<SigmaSpendSigner> CreateSigner(const CSigmaEntry& coin, SigmaCoinGroups& groups)
+{
+    sigma::CSigmaState* state = sigma::CSigmaState::GetState();
+    auto denom = coin.get_denomination();
+    std::unique_ptr<SigmaSpendSigner> signer(new SigmaSpendSigner(GetPrivateCoin(coin)));
+    auto& pub = signer->coin.getPublicCoin();
 
     // get coin group
     int groupId;
@@ -90,16 +125,30 @@ static std::unique_ptr<SigmaSpendSigner> CreateSigner(const CSigmaEntry& coin)
     signer->output.n = static_cast<uint32_t>(groupId);
     signer->sequence = CTxIn::SEQUENCE_FINAL;
 
-    if (state->GetCoinSetForSpend(
-        &chainActive,
-        chainActive.Height() - (ZC_MINT_CONFIRMATIONS - 1), // required 6 confirmation for mint to spend
-        denom,
-        groupId,
-        signer->lastBlockOfGroup,
-        signer->group) < 2) {
-        throw std::runtime_error(_("Has to have at least two mint coins with at least 6 confirmation in order to spend a coin"));
+    // inputs from the same group share a single copy of the anonymity set
+    auto it = groups.find(std::make_pair(denom, groupId));
+
+    if (it == groups.end()) {
+        SigmaCoinGroup group;
+        std::vector<sigma::PublicCoin> coins;
+
+        if (state->GetCoinSetForSpend(
+            &chainActive,
+            chainActive.Height() - (ZC_MINT_CONFIRMATIONS - 1), // required 6 confirmation for mint to spend
+            denom,
+            groupId,
+            group.lastBlock,
+            coins) < 2) {
+            throw std::runtime_error(_("Has to have at least two mint coins with at least 6 confirmation in order to spend a coin"));
+        }
+
+        group.coins = std::make_shared<const std::vector<sigma::PublicCoin>>(std::move(coins));
+        it = groups.emplace(std::make_pair(denom, groupId), std::move(group)).first;
     }
 
+    signer->group = it->second.coins;
+    signer->lastBlockOfGroup = it->second.lastBlock;
+
     return signer;
 }
 
@@ -140,10 +189,11 @@ CAmount SigmaSpendBuilder::GetInputs(std::vector<std::unique_ptr<InputSigner>>&
     }
 
     // construct signers
+    SigmaCoinGroups groups;
     CAmount total = 0;
     for (auto& coin : selected) {
         total += coin.get_denomination_value();
-        signers.push_back(CreateSigner(coin));
+        signers.push_back(CreateSigner(coin, groups));
     }
 
     return total;
@@ -184,3 +234,153 @@ CAmount SigmaSpendBuilder::GetChanges(std::vector<CTxOut>& outputs, CAmount amou
 
     return amount;
 }
+
+// proofs for coins in closed groups, keyed by pubcoin hash and never written to disk
+struct PrecomputedSigmaSpend
+{
+    uint256 lastBlockOfGroup;
+    sigma::CoinSpend spend;
+};
+
+static CCriticalSection cs_precomputedSpends;
+static std::map<uint256, PrecomputedSigmaSpend> precomputedSpends;
+
+std::unique_ptr<sigma::CoinSpend> GetPrecomputedSigmaSpend(const sigma::PrivateCoin& coin, const sigma::SpendMetaData& m)
+{
+    std::unique_ptr<sigma::CoinSpend> spend;
+
+    {
+        LOCK(cs_precomputedSpends);
+        auto it = precomputedSpends.find(primitives::GetPubCoinValueHash(coin.getPublicCoin().getValue()));
+
+        if (it == precomputedSpends.end() || it->second.lastBlockOfGroup != m.blockHash) {
+            return nullptr;
+        }
+
+        spend.reset(new sigma::CoinSpend(it->second.spend));
+    }
+
+    // the proof does not depend on the metadata, only the signature has to be redone
+    spend->updateMetaData(coin, m);
+
+    return spend;
+}
+
+/**
+ * Precomputes the proof of one unspent wallet coin from a closed group which has none yet, and drops proofs of
+ * coins which are not spendable anymore.
+ *
+ * @return true if a proof was computed, false if there is nothing to do
+ */
+static bool PrecomputeSigmaProof()
+{
+    std::unique_ptr<sigma::PrivateCoin> coin;
+    std::vector<sigma::PublicCoin> group;
+    uint256 pubCoinHash;
+    uint256 lastBlockOfGroup;
+    int groupId = -1;
+
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+
+        // coin secrets can't be derived while the wallet is locked
+        if (!zwalletMain || pwalletMain->IsLocked()) {
+            return false;
+        }
+
+        sigma::CSigmaState* state = sigma::CSigmaState::GetState();
+        int maxHeight = chainActive.Height() - (ZC_MINT_CONFIRMATIONS - 1);
+        std::set<uint256> available;
+
+        for (const CSigmaEntry& entry : pwalletMain->GetAvailableCoins(nullptr, true)) {
+            auto denom = entry.get_denomination();
+            sigma::PublicCoin pub(entry.value, denom);
+            uint256 hash = primitives::GetPubCoinValueHash(entry.value);
+            int id;
+
+            available.insert(hash);
+            std::tie(std::ignore, id) = state->GetMintedCoinHeightAndId(pub);
+
+            // a group is closed once a newer one exists, its anonymity set is fixed when its last block is confirmed
+            sigma::CSigmaState::SigmaCoinGroupInfo info;
+
+            if (coin || id < 1 || id >= state->GetLatestCoinID(denom) || !state->GetCoinGroupInfo(denom, id, info)
+                || info.lastBlock->nHeight > maxHeight) {
+                continue;
+            }
+
+            {
+                LOCK(cs_precomputedSpends);
+                auto it = precomputedSpends.find(hash);
+
+                if (it != precomputedSpends.end() && it->second.lastBlockOfGroup == info.lastBlock->GetBlockHash()) {
+                    continue;
+                }
+            }
+
+            if (state->GetCoinSetForSpend(&chainActive, maxHeight, denom, id, lastBlockOfGroup, group) < 2) {
+                continue;
+            }
+
+            coin.reset(new sigma::PrivateCoin(GetPrivateCoin(entry)));
+            pubCoinHash = hash;
+            groupId = id;
+        }
+
+        LOCK(cs_precomputedSpends);
+
+        for (auto it = precomputedSpends.begin(); it != precomputedSpends.end();) {
+            if (available.count(it->first)) {
+                it++;
+            } else {
+                it = precomputedSpends.erase(it);
+            }
+        }
+    }
+
+    if (!coin) {
+        return false;
+    }
+
+    // the expensive part runs without holding any lock, metadata is replaced at spend time
+    sigma::SpendMetaData meta(groupId, lastBlockOfGroup, uint256());
+    sigma::CoinSpend spend(coin->getParams(), *coin, group, meta);
+
+    spend.setVersion(coin->getVersion());
+
+    if (!spend.Verify(group, meta)) {
+        throw std::runtime_error("Precomputed sigma proof failed to verify");
+    }
+
+    LOCK(cs_precomputedSpends);
+    precomputedSpends.erase(pubCoinHash);
+    precomputedSpends.emplace(pubCoinHash, PrecomputedSigmaSpend{lastBlockOfGroup, spend});
+
+    LogPrint("zero", "Precomputed sigma proof for coin %s in group %d\n", pubCoinHash.GetHex(), groupId);
+
+    return true;
+}
+
+void ThreadSigmaProofPrecompute()
+{
+    RenameThread("bitcoin-sigmaproofs");
+
+    while (true) {
+        bool computed = false;
+
+        try {
+            computed = PrecomputeSigmaProof();
+        } catch (const boost::thread_interrupted&) {
+            throw;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+
+        // keep going while there is work, otherwise wait for new blocks to close groups
+        if (!computed) {
+            MilliSleep(10000);
+        }
+
+        boost::this_thread::interruption_point();
+    }
+}
@@ -4,9 +4,14 @@
 #include "txbuilder.h"
 
 #include "../hdmint/wallet.h"
+#include "../sigma/coinspend.h"
+#include "../sigma/spend_metadata.h"
 
+#include <memory>
 #include <vector>
 
+static const bool DEFAULT_SIGMA_PRECOMPUTE_PROOFS = false;
+
 class SigmaSpendBuilder : public TxBuilder
 {
 public:
@@ -27,4 +32,13 @@ private:
     CHDMintWallet& mintWallet;
 };
 
+/**
+ * Returns a spend of the coin from a precomputed proof bound to the given metadata, or null if there is no
+ * proof for the anonymity set ending at m.blockHash.
+ */
+std::unique_ptr<sigma::CoinSpend> GetPrecomputedSigmaSpend(const sigma::PrivateCoin& coin, const sigma::SpendMetaData& m);
+
+/** Precomputes spend proofs for unspent wallet coins in closed coin groups, enabled with -sigmaprecomputeproofs. */
+void ThreadSigmaProofPrecompute();
+
 #endif
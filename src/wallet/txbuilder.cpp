@@ -10,8 +10,12 @@
 #include "../util.h"
 
 #include <boost/format.hpp>
+#include <boost/thread.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
 #include <random>
 #include <stdexcept>
 #include <string>
@@ -31,6 +35,53 @@ InputSigner::~InputSigner()
 {
 }
 
+/**
+ * Creates the real signatures of all inputs.
+ *
+ * Every signer signs the same hash, so they are independent of each other and the expensive ones
+ * (e.g. Sigma proofs) are generated concurrently on at most one thread per core.
+ */
+static void SignInputs(CMutableTransaction& tx, const uint256& sig, const std::vector<std::unique_ptr<InputSigner>>& signers)
+{
+    std::vector<CScript> scripts(tx.vin.size());
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next++) < scripts.size()) {
+            try {
+                scripts[i] = signers[i]->Sign(tx, sig, false);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = scripts.size();
+            }
+        }
+    };
+
+    size_t threads = std::min(static_cast<size_t>(std::max(GetNumCores(), 1)), scripts.size());
+    boost::thread_group workers;
+
+    for (size_t i = 1; i < threads; i++) {
+        workers.create_thread(worker);
+    }
+
+    worker();
+    workers.join_all();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    for (size_t i = 0; i < scripts.size(); i++) {
+        tx.vin[i].scriptSig = std::move(scripts[i]);
+    }
+}
+
 TxBuilder::TxBuilder(CWallet& wallet) noexcept : wallet(wallet)
 {
 }
@@ -217,8 +268,9 @@ CWalletTx TxBuilder::Build(const std::vector<CRecipient>& recipients, CAmount& f
         // now every fields is populated then we can sign transaction
         uint256 sig = tx.GetHash();
 
+        // sign with placeholders until the fee is known to be sufficient, real signatures are expensive
         for (size_t i = 0; i < tx.vin.size(); i++) {
-            tx.vin[i].scriptSig = signers[i]->Sign(tx, sig);
+            tx.vin[i].scriptSig = signers[i]->Sign(tx, sig, true);
         }
 
         // check fee
@@ -240,6 +292,22 @@ CWalletTx TxBuilder::Build(const std::vector<CRecipient>& recipients, CAmount& f
         }
 
         if (fee >= feeNeeded) {
+            SignInputs(tx, sig, signers);
+
+            static_cast<CTransaction&>(result) = CTransaction(tx);
+
+            // Placeholders should have the size of the real signatures. If they don't, go around again with the
+            // fee the signed transaction needs rather than relaying one that pays too little
+            unsigned signedSize = GetVirtualTransactionSize(result);
+            if (signedSize != size) {
+                LogPrintf("%s: placeholder signatures sized the transaction at %u bytes, signed it has %u\n",
+                          __func__, size, signedSize);
+                CAmount feeSigned = AdjustFee(CWallet::GetMinimumFee(signedSize, nTxConfirmTarget, mempool), signedSize);
+                if (fee < feeSigned) {
+                    fee = feeSigned;
+                    continue;
+                }
+            }
             break;
         }
 
@@ -24,7 +24,11 @@ public:
     explicit InputSigner(const COutPoint& output, uint32_t seq = CTxIn::SEQUENCE_FINAL);
     virtual ~InputSigner();
 
-    virtual CScript Sign(const CMutableTransaction& tx, const uint256& sig) = 0;
+    /**
+     * Creates the scriptSig of the input. With fDummy set, a placeholder of the same size as the real
+     * one is created instead, which is enough to calculate the transaction size and fee.
+     */
+    virtual CScript Sign(const CMutableTransaction& tx, const uint256& sig, bool fDummy) = 0;
 };
 
 class TxBuilder
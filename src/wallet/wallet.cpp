@@ -811,6 +811,7 @@ bool CWallet::AddToWallet(const CWalletTx &wtxIn, bool fFromLoadWallet, CWalletD
     LogPrintf("CWallet::AddToWallet\n");
     uint256 hash = wtxIn.GetHash();
     LogPrintf("hash=%s\n", hash.ToString());
+    MarkBalancesDirty();
     if (fFromLoadWallet) {
         mapWallet[hash] = wtxIn;
         CWalletTx &wtx = mapWallet[hash];
@@ -1477,6 +1478,141 @@ void CWalletTx::GetAccountAmounts(const string &strAccount, CAmount &nReceived,
     }
 }
 
+// Number of blocks read ahead and applied per lock acquisition during a rescan
+static const size_t RESCAN_CHUNK_SIZE = 64;
+
+/**
+ * Snapshot of the key and script ids and the watch-only scripts of the wallet. It lets the rescan workers skip
+ * most transactions without taking cs_wallet: every output IsMine accepts matches it, but not the other way round.
+ */
+struct CRescanFilter
+{
+    std::set<CKeyID> setKeys;
+    std::set<CScriptID> setScripts;
+    WatchOnlySet setWatchOnly;
+
+    bool MayBeMine(const CTxOut &txout) const {
+        const CScript &script = txout.scriptPubKey;
+        // sigma mints are looked up in the wallet database
+        if (script.IsSigmaMint())
+            return true;
+        if (setWatchOnly.count(script) || setScripts.count(CScriptID(script)))
+            return true;
+
+        // key hashes, script hashes and public keys pushed by the script
+        CScript::const_iterator pc = script.begin();
+        opcodetype opcode;
+        std::vector<unsigned char> vch;
+        while (pc < script.end() && script.GetOp(pc, opcode, vch)) {
+            if (vch.size() == 20) {
+                uint160 hash(vch);
+                if (setKeys.count(CKeyID(hash)) || setScripts.count(CScriptID(hash)))
+                    return true;
+            } else if (vch.size() == 33 || vch.size() == 65) {
+                if (setKeys.count(CPubKey(vch.begin(), vch.end()).GetID()))
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    /** Whether an input or output may belong to the wallet, leaving out inputs that spend wallet transactions. */
+    bool MayInvolve(const CTransaction &tx) const {
+        BOOST_FOREACH(const CTxIn &txin, tx.vin) {
+            // sigma spends are looked up in the wallet database
+            if (txin.IsSigmaSpend())
+                return true;
+        }
+        BOOST_FOREACH(const CTxOut &txout, tx.vout) {
+            if (MayBeMine(txout))
+                return true;
+        }
+        return false;
+    }
+};
+
+void CWallet::GetRescanFilter(CRescanFilter &filter) const {
+    GetKeys(filter.setKeys);
+    LOCK(cs_KeyStore);
+    filter.setScripts.clear();
+    for (ScriptMap::const_iterator it = mapScripts.begin(); it != mapScripts.end(); ++it)
+        filter.setScripts.insert(it->first);
+    filter.setWatchOnly = setWatchOnly;
+}
+
+struct CRescanBlock
+{
+    CBlockIndex *pindex;
+    CDiskBlockPos pos;
+    CBlock block;
+    //! per transaction, whether the prefilter matched it
+    std::vector<char> vMayInvolve;
+};
+
+/** Collects up to RESCAN_CHUNK_SIZE blocks of the active chain starting at pindex. */
+static std::vector<CRescanBlock> CollectRescanChunk(CBlockIndex *pindex) {
+    std::vector<CRescanBlock> chunk;
+    LOCK(cs_main);
+    for (; pindex && chunk.size() < RESCAN_CHUNK_SIZE; pindex = chainActive.Next(pindex)) {
+        CRescanBlock scan;
+        scan.pindex = pindex;
+        scan.pos = pindex->GetBlockPos();
+        chunk.push_back(std::move(scan));
+    }
+    return chunk;
+}
+
+/**
+ * Reads and prefilters the blocks of the chunk on all cores. The blocks are part of the active chain and were
+ * validated when connected, so matching the index hash is enough and PoW isn't checked. The workers don't touch
+ * the wallet: ScanForWalletTransactions may be called with cs_wallet held, and IsMine/IsFromMe take it, so they
+ * only match the outputs against the filter. Returns false with strError set if a worker threw.
+ */
+static bool ReadRescanChunk(std::vector<CRescanBlock> &chunk, const CRescanFilter &filter, std::string &strError) {
+    std::atomic<size_t> next(0);
+    boost::mutex csError;
+
+    auto worker = [&]() {
+        try {
+            size_t i;
+            while ((i = next++) < chunk.size()) {
+                CRescanBlock &scan = chunk[i];
+                if (!ReadBlockFromDisk(scan.block, scan.pos, scan.pindex->nHeight, Params().GetConsensus(), false) ||
+                    scan.block.GetHash() != scan.pindex->GetBlockHash()) {
+                    LogPrintf("%s: failed to read block %s\n", __func__, scan.pindex->GetBlockHash().ToString());
+                    scan.block.SetNull();
+                }
+                scan.vMayInvolve.resize(scan.block.vtx.size());
+                for (size_t n = 0; n < scan.block.vtx.size(); n++)
+                    scan.vMayInvolve[n] = filter.MayInvolve(scan.block.vtx[n]);
+            }
+        } catch (const std::exception &e) {
+            boost::lock_guard<boost::mutex> lock(csError);
+            if (strError.empty())
+                strError = e.what();
+            next = chunk.size();
+        } catch (...) {
+            boost::lock_guard<boost::mutex> lock(csError);
+            if (strError.empty())
+                strError = "unknown exception";
+            next = chunk.size();
+        }
+    };
+
+    size_t nThreads = std::min(static_cast<size_t>(std::max(GetNumCores(), 1)), chunk.size());
+    boost::thread_group workers;
+    try {
+        for (size_t i = 1; i < nThreads; i++)
+            workers.create_thread(worker);
+    } catch (const boost::thread_resource_error &e) {
+        // read with the threads that could be started
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+    worker();
+    workers.join_all();
+    return strError.empty();
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1488,6 +1624,7 @@ int CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart, bool fUpdate) {
     const CChainParams &chainParams = Params();
 
     CBlockIndex *pindex = pindexStart;
+    double dProgressStart, dProgressTip;
     {
         LOCK2(cs_main, cs_wallet);
 
@@ -1498,33 +1635,109 @@ int CWallet::ScanForWalletTransactions(CBlockIndex *pindexStart, bool fUpdate) {
 
         ShowProgress(_("Rescanning..."),
                      0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(),
-                                                                     false);
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99,
-                                                                      (int) ((Checkpoints::GuessVerificationProgress(
-                                                                              chainParams.Checkpoints(), pindex,
-                                                                              false) - dProgressStart) /
-                                                                             (dProgressTip - dProgressStart) * 100))));
-
-            CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus());
-            BOOST_FOREACH(CTransaction & tx, block.vtx)
-            {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
+        dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
+    }
+
+    // Blocks are read one chunk ahead, while the previous chunk is added to the wallet. The locks are only held
+    // while adding a chunk, so RPC and validation can proceed in between.
+    // The filter is taken again for every chunk, so keys added meanwhile are matched from the next one on.
+    std::string strReadError;
+    CRescanFilter filter;
+    GetRescanFilter(filter);
+    std::vector<CRescanBlock> chunk = CollectRescanChunk(pindex);
+    if (!ReadRescanChunk(chunk, filter, strReadError)) {
+        ShowProgress(_("Rescanning..."), 100);
+        throw std::runtime_error(std::string(__func__) + ": reading blocks failed: " + strReadError);
+    }
+
+    while (!chunk.empty()) {
+        std::vector<CRescanBlock> chunkNext;
+        {
+            LOCK(cs_main);
+            if (chainActive.Contains(chunk.back().pindex))
+                chunkNext = CollectRescanChunk(chainActive.Next(chunk.back().pindex));
+        }
+        bool fReadNext = true;
+        GetRescanFilter(filter);
+        boost::thread reader([&chunkNext, &filter, &fReadNext, &strReadError]() {
+            fReadNext = ReadRescanChunk(chunkNext, filter, strReadError);
+        });
+
+        CBlockIndex *pindexReorg = nullptr;
+        try {
+            LOCK2(cs_main, cs_wallet);
+            for (CRescanBlock &scan : chunk) {
+                pindex = scan.pindex;
+
+                // the chain was reorganized since the chunk was collected, continue from the fork
+                if (!chainActive.Contains(pindex)) {
+                    pindexReorg = pindex;
+                    break;
+                }
+
+                if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99,
+                                                                          (int) ((Checkpoints::GuessVerificationProgress(
+                                                                                  chainParams.Checkpoints(), pindex,
+                                                                                  false) - dProgressStart) /
+                                                                                 (dProgressTip - dProgressStart) * 100))));
+
+                for (size_t n = 0; n < scan.block.vtx.size(); n++) {
+                    const CTransaction &tx = scan.block.vtx[n];
+
+                    // Inputs can spend transactions added during this scan, so they are checked here. Looking
+                    // them up in mapWallet is cheap, IsMine on the outputs was prefiltered by the reader.
+                    if (!scan.vMayInvolve[n] && !mapWallet.count(tx.GetHash())) {
+                        bool fSpendsWallet = false;
+                        BOOST_FOREACH(const CTxIn &txin, tx.vin) {
+                            if (mapWallet.count(txin.prevout.hash)) {
+                                fSpendsWallet = true;
+                                break;
+                            }
+                        }
+                        if (!fSpendsWallet)
+                            continue;
+                    }
+
+                    if (AddToWalletIfInvolvingMe(tx, &scan.block, fUpdate))
+                        ret++;
+                }
+
+                if (GetTime() >= nNow + 60) {
+                    nNow = GetTime();
+                    LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight,
+                              Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                }
             }
-            pindex = chainActive.Next(pindex);
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight,
-                          Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+        } catch (...) {
+            // the reader writes to chunkNext, which goes out of scope
+            reader.join();
+            throw;
+        }
+
+        reader.join();
+
+        if (pindexReorg) {
+            // the chunk read ahead doesn't follow the fork
+            strReadError.clear();
+            {
+                LOCK(cs_main);
+                const CBlockIndex *pindexFork = chainActive.FindFork(pindexReorg);
+                chunkNext = CollectRescanChunk(pindexFork ? chainActive.Next(pindexFork) : chainActive.Genesis());
             }
+            fReadNext = ReadRescanChunk(chunkNext, filter, strReadError);
+        }
+
+        if (!fReadNext) {
+            ShowProgress(_("Rescanning..."), 100);
+            throw std::runtime_error(std::string(__func__) + ": reading blocks failed: " + strReadError);
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+
+        chunk.swap(chunkNext);
     }
+
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     return ret;
 }
 
@@ -1613,6 +1826,20 @@ set <uint256> CWalletTx::GetConflicts() const {
     return result;
 }
 
+void CWalletTx::MarkDirty() {
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+
+    if (pwallet)
+        pwallet->MarkBalancesDirty();
+}
+
 CAmount CWalletTx::GetDebit(const isminefilter &filter) const {
     if (vin.empty())
         return 0;
@@ -1908,18 +2135,50 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime) {
  */
 
 
-CAmount CWallet::GetBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+/**
+ * Return the wallet balance totals, recomputing them only if a wallet
+ * transaction changed, the chain tip moved or the mempool/stempool was
+ * updated since they were last computed. Caller must hold cs_main and
+ * cs_wallet.
+ */
+const CWallet::CBalanceTotals& CWallet::GetBalanceTotals() const {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+    unsigned int nStempoolUpdated = stempool.GetTransactionsUpdated();
+    if (fBalancesCached && pindexBalancesTip == chainActive.Tip() &&
+        nBalancesMempoolUpdated == nMempoolUpdated && nBalancesStempoolUpdated == nStempoolUpdated)
+        return cachedBalances;
+
+    // Set before the pass so a concurrent MarkBalancesDirty() is not lost.
+    fBalancesCached = true;
+
+    CBalanceTotals totals = CBalanceTotals();
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+        const CWalletTx *pcoin = &(*it).second;
+        totals.nImmature += pcoin->GetImmatureCredit();
+        totals.nWatchOnlyImmature += pcoin->GetImmatureWatchOnlyCredit();
+
+        if (pcoin->IsTrusted()) {
+            totals.nTrusted += pcoin->GetAvailableCredit();
+            totals.nWatchOnlyTrusted += pcoin->GetAvailableWatchOnlyCredit();
+        } else if (pcoin->GetDepthInMainChain() == 0 && (pcoin->InMempool() || pcoin->InStempool())) {
+            totals.nUnconfirmed += pcoin->GetAvailableCredit();
+            totals.nWatchOnlyUnconfirmed += pcoin->GetAvailableWatchOnlyCredit();
         }
     }
 
-    return nTotal;
+    cachedBalances = totals;
+    pindexBalancesTip = chainActive.Tip();
+    nBalancesMempoolUpdated = nMempoolUpdated;
+    nBalancesStempoolUpdated = nStempoolUpdated;
+    return cachedBalances;
+}
+
+CAmount CWallet::GetBalance() const {
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTotals().nTrusted;
 }
 
 CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated) const {
@@ -1943,21 +2202,9 @@ CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated) const {
 }
 
 CAmount CWallet::GetAnonymizedBalance() const {
-    if (fLiteMode) return 0;
-
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted())
-                nTotal += 0;
-//                nTotal += pcoin->GetAnonymizedCredit();
-        }
-    }
-
-    return nTotal;
+    // PrivateSend credit is not tracked by this wallet (see the disabled
+    // CWalletTx::GetAnonymizedCredit), so there is nothing to sum.
+    return 0;
 }
 
 CAmount CWalletTx::GetAnonymizedCredit(bool fUseCache) const {
@@ -2018,19 +2265,8 @@ CAmount CWallet::GetNeedsToBeAnonymizedBalance(CAmount nMinBalance) const {
 }
 
 CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const {
-    if (fLiteMode) return 0;
-
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-
-//            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-        }
-    }
-
-    return nTotal;
+    // Denominated credit is not tracked by this wallet, see GetAnonymizedBalance.
+    return 0;
 }
 
 std::vector<CRecipient> CWallet::CreateSigmaMintRecipients(
@@ -2149,76 +2385,70 @@ std::list<CSigmaEntry> CWallet::GetAvailableCoins(const CCoinControl *coinContro
     EnsureMintWalletAvailable();
 
     LOCK2(cs_main, cs_wallet);
-    CWalletDB walletdb(strWalletFile);
     std::list<CSigmaEntry> coins;
-    std::vector<CMintMeta> vecMints = zwalletMain->GetTracker().ListMints(true, true, false);
-    list<CMintMeta> listMints(vecMints.begin(), vecMints.end());
-    for (const CMintMeta& mint : listMints) {
-        CSigmaEntry entry;
-        GetMint(mint.hashSerial, entry);
-        coins.push_back(entry);
-    }
+    sigma::CSigmaState* sigmaState = sigma::CSigmaState::GetState();
 
-    std::set<COutPoint> lockedCoins = setLockedCoins;
+    // Group sizes are shared by all coins of the group, count them only once
+    std::map<std::pair<sigma::CoinDenomination, int>, int> groupSizes;
 
     // Filter out coins which are not confirmed, I.E. do not have at least 6 blocks
     // above them, after they were minted.
     // Also filter out used coins.
-    // Finally filter out coins that have not been selected from CoinControl should that be used
-    coins.remove_if([lockedCoins, coinControl, includeUnsafe](const CSigmaEntry& coin) {
-        sigma::CSigmaState* sigmaState = sigma::CSigmaState::GetState();
-        if (coin.IsUsed)
-            return true;
+    // Finally filter out coins that have not been selected from CoinControl should that be used.
+    // All of this is decided from the tracked mint metadata and the chain state, so only the
+    // coins which pass are regenerated.
+    std::vector<CMintMeta> vecMints = zwalletMain->GetTracker().ListMints(true, true, false);
+    for (const CMintMeta& mint : vecMints) {
+        sigma::PublicCoin pubCoin(mint.GetPubCoinValue(), mint.denom);
 
         int coinHeight, coinId;
-        std::tie(coinHeight, coinId) =  sigmaState->GetMintedCoinHeightAndId(
-            sigma::PublicCoin(coin.value, coin.get_denomination()));
-
-        // Check group size
-        uint256 hashOut;
-        std::vector<sigma::PublicCoin> coinOuts;
-        sigmaState->GetCoinSetForSpend(
-            &chainActive,
-            chainActive.Height() - (ZC_MINT_CONFIRMATIONS - 1), // required 6 confirmation for mint to spend
-            coin.get_denomination(),
-            coinId,
-            hashOut,
-            coinOuts
-        );
-
-        if (!includeUnsafe && coinOuts.size() < 2) {
-            return true;
-        }
+        std::tie(coinHeight, coinId) = sigmaState->GetMintedCoinHeightAndId(pubCoin);
 
         if (coinHeight == -1) {
             // Coin still in the mempool.
-            return true;
+            continue;
         }
 
         if (coinHeight + (ZC_MINT_CONFIRMATIONS - 1) > chainActive.Height()) {
             // Remove the coin from the candidates list, since it does not have the
             // required number of confirmations.
-            return true;
+            continue;
+        }
+
+        // Check group size
+        auto group = std::make_pair(mint.denom, coinId);
+        auto groupSize = groupSizes.find(group);
+        if (groupSize == groupSizes.end()) {
+            int size = sigmaState->GetCoinSetSizeForSpend(
+                &chainActive,
+                chainActive.Height() - (ZC_MINT_CONFIRMATIONS - 1), // required 6 confirmation for mint to spend
+                mint.denom,
+                coinId);
+            groupSize = groupSizes.emplace(group, size).first;
+        }
+
+        if (!includeUnsafe && groupSize->second < 2) {
+            continue;
         }
 
         COutPoint outPoint;
-        sigma::PublicCoin pubCoin(coin.value, coin.get_denomination());
-        sigma::GetOutPoint(outPoint, pubCoin);
+        GetMintOutPoint(mint, outPoint);
 
-        if(lockedCoins.count(outPoint) > 0){
-            return true;
+        if (setLockedCoins.count(outPoint) > 0) {
+            continue;
         }
 
-        if(coinControl != NULL){
-            if(coinControl->HasSelected()){
-                if(!coinControl->IsSelected(outPoint)){
-                    return true;
-                }
-            }
+        if (coinControl != NULL && coinControl->HasSelected() && !coinControl->IsSelected(outPoint)) {
+            continue;
         }
 
-        return false;
-    });
+        CSigmaEntry entry;
+        if (!GetMint(mint.hashSerial, entry) || entry.IsUsed) {
+            continue;
+        }
+
+        coins.push_back(entry);
+    }
 
     return coins;
 }
@@ -2364,57 +2594,23 @@ bool CWallet::GetCoinsToSpend(
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 &&
-                (pcoin->InMempool() || pcoin->InStempool()))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTotals().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTotals().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTotals().nWatchOnlyTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 &&
-                (pcoin->InMempool() || pcoin->InStempool()))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTotals().nWatchOnlyUnconfirmed;
 }
 
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
@@ -2570,15 +2766,8 @@ bool CWallet::IsCollateralAmount(CAmount nInputAmount) const {
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalanceTotals().nWatchOnlyImmature;
 }
 
 void CWallet::AvailableCoins(vector <COutput> &vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl,
@@ -2816,52 +3005,62 @@ void CWallet::ListAvailableSigmaMintCoins(vector<COutput> &vCoins, bool fOnlyCon
 
     vCoins.clear();
     LOCK2(cs_main, cs_wallet);
-    list<CSigmaEntry> listOwnCoins;
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    listOwnCoins = zwalletMain->GetTracker().MintsAsZerocoinEntries();
-    LogPrintf("listOwnCoins.size()=%s\n", listOwnCoins.size());
-    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+
+    // the secrets of the mints can't be regenerated while locked, so none of them is spendable
+    if (IsLocked())
+        return;
+
+    // Look up the transactions of our own unused mints instead of scanning the whole wallet
+    std::vector<CMintMeta> vecMints = zwalletMain->GetTracker().ListMints(true, true, false);
+    for (const CMintMeta& mint : vecMints) {
+        COutPoint outPoint;
+        if (!GetMintOutPoint(mint, outPoint))
+            continue;
+
+        map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outPoint.hash);
+        if (it == mapWallet.end())
+            continue;
+
         const CWalletTx *pcoin = &(*it).second;
-//        LogPrintf("pcoin=%s\n", pcoin->GetHash().ToString());
-        if (!CheckFinalTx(*pcoin)) {
-            LogPrintf("!CheckFinalTx(*pcoin)=%s\n", !CheckFinalTx(*pcoin));
+        if (!CheckFinalTx(*pcoin))
             continue;
-        }
 
-        if (fOnlyConfirmed && !pcoin->IsTrusted()) {
-            LogPrintf("fOnlyConfirmed = %s, !pcoin->IsTrusted()\n", fOnlyConfirmed, !pcoin->IsTrusted());
+        if (fOnlyConfirmed && !pcoin->IsTrusted())
             continue;
-        }
 
-        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) {
-            LogPrintf("Not trusted\n");
+        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
             continue;
-        }
 
         int nDepth = pcoin->GetDepthInMainChain();
-        if (nDepth < 0) {
-            LogPrintf("nDepth=%s\n", nDepth);
+        if (nDepth < 0)
             continue;
-        }
-        LogPrintf("pcoin->vout.size()=%s\n", pcoin->vout.size());
-
-        for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-            if (pcoin->vout[i].scriptPubKey.IsSigmaMint()) {
-                CTxOut txout = pcoin->vout[i];
-                secp_primitives::GroupElement pubCoin = sigma::ParseSigmaMintScript(
-                    txout.scriptPubKey);
-                LogPrintf("Pubcoin=%s\n", pubCoin.tostring());
-                // CHECKING PROCESS
-                BOOST_FOREACH(const CSigmaEntry &ownCoinItem, listOwnCoins) {
-                   if (ownCoinItem.value == pubCoin && ownCoinItem.IsUsed == false &&
-                        ownCoinItem.randomness != uint64_t(0) && ownCoinItem.serialNumber != uint64_t(0)) {
-                        vCoins.push_back(COutput(pcoin, i, nDepth, true, true));
-                        LogPrintf("-->OK\n");
-                    }
-                }
+
+        vCoins.push_back(COutput(pcoin, outPoint.n, nDepth, true, true));
+    }
+
+    // keep the order of the wallet transactions
+    std::sort(vCoins.begin(), vCoins.end(), [](const COutput& a, const COutput& b) {
+        return std::make_pair(a.tx->GetHash(), a.i) < std::make_pair(b.tx->GetHash(), b.i);
+    });
+}
+
+bool CWallet::GetMintOutPoint(const CMintMeta& mint, COutPoint& outPoint) const {
+    AssertLockHeld(cs_wallet);
+
+    // the tracker knows the mint transaction, so only its outputs need to be checked
+    map<uint256, CWalletTx>::const_iterator it = mapWallet.find(mint.txid);
+    if (!mint.txid.IsNull() && it != mapWallet.end()) {
+        const CWalletTx& wtx = it->second;
+        for (uint32_t n = 0; n < wtx.vout.size(); n++) {
+            const CScript& script = wtx.vout[n].scriptPubKey;
+            if (script.IsSigmaMint() && sigma::ParseSigmaMintScript(script) == mint.GetPubCoinValue()) {
+                outPoint = COutPoint(wtx.GetHash(), n);
+                return true;
             }
         }
     }
+
+    return sigma::GetOutPoint(outPoint, sigma::PublicCoin(mint.GetPubCoinValue(), mint.denom));
 }
 
 static void ApproximateBestSubset(vector <pair<CAmount, pair<const CWalletTx *, unsigned int> >> vValue,
@@ -3775,8 +3974,10 @@ bool CWallet::EraseFromWallet(uint256 hash) {
         return false;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        if (mapWallet.erase(hash)) {
+            MarkBalancesDirty();
             CWalletDB(strWalletFile).EraseTx(hash);
+        }
     }
     return true;
 }
@@ -6273,6 +6474,9 @@ std::string CWallet::GetWalletHelpString(bool showDebug) {
                                    strprintf(
                                            _("Send transactions as zero-fee transactions if possible (default: %u)"),
                                            DEFAULT_SEND_FREE_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-sigmaprecomputeproofs",
+                               _("Precompute spend proofs of sigma coins in closed coin groups in the background, to make spending them faster") +
+                               " " + strprintf(_("(default: %u)"), DEFAULT_SIGMA_PRECOMPUTE_PROOFS));
     strUsage += HelpMessageOpt("-spendzeroconfchange",
                                strprintf(_("Spend unconfirmed change when sending transactions (default: %u)"),
                                          DEFAULT_SPEND_ZEROCONF_CHANGE));
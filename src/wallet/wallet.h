@@ -29,6 +29,7 @@
 
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -89,6 +90,7 @@ class CReserveKey;
 class CScript;
 class CTxMemPool;
 class CWalletTx;
+struct CRescanFilter;
 
 /** (client) version numbers for particular wallet features */
 enum WalletFeature
@@ -428,17 +430,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -652,6 +644,29 @@ private:
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    /** Wallet-wide totals served by the Get*Balance family. */
+    struct CBalanceTotals
+    {
+        CAmount nTrusted;
+        CAmount nUnconfirmed;
+        CAmount nImmature;
+        CAmount nWatchOnlyTrusted;
+        CAmount nWatchOnlyUnconfirmed;
+        CAmount nWatchOnlyImmature;
+    };
+
+    /**
+     * Balance totals are recomputed in one pass over mapWallet and then
+     * reused until a wallet transaction is marked dirty, the chain tip
+     * moves or the mempool/stempool contents change.
+     */
+    mutable CBalanceTotals cachedBalances;
+    mutable std::atomic<bool> fBalancesCached;
+    mutable const CBlockIndex* pindexBalancesTip;
+    mutable unsigned int nBalancesMempoolUpdated;
+    mutable unsigned int nBalancesStempoolUpdated;
+    const CBalanceTotals& GetBalanceTotals() const;
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -667,6 +682,9 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /* Copy the key and script ids and the watch-only scripts, to prefilter rescanned transactions. */
+    void GetRescanFilter(CRescanFilter& filter) const;
+
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
 
@@ -727,6 +745,10 @@ public:
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        fBalancesCached = false;
+        pindexBalancesTip = NULL;
+        nBalancesMempoolUpdated = 0;
+        nBalancesStempoolUpdated = 0;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -838,6 +860,8 @@ public:
     bool GetAccountPubkey(CPubKey &pubKey, std::string strAccount, bool bForceNew = false);
 
     void MarkDirty();
+    //! drop the cached balance totals, called whenever a wallet transaction changes
+    void MarkBalancesDirty() const { fBalancesCached = false; }
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlockIndex *pindex, const CBlock* pblock);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
@@ -983,6 +1007,8 @@ public:
     std::vector<CSigmaEntry> SpendSigma(const std::vector<CRecipient>& recipients, CWalletTx& result, CAmount& fee);
 
     bool GetMint(const uint256& hashSerial, CSigmaEntry& zerocoin) const;
+    // Outpoint of an own mint, taken from the wallet transaction it was recorded with when possible
+    bool GetMintOutPoint(const CMintMeta& mint, COutPoint& outPoint) const;
 
     bool CreateZerocoinMintModel(string &stringError,
                                  const std::vector<std::pair<std::string,int>>& denominationPairs,
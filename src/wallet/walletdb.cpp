@@ -969,6 +969,7 @@ DBErrors CWalletDB::ZapSelectTx(CWallet *pwallet, vector <uint256> &vTxHashIn, v
             break;
         } else if ((*it) == hash) {
             pwallet->mapWallet.erase(hash);
+            pwallet->MarkBalancesDirty();
             if (!EraseTx(hash)) {
                 LogPrint("db", "Transaction was found for deletion but returned database error: %s\n", hash.GetHex());
                 delerror = true;
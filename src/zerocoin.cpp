@@ -25,10 +25,11 @@ int64_t nMinimumInputValue = DUST_HARD_LIMIT;
 
 static CZerocoinState zerocoinState;
 
-bool CheckZerocoinFoundersInputs(const CTransaction &tx, CValidationState &state, const Consensus::Params &params, int nHeight)
+bool CheckZerocoinFoundersInputs(const CTransaction &tx, CValidationState &state, const Consensus::Params &params, int nHeight, const CBlockCheckSnapshot *psnapshot)
 
     {
-            if (sporkManager.IsSporkActive(SPORK_13_F_PAYMENT_ENFORCEMENT) && bznodeSync.IsSynced())
+            if (psnapshot ? psnapshot->fFoundersEnforced
+                          : (sporkManager.IsSporkActive(SPORK_13_F_PAYMENT_ENFORCEMENT) && bznodeSync.IsSynced()))
             {
                 bool found_1 = false;
                 bool found_2 = false;
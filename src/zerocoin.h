@@ -11,6 +11,8 @@
 #include <unordered_map>
 #include <functional>
 
+struct CBlockCheckSnapshot;
+
 // Zerocoin transaction info, added to the CBlock to ensure zerocoin mint/spend transactions got their info stored into
 // index
 class CZerocoinTxInfo {
@@ -33,7 +35,7 @@ public:
     void Complete();
 };
 
-bool CheckZerocoinFoundersInputs(const CTransaction &tx, CValidationState &state, const Consensus::Params &params, int nHeight);
+bool CheckZerocoinFoundersInputs(const CTransaction &tx, CValidationState &state, const Consensus::Params &params, int nHeight, const CBlockCheckSnapshot *psnapshot = NULL);
 
 void DisconnectTipZC(CBlock &block, CBlockIndex *pindexDelete);
 